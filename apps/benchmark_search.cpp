@@ -0,0 +1,439 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+// Open-loop search benchmark. Requests arrive following a Poisson process at a
+// target rate regardless of how fast the index answers them, and each one is
+// handled by the first free connection (worker thread). Latency is measured
+// from a request's scheduled arrival rather than from when a worker picked it
+// up, so time spent queued behind slow queries is counted instead of being
+// hidden by coordinated omission, as it is in the closed-loop search_*_index
+// tools.
+
+#include "common_includes.h"
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "index.h"
+#include "index_factory.h"
+#include "pq_flash_index.h"
+#include "program_options_utils.hpp"
+#include "utils.h"
+
+#ifndef _WINDOWS
+#include "linux_aligned_file_reader.h"
+#else
+#ifdef USE_BING_INFRA
+#include "bing_aligned_file_reader.h"
+#else
+#include "windows_aligned_file_reader.h"
+#endif
+#endif
+
+namespace po = boost::program_options;
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkOptions
+{
+    std::string index_type, index_path_prefix, query_file, gt_file, json_output, csv_output;
+    uint32_t recall_at, num_connections, num_nodes_to_cache;
+    uint64_t num_requests, seed;
+    std::vector<uint32_t> Lvec, Wvec;
+    std::vector<double> target_qps;
+};
+
+struct RunResult
+{
+    uint32_t L, W;
+    double target_qps, achieved_qps, recall;
+    uint64_t num_requests;
+    // percentiles 50, 90, 99, 99.9 and max, in microseconds
+    std::vector<double> latency, service_time;
+    double mean_latency, mean_service_time;
+};
+
+const std::vector<double> PERCENTILES = {0.5, 0.9, 0.99, 0.999, 1.0};
+
+// Searches one query with the given L and beamwidth, writing recall_at ids.
+template <typename T> using SearchFn = std::function<void(const T *, uint32_t, uint32_t, uint32_t *)>;
+
+std::vector<double> percentiles_of(std::vector<double> &vals)
+{
+    std::sort(vals.begin(), vals.end());
+    std::vector<double> result;
+    for (auto p : PERCENTILES)
+        result.push_back(vals.empty() ? 0 : vals[std::min(vals.size() - 1, (size_t)(p * vals.size()))]);
+    return result;
+}
+
+template <typename T>
+RunResult run_open_loop(const SearchFn<T> &search, const T *query, const size_t query_num,
+                        const size_t query_aligned_dim, const uint32_t *gt_ids, const float *gt_dists,
+                        const size_t gt_dim, const BenchmarkOptions &opts, const uint32_t L, const uint32_t W,
+                        const double target_qps)
+{
+    const uint64_t n = opts.num_requests;
+
+    // Arrival times are drawn up front so that every configuration replays the
+    // same schedule for a given seed and rate.
+    std::mt19937_64 rng(opts.seed);
+    std::exponential_distribution<double> gap(target_qps);
+    std::vector<Clock::duration> arrival(n);
+    double t = 0;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        t += gap(rng);
+        arrival[i] = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(t));
+    }
+
+    std::vector<double> latency_us(n), service_us(n);
+    std::vector<uint32_t> result_ids(query_num * opts.recall_at);
+    std::vector<Clock::time_point> finished(n);
+    std::atomic<uint64_t> next_request{0};
+
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(20);
+    auto connection = [&]() {
+        std::vector<uint32_t> ids(opts.recall_at);
+        for (uint64_t i = next_request.fetch_add(1); i < n; i = next_request.fetch_add(1))
+        {
+            // Sleep until shortly before the arrival and spin for the rest, as
+            // sleep wake-up jitter would otherwise show up as latency.
+            const Clock::time_point scheduled = start + arrival[i];
+            std::this_thread::sleep_until(scheduled - std::chrono::microseconds(200));
+            while (Clock::now() < scheduled)
+                std::this_thread::yield();
+            const Clock::time_point began = Clock::now();
+
+            const size_t q = i % query_num;
+            search(query + q * query_aligned_dim, L, W, ids.data());
+
+            finished[i] = Clock::now();
+            latency_us[i] = std::chrono::duration<double, std::micro>(finished[i] - scheduled).count();
+            service_us[i] = std::chrono::duration<double, std::micro>(finished[i] - began).count();
+            if (i < query_num)
+                std::copy(ids.begin(), ids.end(), result_ids.begin() + q * opts.recall_at);
+        }
+    };
+
+    std::vector<std::thread> connections;
+    for (uint32_t c = 0; c < opts.num_connections; c++)
+        connections.emplace_back(connection);
+    for (auto &c : connections)
+        c.join();
+
+    RunResult result;
+    result.L = L;
+    result.W = W;
+    result.target_qps = target_qps;
+    result.num_requests = n;
+    const Clock::time_point last = *std::max_element(finished.begin(), finished.end());
+    result.achieved_qps = n / std::chrono::duration<double>(last - start).count();
+    result.mean_latency = std::accumulate(latency_us.begin(), latency_us.end(), 0.0) / n;
+    result.mean_service_time = std::accumulate(service_us.begin(), service_us.end(), 0.0) / n;
+    result.latency = percentiles_of(latency_us);
+    result.service_time = percentiles_of(service_us);
+
+    result.recall = -1;
+    if (gt_ids != nullptr)
+    {
+        const size_t num_checked = std::min<size_t>(query_num, n);
+        result.recall = diskann::calculate_recall((uint32_t)num_checked, (uint32_t *)gt_ids, (float *)gt_dists,
+                                                  (uint32_t)gt_dim, result_ids.data(), opts.recall_at, opts.recall_at);
+    }
+    return result;
+}
+
+void write_json(const std::string &path, const std::vector<RunResult> &results)
+{
+    std::ofstream out(path);
+    out << "[";
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const auto &res = results[r];
+        out << (r == 0 ? "\n" : ",\n") << "{\"L\":" << res.L << ",\"W\":" << res.W
+            << ",\"target_qps\":" << res.target_qps << ",\"achieved_qps\":" << res.achieved_qps
+            << ",\"num_requests\":" << res.num_requests;
+        if (res.recall >= 0)
+            out << ",\"recall\":" << res.recall;
+        out << ",\"mean_latency_us\":" << res.mean_latency << ",\"mean_service_time_us\":" << res.mean_service_time;
+        const char *names[] = {"p50", "p90", "p99", "p999", "max"};
+        for (size_t p = 0; p < PERCENTILES.size(); p++)
+            out << ",\"" << names[p] << "_latency_us\":" << res.latency[p] << ",\"" << names[p]
+                << "_service_time_us\":" << res.service_time[p];
+        out << "}";
+    }
+    out << "\n]\n";
+}
+
+void write_csv(const std::string &path, const std::vector<RunResult> &results)
+{
+    std::ofstream out(path);
+    out << "L,W,target_qps,achieved_qps,num_requests,recall,mean_latency_us,mean_service_time_us";
+    const char *names[] = {"p50", "p90", "p99", "p999", "max"};
+    for (auto name : names)
+        out << "," << name << "_latency_us," << name << "_service_time_us";
+    out << "\n";
+    for (const auto &res : results)
+    {
+        out << res.L << "," << res.W << "," << res.target_qps << "," << res.achieved_qps << "," << res.num_requests
+            << "," << res.recall << "," << res.mean_latency << "," << res.mean_service_time;
+        for (size_t p = 0; p < PERCENTILES.size(); p++)
+            out << "," << res.latency[p] << "," << res.service_time[p];
+        out << "\n";
+    }
+}
+
+template <typename T>
+int benchmark_search(diskann::Metric &metric, BenchmarkOptions &opts)
+{
+    T *query = nullptr;
+    size_t query_num, query_dim, query_aligned_dim;
+    diskann::load_aligned_bin<T>(opts.query_file, query, query_num, query_dim, query_aligned_dim);
+    if (opts.num_requests == 0)
+        opts.num_requests = query_num;
+
+    uint32_t *gt_ids = nullptr;
+    float *gt_dists = nullptr;
+    size_t gt_num = 0, gt_dim = 0;
+    if (opts.gt_file != std::string("null") && file_exists(opts.gt_file))
+    {
+        diskann::load_truthset(opts.gt_file, gt_ids, gt_dists, gt_num, gt_dim);
+        if (gt_num != query_num)
+        {
+            diskann::cerr << "Error. Mismatch in number of queries and ground truth data" << std::endl;
+            return -1;
+        }
+    }
+
+    const uint32_t max_L = *std::max_element(opts.Lvec.begin(), opts.Lvec.end());
+    std::unique_ptr<diskann::AbstractIndex> mem_index;
+    std::unique_ptr<diskann::PQFlashIndex<T>> disk_index;
+    std::shared_ptr<AlignedFileReader> reader;
+    SearchFn<T> search;
+    if (opts.index_type == "memory")
+    {
+        auto config = diskann::IndexConfigBuilder()
+                          .with_metric(metric)
+                          .with_dimension(query_dim)
+                          .with_max_points(0)
+                          .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
+                          .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                          .with_data_type(diskann_type_to_name<T>())
+                          .with_label_type(diskann_type_to_name<uint32_t>())
+                          .with_tag_type(diskann_type_to_name<uint32_t>())
+                          .is_dynamic_index(false)
+                          .is_enable_tags(false)
+                          .is_concurrent_consolidate(false)
+                          .is_pq_dist_build(false)
+                          .is_use_opq(false)
+                          .with_num_pq_chunks(0)
+                          .with_num_frozen_pts(diskann::get_graph_num_frozen_points(opts.index_path_prefix))
+                          .build();
+        mem_index = diskann::IndexFactory(config).create_instance();
+        mem_index->load(opts.index_path_prefix.c_str(), opts.num_connections, max_L);
+        const uint32_t K = opts.recall_at;
+        search = [&mem_index, K](const T *q, uint32_t L, uint32_t, uint32_t *ids) {
+            mem_index->search(q, K, L, ids, (float *)nullptr);
+        };
+    }
+    else if (opts.index_type == "disk")
+    {
+#ifdef _WINDOWS
+#ifndef USE_BING_INFRA
+        reader.reset(new WindowsAlignedFileReader());
+#else
+        reader.reset(new diskann::BingAlignedFileReader());
+#endif
+#else
+        reader.reset(new LinuxAlignedFileReader());
+#endif
+        disk_index.reset(new diskann::PQFlashIndex<T>(reader, metric));
+        int res = disk_index->load(opts.num_connections, opts.index_path_prefix.c_str());
+        if (res != 0)
+            return res;
+        std::vector<uint32_t> node_list;
+        disk_index->cache_bfs_levels(opts.num_nodes_to_cache, node_list);
+        disk_index->load_cache_list(node_list);
+
+        const uint32_t K = opts.recall_at;
+        search = [&disk_index, K](const T *q, uint32_t L, uint32_t W, uint32_t *ids) {
+            std::vector<uint64_t> ids_64(K);
+            disk_index->cached_beam_search(q, K, L, ids_64.data(), nullptr, W);
+            std::copy(ids_64.begin(), ids_64.end(), ids);
+        };
+    }
+    else
+    {
+        diskann::cerr << "Unsupported index type " << opts.index_type << ". Use memory or disk." << std::endl;
+        return -1;
+    }
+    const std::vector<uint32_t> Wvec = opts.index_type == "disk" ? opts.Wvec : std::vector<uint32_t>{0};
+
+    diskann::cout << "Open-loop benchmark: " << opts.num_requests << " requests per run over "
+                  << opts.num_connections << " connections" << std::endl;
+    diskann::cout << std::setw(6) << "L" << std::setw(4) << "W" << std::setw(12) << "Target QPS" << std::setw(12)
+                  << "QPS" << std::setw(12) << "p50 (us)" << std::setw(12) << "p99 (us)" << std::setw(12)
+                  << "p99.9 (us)" << std::setw(16) << "p99 svc (us)" << std::setw(10) << "Recall" << std::endl;
+
+    std::vector<RunResult> results;
+    for (auto L : opts.Lvec)
+    {
+        if (L < opts.recall_at)
+        {
+            diskann::cout << "Ignoring search with L:" << L << " since it's smaller than K:" << opts.recall_at
+                          << std::endl;
+            continue;
+        }
+        for (auto W : Wvec)
+        {
+            for (auto qps : opts.target_qps)
+            {
+                results.push_back(run_open_loop<T>(search, query, query_num, query_aligned_dim, gt_ids, gt_dists,
+                                                   gt_dim, opts, L, W, qps));
+                const auto &r = results.back();
+                diskann::cout << std::setw(6) << L << std::setw(4) << W << std::setw(12) << qps << std::setw(12)
+                              << r.achieved_qps << std::setw(12) << r.latency[0] << std::setw(12) << r.latency[2]
+                              << std::setw(12) << r.latency[3] << std::setw(16) << r.service_time[2] << std::setw(10)
+                              << r.recall << std::endl;
+            }
+        }
+    }
+
+    if (!opts.json_output.empty())
+        write_json(opts.json_output, results);
+    if (!opts.csv_output.empty())
+        write_csv(opts.csv_output, results);
+
+    diskann::aligned_free(query);
+    delete[] gt_ids;
+    delete[] gt_dists;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn;
+    BenchmarkOptions opts;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "benchmark_search", "Measures search latency under open-loop Poisson load")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+
+        po::options_description required_configs("Required");
+        required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                                       program_options_utils::DATA_TYPE_DESCRIPTION);
+        required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                                       program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        required_configs.add_options()("index_type", po::value<std::string>(&opts.index_type)->required(),
+                                       "Type of index to search: memory or disk");
+        required_configs.add_options()("index_path_prefix",
+                                       po::value<std::string>(&opts.index_path_prefix)->required(),
+                                       program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+        required_configs.add_options()("query_file", po::value<std::string>(&opts.query_file)->required(),
+                                       program_options_utils::QUERY_FILE_DESCRIPTION);
+        required_configs.add_options()("recall_at,K", po::value<uint32_t>(&opts.recall_at)->required(),
+                                       program_options_utils::NUMBER_OF_RESULTS_DESCRIPTION);
+        required_configs.add_options()("search_list,L",
+                                       po::value<std::vector<uint32_t>>(&opts.Lvec)->multitoken()->required(),
+                                       program_options_utils::SEARCH_LIST_DESCRIPTION);
+        required_configs.add_options()("target_qps",
+                                       po::value<std::vector<double>>(&opts.target_qps)->multitoken()->required(),
+                                       "Mean request arrival rates to run at, in queries per second");
+
+        po::options_description optional_configs("Optional");
+        optional_configs.add_options()("gt_file",
+                                       po::value<std::string>(&opts.gt_file)->default_value(std::string("null")),
+                                       program_options_utils::GROUND_TRUTH_FILE_DESCRIPTION);
+        optional_configs.add_options()(
+            "beamwidth,W", po::value<std::vector<uint32_t>>(&opts.Wvec)->multitoken()->default_value({2}, "2"),
+            "Beamwidths to sweep for disk indices.  Default value: 2");
+        optional_configs.add_options()("num_connections,T",
+                                       po::value<uint32_t>(&opts.num_connections)->default_value(omp_get_num_procs()),
+                                       "Number of connections, each a thread serving one request at a time.  "
+                                       "Defaults to the number of logical processor cores");
+        optional_configs.add_options()("num_requests", po::value<uint64_t>(&opts.num_requests)->default_value(0),
+                                       "Requests per run, cycling through the queries.  Default: number of queries");
+        optional_configs.add_options()("seed", po::value<uint64_t>(&opts.seed)->default_value(0),
+                                       "Seed of the arrival schedule, the same for every run");
+        optional_configs.add_options()("num_nodes_to_cache",
+                                       po::value<uint32_t>(&opts.num_nodes_to_cache)->default_value(0),
+                                       program_options_utils::NUMBER_OF_NODES_TO_CACHE);
+        optional_configs.add_options()("json_output",
+                                       po::value<std::string>(&opts.json_output)->default_value(std::string("")),
+                                       "Write the results of all runs to this file as JSON");
+        optional_configs.add_options()("csv_output",
+                                       po::value<std::string>(&opts.csv_output)->default_value(std::string("")),
+                                       "Write the results of all runs to this file as CSV");
+
+        desc.add(required_configs).add(optional_configs);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    for (auto qps : opts.target_qps)
+    {
+        if (qps <= 0)
+        {
+            std::cerr << "Target QPS must be positive" << std::endl;
+            return -1;
+        }
+    }
+    if (opts.num_connections == 0)
+    {
+        std::cerr << "Need at least one connection" << std::endl;
+        return -1;
+    }
+
+    diskann::Metric metric;
+    if (dist_fn == std::string("mips"))
+        metric = diskann::Metric::INNER_PRODUCT;
+    else if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("cosine"))
+        metric = diskann::Metric::COSINE;
+    else
+    {
+        std::cout << "Unsupported distance function. Currently only L2/ Inner Product/Cosine are supported."
+                  << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("float"))
+            return benchmark_search<float>(metric, opts);
+        else if (data_type == std::string("int8"))
+            return benchmark_search<int8_t>(metric, opts);
+        else if (data_type == std::string("uint8"))
+            return benchmark_search<uint8_t>(metric, opts);
+        else
+        {
+            std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << std::string(e.what()) << std::endl;
+        diskann::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+}
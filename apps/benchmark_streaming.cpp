@@ -0,0 +1,635 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+// Mixed-workload benchmark for the dynamic in-memory index. A window of
+// active_window points slides over the data file: insert threads add points to
+// its right while a delete thread lazily deletes consolidate_interval points at
+// a time from its left and consolidates them, and search threads query the
+// index throughout. Search latency is reported separately for the time spent
+// inside consolidate_deletes, and recall is checked periodically against exact
+// ground truth over the points live at that moment.
+//
+// Ground truth is maintained incrementally: each point's distances to all
+// queries are computed once, when it is inserted, and kept in a ring indexed by
+// point id until its slot is reused. A recall check briefly pauses inserts and
+// lazy deletes (searches and consolidation keep running) so that the live set
+// does not change under it.
+
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <omp.h>
+#include <shared_mutex>
+#include <thread>
+
+#include "abstract_index.h"
+#include "distance.h"
+#include "index_factory.h"
+#include "metrics.h"
+#include "program_options_utils.hpp"
+#include "timer.h"
+#include "utils.h"
+
+namespace po = boost::program_options;
+
+using Clock = std::chrono::steady_clock;
+
+struct StreamingOptions
+{
+    std::string data_path, query_file, json_output;
+    uint32_t R, Lbuild, L, recall_at, num_start_pts;
+    uint32_t insert_threads, consolidate_threads, search_threads;
+    float alpha, start_point_norm;
+    size_t max_points_to_insert, active_window, consolidate_interval;
+    double insert_rate, search_qps, recall_check_interval;
+};
+
+struct RecallCheck
+{
+    double at_seconds;
+    size_t live_points;
+    double recall;
+    bool during_consolidation;
+};
+
+struct ConsolidationResult
+{
+    double start_seconds, duration_seconds;
+    size_t slots_released;
+    uint64_t searches, search_p50_us, search_p99_us;
+};
+
+// Exact distances from every query to the points of the sliding window. Point
+// j lives in slot j % capacity; a slot holds the id of the point it describes,
+// plus one, once that point has been inserted into the index.
+template <typename T> class WindowGroundTruth
+{
+  public:
+    WindowGroundTruth(const T *queries, const size_t num_queries, const size_t aligned_dim, const size_t capacity,
+                      const diskann::Metric metric)
+        : _queries(queries), _num_queries(num_queries), _aligned_dim(aligned_dim), _capacity(capacity),
+          _dists(num_queries * capacity), _present(new std::atomic<uint64_t>[capacity])
+    {
+        _distance.reset(diskann::get_distance_function<T>(metric));
+        for (size_t s = 0; s < capacity; s++)
+            _present[s].store(0);
+    }
+
+    // Computes the distances of point id to all queries. Called before the
+    // point is inserted, once the previous occupant of its slot is deleted.
+    void add(const size_t id, const T *point)
+    {
+        const size_t slot = id % _capacity;
+        for (size_t q = 0; q < _num_queries; q++)
+            _dists[q * _capacity + slot] =
+                _distance->compare(_queries + q * _aligned_dim, point, (uint32_t)_aligned_dim);
+    }
+
+    void mark_inserted(const size_t id)
+    {
+        _present[id % _capacity].store(id + 1, std::memory_order_release);
+    }
+
+    bool inserted(const size_t id) const
+    {
+        return _present[id % _capacity].load(std::memory_order_acquire) == id + 1;
+    }
+
+    // The K nearest point ids of every query among the inserted points with ids
+    // in [begin, end), written to gt[q * K ...]. Returns the number of such
+    // points.
+    size_t nearest(const size_t begin, const size_t end, const uint32_t K, std::vector<size_t> &gt) const
+    {
+        std::vector<size_t> live;
+        for (size_t id = begin; id < end; id++)
+            if (inserted(id))
+                live.push_back(id);
+
+        gt.assign(_num_queries * K, std::numeric_limits<size_t>::max());
+        std::vector<std::pair<float, size_t>> cands(live.size());
+        const size_t k = std::min<size_t>(K, live.size());
+        for (size_t q = 0; q < _num_queries; q++)
+        {
+            for (size_t i = 0; i < live.size(); i++)
+                cands[i] = std::make_pair(_dists[q * _capacity + live[i] % _capacity], live[i]);
+            std::partial_sort(cands.begin(), cands.begin() + k, cands.end());
+            for (size_t i = 0; i < k; i++)
+                gt[q * K + i] = cands[i].second;
+        }
+        return live.size();
+    }
+
+  private:
+    const T *_queries;
+    size_t _num_queries, _aligned_dim, _capacity;
+    std::unique_ptr<diskann::Distance<T>> _distance;
+    std::vector<float> _dists; // [query][slot]
+    std::unique_ptr<std::atomic<uint64_t>[]> _present;
+};
+
+double seconds_since(const Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void write_json(const std::string &path, const std::vector<std::pair<std::string, const diskann::Histogram *>> &phases,
+                const diskann::Histogram &insert_latency, const std::vector<ConsolidationResult> &consolidations,
+                const std::vector<RecallCheck> &checks, const double elapsed_seconds)
+{
+    std::ofstream out(path);
+    out << "{\"elapsed_seconds\":" << elapsed_seconds << ",\n\"search\":{";
+    for (size_t p = 0; p < phases.size(); p++)
+    {
+        const auto &h = *phases[p].second;
+        out << (p == 0 ? "" : ",") << "\"" << phases[p].first << "\":{\"count\":" << h.count()
+            << ",\"p50_us\":" << h.quantile(0.5) << ",\"p90_us\":" << h.quantile(0.9)
+            << ",\"p99_us\":" << h.quantile(0.99) << ",\"p999_us\":" << h.quantile(0.999) << "}";
+    }
+    out << "},\n\"insert\":{\"count\":" << insert_latency.count() << ",\"p50_us\":" << insert_latency.quantile(0.5)
+        << ",\"p99_us\":" << insert_latency.quantile(0.99) << "},\n\"consolidations\":[";
+    for (size_t c = 0; c < consolidations.size(); c++)
+    {
+        const auto &r = consolidations[c];
+        out << (c == 0 ? "\n" : ",\n") << "{\"start_seconds\":" << r.start_seconds
+            << ",\"duration_seconds\":" << r.duration_seconds << ",\"slots_released\":" << r.slots_released
+            << ",\"searches\":" << r.searches << ",\"search_p50_us\":" << r.search_p50_us
+            << ",\"search_p99_us\":" << r.search_p99_us << "}";
+    }
+    out << "],\n\"recall_checks\":[";
+    for (size_t c = 0; c < checks.size(); c++)
+    {
+        const auto &r = checks[c];
+        out << (c == 0 ? "\n" : ",\n") << "{\"at_seconds\":" << r.at_seconds << ",\"live_points\":" << r.live_points
+            << ",\"recall\":" << r.recall
+            << ",\"during_consolidation\":" << (r.during_consolidation ? "true" : "false") << "}";
+    }
+    out << "]}\n";
+}
+
+template <typename T> int benchmark_streaming(const diskann::Metric metric, StreamingOptions &opts)
+{
+    using TagT = uint32_t;
+
+    T *data = nullptr, *query = nullptr;
+    size_t num_points, dim, aligned_dim, query_num, query_dim, query_aligned_dim;
+    diskann::load_aligned_bin<T>(opts.data_path, data, num_points, dim, aligned_dim);
+    diskann::load_aligned_bin<T>(opts.query_file, query, query_num, query_dim, query_aligned_dim);
+    if (query_dim != dim)
+    {
+        diskann::cerr << "Query dimension " << query_dim << " does not match data dimension " << dim << std::endl;
+        return -1;
+    }
+
+    const size_t total = opts.max_points_to_insert == 0 ? num_points : opts.max_points_to_insert;
+    if (total > num_points)
+        throw diskann::ANNException(std::string("num_points(") + std::to_string(num_points) +
+                                        ") < max_points_to_insert(" + std::to_string(total) + ")",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (total < opts.active_window + opts.consolidate_interval)
+        throw diskann::ANNException("ERROR: max_points_to_insert < active_window + consolidate_interval", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+
+    // Points inserted but not yet consolidated away: the window, the batch
+    // being deleted and the batch inserted while it is consolidated.
+    const size_t capacity = opts.active_window + 2 * opts.consolidate_interval;
+
+    auto params = diskann::IndexWriteParametersBuilder(opts.Lbuild, opts.R)
+                      .with_alpha(opts.alpha)
+                      .with_num_threads(opts.insert_threads)
+                      .build();
+    auto delete_params =
+        diskann::IndexWriteParametersBuilder(params).with_num_threads(opts.consolidate_threads).build();
+    auto search_params = diskann::IndexSearchParams(opts.L, opts.search_threads);
+    auto config = diskann::IndexConfigBuilder()
+                      .with_metric(metric)
+                      .with_dimension(dim)
+                      .with_max_points(capacity)
+                      .is_dynamic_index(true)
+                      .is_enable_tags(true)
+                      .is_concurrent_consolidate(true)
+                      .is_use_opq(false)
+                      .is_filtered(false)
+                      .with_num_pq_chunks(0)
+                      .is_pq_dist_build(false)
+                      .with_num_frozen_pts(opts.num_start_pts)
+                      .with_tag_type(diskann_type_to_name<TagT>())
+                      .with_label_type(diskann_type_to_name<uint32_t>())
+                      .with_data_type(diskann_type_to_name<T>())
+                      .with_index_write_params(params)
+                      .with_index_search_params(search_params)
+                      .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
+                      .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                      .build();
+    auto index = diskann::IndexFactory(config).create_instance();
+    index->set_start_points_at_random(static_cast<T>(opts.start_point_norm));
+
+    WindowGroundTruth<T> truth(query, query_num, aligned_dim, capacity, metric);
+    diskann::Histogram insert_latency, steady_latency, consolidating_latency, all_latency;
+
+    // Point ids run from 0; the index tag of point j is j + 1 since tag 0 is
+    // reserved.
+    std::shared_timed_mutex mutation_lock;
+    std::atomic<size_t> next_insert{0}, deleted{0}, consolidated{0};
+    std::atomic<int64_t> consolidation_idx{-1};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> failed_inserts{0}, failed_deletes{0};
+    // Each inserter publishes a lower bound on the id it is inserting before
+    // claiming it, so the lowest id not yet inserted is the minimum of these
+    // and next_insert.
+    std::unique_ptr<std::atomic<size_t>[]> inserting(new std::atomic<size_t>[opts.insert_threads]);
+    for (uint32_t t = 0; t < opts.insert_threads; t++)
+        inserting[t] = total;
+    auto lowest_not_inserted = [&]() {
+        size_t lowest = next_insert.load();
+        for (uint32_t t = 0; t < opts.insert_threads; t++)
+            lowest = std::min(lowest, inserting[t].load());
+        return lowest;
+    };
+
+    auto insert_one = [&](const size_t j) {
+        truth.add(j, data + j * aligned_dim);
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(mutation_lock);
+            diskann::Timer timer;
+            if (index->insert_point(data + j * aligned_dim, static_cast<TagT>(j + 1)) != 0)
+                failed_inserts++;
+            else
+                truth.mark_inserted(j);
+            insert_latency.record(timer.elapsed());
+        }
+    };
+
+    diskann::cout << "Inserting the initial window of " << opts.active_window << " points" << std::endl;
+    diskann::Timer fill_timer;
+#pragma omp parallel for num_threads((int32_t)opts.insert_threads) schedule(dynamic)
+    for (int64_t j = 0; j < (int64_t)opts.active_window; j++)
+        insert_one((size_t)j);
+    next_insert = opts.active_window;
+    diskann::cout << "Initial window inserted in " << fill_timer.elapsed_seconds() << "s" << std::endl;
+
+    const size_t num_consolidations = (total - opts.active_window) / opts.consolidate_interval;
+    std::vector<std::unique_ptr<diskann::Histogram>> consolidation_latency;
+    for (size_t c = 0; c < num_consolidations; c++)
+        consolidation_latency.emplace_back(new diskann::Histogram());
+    std::vector<ConsolidationResult> consolidations;
+    std::vector<RecallCheck> checks;
+    std::mutex checks_mutex;
+
+    const Clock::time_point start = Clock::now();
+
+    auto check_recall = [&]() {
+        std::unique_lock<std::shared_timed_mutex> lock(mutation_lock);
+        const bool consolidating = consolidation_idx.load() >= 0;
+        std::vector<size_t> gt;
+        const size_t live = truth.nearest(deleted.load(), next_insert.load(), opts.recall_at, gt);
+        // With fewer live points than recall_at, the padding of gt must not
+        // be compared with the zero tags of missing results.
+        const size_t num_gt = std::min<size_t>(opts.recall_at, live);
+
+        std::vector<TagT> tags(opts.recall_at);
+        std::vector<T *> res_vectors;
+        size_t matches = 0;
+        for (size_t q = 0; q < query_num; q++)
+        {
+            std::fill(tags.begin(), tags.end(), 0);
+            index->search_with_tags(query + q * query_aligned_dim, opts.recall_at, opts.L, tags.data(),
+                                    (float *)nullptr, res_vectors);
+            for (uint32_t i = 0; i < opts.recall_at; i++)
+                for (size_t k = 0; k < num_gt; k++)
+                    if (gt[q * opts.recall_at + k] + 1 == tags[i])
+                        matches++;
+        }
+        const double expected = (double)query_num * num_gt;
+        RecallCheck check{seconds_since(start), live, expected > 0 ? 100.0 * matches / expected : 0, consolidating};
+        lock.unlock();
+
+        diskann::cout << "[" << std::fixed << std::setprecision(1) << check.at_seconds << "s] recall@"
+                      << opts.recall_at << " " << std::setprecision(2) << check.recall << " over " << live
+                      << " live points" << (consolidating ? " (during consolidation)" : "") << std::endl;
+        std::lock_guard<std::mutex> guard(checks_mutex);
+        checks.push_back(check);
+    };
+
+    std::vector<std::thread> inserters;
+    for (uint32_t t = 0; t < opts.insert_threads; t++)
+    {
+        inserters.emplace_back([&, t]() {
+            for (;;)
+            {
+                inserting[t] = next_insert.load();
+                const size_t j = next_insert++;
+                if (j >= total)
+                    break;
+                inserting[t] = j;
+                if (opts.insert_rate > 0)
+                    std::this_thread::sleep_until(
+                        start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                                    (j - opts.active_window) / opts.insert_rate)));
+                // Wait for the slot of point j - capacity to be consolidated.
+                while (j >= consolidated.load() + capacity)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                insert_one(j);
+            }
+            inserting[t] = total;
+        });
+    }
+
+    std::thread deleter([&]() {
+        for (size_t c = 0; c < num_consolidations; c++)
+        {
+            const size_t del_begin = c * opts.consolidate_interval;
+            const size_t del_end = del_begin + opts.consolidate_interval;
+            // Delete once every point up to a window past the batch has been
+            // inserted, so none of the batch is still being inserted.
+            while (lowest_not_inserted() < del_end + opts.active_window)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            {
+                std::shared_lock<std::shared_timed_mutex> lock(mutation_lock);
+                for (size_t j = del_begin; j < del_end; j++)
+                    if (index->lazy_delete(static_cast<TagT>(j + 1)) != 0 && truth.inserted(j))
+                        failed_deletes++;
+                deleted = del_end;
+            }
+
+            ConsolidationResult result;
+            result.start_seconds = seconds_since(start);
+            consolidation_idx = (int64_t)c;
+            auto report = index->consolidate_deletes(delete_params);
+            while (report._status != diskann::consolidation_report::status_code::SUCCESS)
+            {
+                if (report._status != diskann::consolidation_report::status_code::LOCK_FAIL &&
+                    report._status != diskann::consolidation_report::status_code::INCONSISTENT_COUNT_ERROR)
+                {
+                    std::cerr << "Exiting after unknown error in consolidate delete" << std::endl;
+                    exit(-1);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                report = index->consolidate_deletes(delete_params);
+            }
+            consolidation_idx = -1;
+            consolidated = del_end;
+
+            const auto &h = *consolidation_latency[c];
+            result.duration_seconds = seconds_since(start) - result.start_seconds;
+            result.slots_released = report._slots_released;
+            result.searches = h.count();
+            result.search_p50_us = h.quantile(0.5);
+            result.search_p99_us = h.quantile(0.99);
+            consolidations.push_back(result);
+            diskann::cout << "[" << std::fixed << std::setprecision(1) << result.start_seconds << "s] consolidation "
+                          << c + 1 << "/" << num_consolidations << ": " << std::setprecision(3)
+                          << result.duration_seconds << "s, " << result.slots_released << " slots released, "
+                          << result.searches << " searches, p50 " << result.search_p50_us << "us, p99 "
+                          << result.search_p99_us << "us" << std::endl;
+        }
+    });
+
+    std::vector<std::thread> searchers;
+    for (uint32_t t = 0; t < opts.search_threads; t++)
+    {
+        searchers.emplace_back([&, t]() {
+            std::vector<TagT> tags(opts.recall_at);
+            std::vector<T *> res_vectors;
+            for (uint64_t k = 0; !done.load(); k++)
+            {
+                // With a target rate, searches follow a fixed schedule and
+                // latency includes time spent behind schedule.
+                const uint64_t n = k * opts.search_threads + t;
+                Clock::time_point began = Clock::now();
+                if (opts.search_qps > 0)
+                {
+                    began = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(n / opts.search_qps));
+                    std::this_thread::sleep_until(began);
+                }
+                const int64_t phase = consolidation_idx.load();
+                index->search_with_tags(query + (n % query_num) * query_aligned_dim, opts.recall_at, opts.L,
+                                        tags.data(), (float *)nullptr, res_vectors);
+                const uint64_t latency_us =
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - began).count();
+
+                all_latency.record(latency_us);
+                if (phase >= 0)
+                {
+                    consolidating_latency.record(latency_us);
+                    consolidation_latency[phase]->record(latency_us);
+                }
+                else
+                    steady_latency.record(latency_us);
+            }
+        });
+    }
+
+    std::thread checker([&]() {
+        if (opts.recall_check_interval <= 0)
+            return;
+        Clock::time_point next_check = start;
+        while (!done.load())
+        {
+            next_check += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(opts.recall_check_interval));
+            while (!done.load() && Clock::now() < next_check)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (!done.load())
+                check_recall();
+        }
+    });
+
+    for (auto &t : inserters)
+        t.join();
+    deleter.join();
+    const double elapsed = seconds_since(start);
+    done = true;
+    for (auto &t : searchers)
+        t.join();
+    checker.join();
+    check_recall();
+
+    diskann::cout << std::endl
+                  << "Streamed " << total - opts.active_window << " inserts and "
+                  << num_consolidations * opts.consolidate_interval << " deletes in " << std::setprecision(2)
+                  << elapsed << "s";
+    if (failed_inserts > 0)
+        diskann::cout << ", " << failed_inserts.load() << " inserts failed";
+    if (failed_deletes > 0)
+        diskann::cout << ", " << failed_deletes.load() << " deletes failed";
+    diskann::cout << std::endl
+                  << "Insert latency p50 " << insert_latency.quantile(0.5) << "us, p99 "
+                  << insert_latency.quantile(0.99) << "us" << std::endl;
+
+    const std::vector<std::pair<std::string, const diskann::Histogram *>> phases = {
+        {"steady", &steady_latency}, {"consolidating", &consolidating_latency}, {"all", &all_latency}};
+    diskann::cout << std::setw(16) << "Search phase" << std::setw(12) << "Searches" << std::setw(12) << "p50 (us)"
+                  << std::setw(12) << "p90 (us)" << std::setw(12) << "p99 (us)" << std::setw(12) << "p99.9 (us)"
+                  << std::endl;
+    for (const auto &phase : phases)
+        diskann::cout << std::setw(16) << phase.first << std::setw(12) << phase.second->count() << std::setw(12)
+                      << phase.second->quantile(0.5) << std::setw(12) << phase.second->quantile(0.9) << std::setw(12)
+                      << phase.second->quantile(0.99) << std::setw(12) << phase.second->quantile(0.999)
+                      << std::endl;
+
+    if (!checks.empty())
+    {
+        double min_recall = 100, sum_recall = 0;
+        for (const auto &c : checks)
+        {
+            min_recall = std::min(min_recall, c.recall);
+            sum_recall += c.recall;
+        }
+        diskann::cout << "Recall@" << opts.recall_at << " over " << checks.size() << " checks: mean "
+                      << sum_recall / checks.size() << ", min " << min_recall << ", final " << checks.back().recall
+                      << std::endl;
+    }
+
+    if (!opts.json_output.empty())
+        write_json(opts.json_output, phases, insert_latency, consolidations, checks, elapsed);
+
+    diskann::aligned_free(data);
+    diskann::aligned_free(query);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn;
+    StreamingOptions opts;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "benchmark_streaming", "Measures search latency and recall under concurrent inserts and deletes")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+
+        po::options_description required_configs("Required");
+        required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                                       program_options_utils::DATA_TYPE_DESCRIPTION);
+        required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                                       program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        required_configs.add_options()("data_path", po::value<std::string>(&opts.data_path)->required(),
+                                       program_options_utils::INPUT_DATA_PATH);
+        required_configs.add_options()("query_file", po::value<std::string>(&opts.query_file)->required(),
+                                       program_options_utils::QUERY_FILE_DESCRIPTION);
+        required_configs.add_options()("active_window", po::value<uint64_t>(&opts.active_window)->required(),
+                                       "Program maintains an index over an active window of "
+                                       "this size that slides through the data");
+        required_configs.add_options()("consolidate_interval",
+                                       po::value<uint64_t>(&opts.consolidate_interval)->required(),
+                                       "Points deleted from the left of the window, and consolidated, at a time");
+        required_configs.add_options()("start_point_norm", po::value<float>(&opts.start_point_norm)->required(),
+                                       "Set the start point to a random point on a sphere of this radius");
+        required_configs.add_options()("recall_at,K", po::value<uint32_t>(&opts.recall_at)->required(),
+                                       program_options_utils::NUMBER_OF_RESULTS_DESCRIPTION);
+        required_configs.add_options()("search_list,L", po::value<uint32_t>(&opts.L)->required(),
+                                       "Size of search list to use for the searches");
+
+        po::options_description optional_configs("Optional");
+        optional_configs.add_options()("max_degree,R", po::value<uint32_t>(&opts.R)->default_value(64),
+                                       program_options_utils::MAX_BUILD_DEGREE);
+        optional_configs.add_options()("Lbuild", po::value<uint32_t>(&opts.Lbuild)->default_value(100),
+                                       program_options_utils::GRAPH_BUILD_COMPLEXITY);
+        optional_configs.add_options()("alpha", po::value<float>(&opts.alpha)->default_value(1.2f),
+                                       program_options_utils::GRAPH_BUILD_ALPHA);
+        optional_configs.add_options()(
+            "insert_threads", po::value<uint32_t>(&opts.insert_threads)->default_value(omp_get_num_procs() / 4 + 1),
+            "Number of threads inserting into the index (defaults to omp_get_num_procs()/4 + 1)");
+        optional_configs.add_options()("consolidate_threads",
+                                       po::value<uint32_t>(&opts.consolidate_threads)
+                                           ->default_value(omp_get_num_procs() / 4 + 1),
+                                       "Number of threads used for consolidating deletes to the index (defaults to "
+                                       "omp_get_num_procs()/4 + 1)");
+        optional_configs.add_options()(
+            "search_threads", po::value<uint32_t>(&opts.search_threads)->default_value(omp_get_num_procs() / 2 + 1),
+            "Number of threads searching the index (defaults to omp_get_num_procs()/2 + 1)");
+        optional_configs.add_options()("max_points_to_insert",
+                                       po::value<uint64_t>(&opts.max_points_to_insert)->default_value(0),
+                                       "The number of points from the file that the program streams over.  "
+                                       "Default: all of them");
+        optional_configs.add_options()(
+            "num_start_points",
+            po::value<uint32_t>(&opts.num_start_pts)->default_value(diskann::defaults::NUM_FROZEN_POINTS_DYNAMIC),
+            "Set the number of random start (frozen) points to use when inserting and searching");
+        optional_configs.add_options()("insert_rate", po::value<double>(&opts.insert_rate)->default_value(0),
+                                       "Points inserted per second over all insert threads after the initial "
+                                       "window.  Default: as fast as possible");
+        optional_configs.add_options()("search_qps", po::value<double>(&opts.search_qps)->default_value(0),
+                                       "Searches per second over all search threads, following a fixed "
+                                       "schedule.  Default: each thread searches back to back");
+        optional_configs.add_options()("recall_check_interval",
+                                       po::value<double>(&opts.recall_check_interval)->default_value(1.0),
+                                       "Seconds between recall checks, 0 to only check at the end");
+        optional_configs.add_options()("json_output",
+                                       po::value<std::string>(&opts.json_output)->default_value(std::string("")),
+                                       "Write the results to this file as JSON");
+
+        desc.add(required_configs).add(optional_configs);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    if (opts.start_point_norm == 0)
+    {
+        std::cerr << "Use a start point with a non-zero norm" << std::endl;
+        return -1;
+    }
+    if (opts.insert_threads == 0 || opts.consolidate_threads == 0 || opts.search_threads == 0)
+    {
+        std::cerr << "Need at least one thread of each kind" << std::endl;
+        return -1;
+    }
+    if (opts.active_window < opts.insert_threads || opts.consolidate_interval == 0)
+    {
+        std::cerr << "active_window must be at least insert_threads and consolidate_interval positive" << std::endl;
+        return -1;
+    }
+    if (opts.L < opts.recall_at)
+    {
+        std::cerr << "Search list size must be at least K" << std::endl;
+        return -1;
+    }
+
+    diskann::Metric metric;
+    if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("mips"))
+        metric = diskann::Metric::INNER_PRODUCT;
+    else
+    {
+        std::cerr << "Invalid distance function. Supported functions are l2 and mips" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("float"))
+            return benchmark_streaming<float>(metric, opts);
+        else if (data_type == std::string("int8"))
+            return benchmark_streaming<int8_t>(metric, opts);
+        else if (data_type == std::string("uint8"))
+            return benchmark_streaming<uint8_t>(metric, opts);
+        else
+        {
+            std::cerr << "Invalid data type. Supported types are int8, uint8 and float" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -21,6 +21,7 @@ int main(int argc, char **argv)
     float B, M;
     bool append_reorder_data = false;
     bool use_opq = false;
+    bool checkpoint = false, verify_checkpoint = false;
 
     po::options_description desc{
         program_options_utils::make_program_description("build_disk_index", "Build a disk-based index.")};
@@ -78,6 +79,13 @@ int main(int argc, char **argv)
                                        "internally where each node has a maximum F labels.");
         optional_configs.add_options()("label_type", po::value<std::string>(&label_type)->default_value("uint"),
                                        program_options_utils::LABEL_TYPE_DESCRIPTION);
+        optional_configs.add_options()("checkpoint", po::bool_switch()->default_value(false),
+                                       "Record completed build stages in <index_path_prefix>_build_manifest.txt and "
+                                       "skip them when the build is rerun with the same parameters. Intermediate "
+                                       "files are kept so they can be reused.");
+        optional_configs.add_options()("verify_checkpoint", po::bool_switch()->default_value(false),
+                                       "With --checkpoint, checksum the kept files before reusing them instead of "
+                                       "only checking their size and modification time. Reads every file in full.");
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -94,6 +102,10 @@ int main(int argc, char **argv)
             append_reorder_data = true;
         if (vm["use_opq"].as<bool>())
             use_opq = true;
+        if (vm["checkpoint"].as<bool>())
+            checkpoint = true;
+        if (vm["verify_checkpoint"].as<bool>())
+            verify_checkpoint = true;
     }
     catch (const std::exception &ex)
     {
@@ -144,17 +156,17 @@ int main(int argc, char **argv)
         if (label_file != "" && label_type == "ushort")
         {
             if (data_type == std::string("int8"))
-                return diskann::build_disk_index<int8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
-                                                         metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                         universal_label, filter_threshold, Lf);
+                return diskann::build_disk_index<int8_t>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else if (data_type == std::string("uint8"))
                 return diskann::build_disk_index<uint8_t, uint16_t>(
                     data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
-                    use_filters, label_file, universal_label, filter_threshold, Lf);
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else if (data_type == std::string("float"))
                 return diskann::build_disk_index<float, uint16_t>(
                     data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
-                    use_filters, label_file, universal_label, filter_threshold, Lf);
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else
             {
                 diskann::cerr << "Error. Unsupported data type" << std::endl;
@@ -164,17 +176,17 @@ int main(int argc, char **argv)
         else
         {
             if (data_type == std::string("int8"))
-                return diskann::build_disk_index<int8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
-                                                         metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                         universal_label, filter_threshold, Lf);
+                return diskann::build_disk_index<int8_t>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else if (data_type == std::string("uint8"))
-                return diskann::build_disk_index<uint8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
-                                                          metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                          universal_label, filter_threshold, Lf);
+                return diskann::build_disk_index<uint8_t>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else if (data_type == std::string("float"))
-                return diskann::build_disk_index<float>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
-                                                        metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                        universal_label, filter_threshold, Lf);
+                return diskann::build_disk_index<float>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, checkpoint, verify_checkpoint);
             else
             {
                 diskann::cerr << "Error. Unsupported data type" << std::endl;
@@ -25,8 +25,8 @@ namespace po = boost::program_options;
 int main(int argc, char **argv)
 {
     std::string data_type, dist_fn, data_path, index_path_prefix, label_file, universal_label, label_type;
-    uint32_t num_threads, R, L, Lf, build_PQ_bytes;
-    float alpha;
+    uint32_t num_threads, R, L, Lf, L1, knn_seed_K, build_PQ_bytes;
+    float alpha, alpha1, first_pass_sample_rate;
     bool use_pq_build, use_opq;
 
     po::options_description desc{
@@ -57,6 +57,15 @@ int main(int argc, char **argv)
                                        program_options_utils::GRAPH_BUILD_COMPLEXITY);
         optional_configs.add_options()("alpha", po::value<float>(&alpha)->default_value(1.2f),
                                        program_options_utils::GRAPH_BUILD_ALPHA);
+        optional_configs.add_options()("first_pass_L", po::value<uint32_t>(&L1)->default_value(0),
+                                       program_options_utils::FIRST_PASS_LBUILD);
+        optional_configs.add_options()("first_pass_alpha", po::value<float>(&alpha1)->default_value(1.0f),
+                                       program_options_utils::FIRST_PASS_ALPHA);
+        optional_configs.add_options()("first_pass_sample_rate",
+                                       po::value<float>(&first_pass_sample_rate)->default_value(1.0f),
+                                       program_options_utils::FIRST_PASS_SAMPLE_RATE);
+        optional_configs.add_options()("knn_seed_K", po::value<uint32_t>(&knn_seed_K)->default_value(0),
+                                       program_options_utils::KNN_SEED_K);
         optional_configs.add_options()("build_PQ_bytes", po::value<uint32_t>(&build_PQ_bytes)->default_value(0),
                                        program_options_utils::BUIlD_GRAPH_PQ_BYTES);
         optional_configs.add_options()("use_opq", po::bool_switch()->default_value(false),
@@ -112,6 +121,13 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (knn_seed_K > 0 && (metric != diskann::Metric::L2 || !label_file.empty()))
+    {
+        std::cout << "kNN seeding (--knn_seed_K) is only supported for unfiltered builds with the l2 metric."
+                  << std::endl;
+        return -1;
+    }
+
     try
     {
         diskann::cout << "Starting index build with R: " << R << "  Lbuild: " << L << "  alpha: " << alpha
@@ -125,6 +141,10 @@ int main(int argc, char **argv)
                                       .with_alpha(alpha)
                                       .with_saturate_graph(false)
                                       .with_num_threads(num_threads)
+                                      .with_first_pass_list_size(L1)
+                                      .with_first_pass_alpha(alpha1)
+                                      .with_first_pass_sample_rate(first_pass_sample_rate)
+                                      .with_knn_seed_degree(knn_seed_K)
                                       .build();
 
         auto filter_params = diskann::IndexFilterParamsBuilder()
@@ -21,7 +21,22 @@
 #include "program_options_utils.hpp"
 
 namespace po = boost::program_options;
-typedef std::tuple<std::vector<std::vector<uint32_t>>, uint64_t> stitch_indices_return_values;
+
+/*
+ * Adjacency of the stitched graph in one flat array: the neighbors of point i
+ * are edges[offsets[i]] up to edges[offsets[i + 1]].
+ */
+struct flat_graph
+{
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> edges;
+
+    uint32_t degree(size_t point) const
+    {
+        return (uint32_t)(offsets[point + 1] - offsets[point]);
+    }
+};
+typedef std::tuple<flat_graph, uint64_t> stitch_indices_return_values;
 
 /*
  * Inline function to display progress bar.
@@ -117,9 +132,8 @@ void handle_args(int argc, char **argv, std::string &data_type, path &input_data
  *  4. labels (redundant for static indices)
  */
 void save_full_index(path final_index_path_prefix, path input_data_path, uint64_t final_index_size,
-                     std::vector<std::vector<uint32_t>> stitched_graph,
-                     tsl::robin_map<std::string, uint32_t> entry_points, std::string universal_label,
-                     path label_data_path)
+                     const flat_graph &stitched_graph, const tsl::robin_map<std::string, uint32_t> &entry_points,
+                     std::string universal_label, path label_data_path)
 {
     // aux. file 1
     auto saving_index_timer = std::chrono::high_resolution_clock::now();
@@ -166,9 +180,10 @@ void save_full_index(path final_index_path_prefix, path input_data_path, uint64_
     uint64_t index_num_frozen_points = 0, index_num_edges = 0;
     uint32_t index_max_observed_degree = 0, index_entry_point = 0;
     const size_t METADATA = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
-    for (auto &point_neighbors : stitched_graph)
+    const size_t number_of_points = stitched_graph.offsets.size() - 1;
+    for (size_t node_point = 0; node_point < number_of_points; node_point++)
     {
-        index_max_observed_degree = std::max(index_max_observed_degree, (uint32_t)point_neighbors.size());
+        index_max_observed_degree = std::max(index_max_observed_degree, stitched_graph.degree(node_point));
     }
 
     std::ofstream stitched_graph_writer;
@@ -181,17 +196,13 @@ void save_full_index(path final_index_path_prefix, path input_data_path, uint64_
     stitched_graph_writer.write((char *)&index_num_frozen_points, sizeof(uint64_t));
 
     size_t bytes_written = METADATA;
-    for (uint32_t node_point = 0; node_point < stitched_graph.size(); node_point++)
+    for (size_t node_point = 0; node_point < number_of_points; node_point++)
     {
-        uint32_t current_node_num_neighbors = (uint32_t)stitched_graph[node_point].size();
-        std::vector<uint32_t> current_node_neighbors = stitched_graph[node_point];
+        uint32_t current_node_num_neighbors = stitched_graph.degree(node_point);
         stitched_graph_writer.write((char *)&current_node_num_neighbors, sizeof(uint32_t));
-        bytes_written += sizeof(uint32_t);
-        for (const auto &current_node_neighbor : current_node_neighbors)
-        {
-            stitched_graph_writer.write((char *)&current_node_neighbor, sizeof(uint32_t));
-            bytes_written += sizeof(uint32_t);
-        }
+        stitched_graph_writer.write((char *)(stitched_graph.edges.data() + stitched_graph.offsets[node_point]),
+                                    current_node_num_neighbors * sizeof(uint32_t));
+        bytes_written += sizeof(uint32_t) * (current_node_num_neighbors + 1);
         index_num_edges += current_node_num_neighbors;
     }
 
@@ -205,7 +216,7 @@ void save_full_index(path final_index_path_prefix, path input_data_path, uint64_
 
     std::chrono::duration<double> saving_index_time = std::chrono::high_resolution_clock::now() - saving_index_timer;
     std::cout << "Stitched graph written in " << saving_index_time.count() << " seconds" << std::endl;
-    std::cout << "Stitched graph average degree: " << ((float)index_num_edges) / ((float)(stitched_graph.size()))
+    std::cout << "Stitched graph average degree: " << ((float)index_num_edges) / ((float)(number_of_points))
               << std::endl;
     std::cout << "Stitched graph max degree: " << index_max_observed_degree << std::endl << std::endl;
 }
@@ -214,56 +225,107 @@ void save_full_index(path final_index_path_prefix, path input_data_path, uint64_
  * Unions the per-label graph indices together via the following policy:
  *  - any two nodes can only have at most one edge between them -
  *
+ * Labels are processed in parallel, in two passes over the per-label indices:
+ * the first counts the edges each point receives so that the union can be
+ * laid out in one preallocated flat array, and the second fills it. The
+ * neighbors of each point are then sorted and deduplicated in parallel. Peak
+ * memory is the union plus one per-label index per thread.
+ *
  * Returns the "stitched" graph and its expected file size.
  */
 template <typename T>
 stitch_indices_return_values stitch_label_indices(
-    path final_index_path_prefix, uint32_t total_number_of_points, label_set all_labels,
-    tsl::robin_map<std::string, uint32_t> labels_to_number_of_points,
+    path final_index_path_prefix, uint32_t total_number_of_points, const label_set &all_labels,
+    const tsl::robin_map<std::string, uint32_t> &labels_to_number_of_points,
     tsl::robin_map<std::string, uint32_t> &label_entry_points,
-    tsl::robin_map<std::string, std::vector<uint32_t>> label_id_to_orig_id_map)
+    const tsl::robin_map<std::string, std::vector<uint32_t>> &label_id_to_orig_id_map)
 {
-    size_t final_index_size = 0;
-    std::vector<std::vector<uint32_t>> stitched_graph(total_number_of_points);
-
     auto stitching_index_timer = std::chrono::high_resolution_clock::now();
-    for (const auto &lbl : all_labels)
-    {
-        path curr_label_index_path(final_index_path_prefix + "_" + lbl);
+    const std::vector<std::string> labels(all_labels.begin(), all_labels.end());
+    const int64_t number_of_labels = (int64_t)labels.size();
+
+    // Calls visit(original_point_id, label_index_neighbors, orig_ids) for every
+    // node of the label's index.
+    auto for_each_label_node = [&](const std::string &lbl, const auto &visit) {
         std::vector<std::vector<uint32_t>> curr_label_index;
         uint64_t curr_label_index_size;
-        uint32_t curr_label_entry_point;
-
-        std::tie(curr_label_index, curr_label_index_size) =
-            diskann::load_label_index(curr_label_index_path, labels_to_number_of_points[lbl]);
-        curr_label_entry_point = (uint32_t)random(0, curr_label_index.size());
-        label_entry_points[lbl] = label_id_to_orig_id_map[lbl][curr_label_entry_point];
-
+        std::tie(curr_label_index, curr_label_index_size) = diskann::load_label_index(
+            final_index_path_prefix + "_" + lbl, labels_to_number_of_points.at(lbl));
+        const std::vector<uint32_t> &orig_ids = label_id_to_orig_id_map.at(lbl);
         for (uint32_t node_point = 0; node_point < curr_label_index.size(); node_point++)
-        {
-            uint32_t original_point_id = label_id_to_orig_id_map[lbl][node_point];
-            for (auto &node_neighbor : curr_label_index[node_point])
+            visit(orig_ids[node_point], curr_label_index[node_point], orig_ids);
+        return curr_label_index.size();
+    };
+
+    flat_graph stitched_graph;
+    stitched_graph.offsets.assign((size_t)total_number_of_points + 1, 0);
+    std::vector<uint32_t> entry_points(labels.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t i = 0; i < number_of_labels; i++)
+    {
+        const size_t label_points =
+            for_each_label_node(labels[i], [&](uint32_t original_point_id, const std::vector<uint32_t> &neighbors,
+                                               const std::vector<uint32_t> &) {
+#pragma omp atomic
+                stitched_graph.offsets[original_point_id + 1] += neighbors.size();
+            });
+        entry_points[i] = label_id_to_orig_id_map.at(labels[i])[random(0, label_points - 1)];
+    }
+    for (size_t node_point = 0; node_point < total_number_of_points; node_point++)
+        stitched_graph.offsets[node_point + 1] += stitched_graph.offsets[node_point];
+    for (int64_t i = 0; i < number_of_labels; i++)
+        label_entry_points[labels[i]] = entry_points[i];
+
+    stitched_graph.edges.resize(stitched_graph.offsets[total_number_of_points]);
+    std::vector<uint64_t> fill_positions(stitched_graph.offsets.begin(), stitched_graph.offsets.end() - 1);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t i = 0; i < number_of_labels; i++)
+    {
+        for_each_label_node(labels[i], [&](uint32_t original_point_id, const std::vector<uint32_t> &neighbors,
+                                           const std::vector<uint32_t> &orig_ids) {
+            uint64_t position;
+#pragma omp atomic capture
             {
-                uint32_t original_neighbor_id = label_id_to_orig_id_map[lbl][node_neighbor];
-                std::vector<uint32_t> curr_point_neighbors = stitched_graph[original_point_id];
-                if (std::find(curr_point_neighbors.begin(), curr_point_neighbors.end(), original_neighbor_id) ==
-                    curr_point_neighbors.end())
-                {
-                    stitched_graph[original_point_id].push_back(original_neighbor_id);
-                    final_index_size += sizeof(uint32_t);
-                }
+                position = fill_positions[original_point_id];
+                fill_positions[original_point_id] += neighbors.size();
             }
-        }
+            for (const auto node_neighbor : neighbors)
+                stitched_graph.edges[position++] = orig_ids[node_neighbor];
+        });
+    }
+    fill_positions.clear();
+    fill_positions.shrink_to_fit();
+
+    std::vector<uint32_t> unique_degrees(total_number_of_points);
+#pragma omp parallel for schedule(dynamic, 8192)
+    for (int64_t node_point = 0; node_point < (int64_t)total_number_of_points; node_point++)
+    {
+        auto begin = stitched_graph.edges.begin() + stitched_graph.offsets[node_point];
+        auto end = stitched_graph.edges.begin() + stitched_graph.offsets[node_point + 1];
+        std::sort(begin, end);
+        unique_degrees[node_point] = (uint32_t)(std::unique(begin, end) - begin);
+    }
+
+    // Compact the deduplicated lists towards the front, in place.
+    uint64_t write_position = 0;
+    for (size_t node_point = 0; node_point < total_number_of_points; node_point++)
+    {
+        auto begin = stitched_graph.edges.begin() + stitched_graph.offsets[node_point];
+        std::copy(begin, begin + unique_degrees[node_point], stitched_graph.edges.begin() + write_position);
+        stitched_graph.offsets[node_point] = write_position;
+        write_position += unique_degrees[node_point];
     }
+    stitched_graph.offsets[total_number_of_points] = write_position;
+    stitched_graph.edges.resize(write_position);
 
     const size_t METADATA = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
-    final_index_size += (total_number_of_points * sizeof(uint32_t) + METADATA);
+    size_t final_index_size = (write_position + total_number_of_points) * sizeof(uint32_t) + METADATA;
 
     std::chrono::duration<double> stitching_index_time =
         std::chrono::high_resolution_clock::now() - stitching_index_timer;
     std::cout << "stitched graph generated in memory in " << stitching_index_time.count() << " seconds" << std::endl;
 
-    return std::make_tuple(stitched_graph, final_index_size);
+    return std::make_tuple(std::move(stitched_graph), final_index_size);
 }
 
 /*
@@ -275,9 +337,7 @@ stitch_indices_return_values stitch_label_indices(
  */
 template <typename T>
 void prune_and_save(path final_index_path_prefix, path full_index_path_prefix, path input_data_path,
-                    std::vector<std::vector<uint32_t>> stitched_graph, uint32_t stitched_R,
-                    tsl::robin_map<std::string, uint32_t> label_entry_points, std::string universal_label,
-                    path label_data_path, uint32_t num_threads)
+                    uint32_t stitched_R, std::string universal_label, path label_data_path, uint32_t num_threads)
 {
     size_t dimension, number_of_label_points;
     auto diskann_cout_buffer = diskann::cout.rdbuf(nullptr);
@@ -340,6 +400,7 @@ int main(int argc, char **argv)
     auto index_timer = std::chrono::high_resolution_clock::now();
     handle_args(argc, argv, data_type, input_data_path, final_index_path_prefix, label_data_path, universal_label,
                 num_threads, R, L, stitched_R, alpha);
+    omp_set_num_threads(num_threads);
 
     path labels_file_to_use = final_index_path_prefix + "_label_formatted.txt";
     path labels_map_file = final_index_path_prefix + "_labels_map.txt";
@@ -398,7 +459,7 @@ int main(int argc, char **argv)
         throw;
 
     // 5. "stitch" the indices together
-    std::vector<std::vector<uint32_t>> stitched_graph;
+    flat_graph stitched_graph;
     tsl::robin_map<std::string, uint32_t> label_entry_points;
     uint64_t stitched_graph_size;
 
@@ -420,17 +481,19 @@ int main(int argc, char **argv)
     // 5a. save the stitched graph to disk
     save_full_index(full_index_path_prefix, input_data_path, stitched_graph_size, stitched_graph, label_entry_points,
                     universal_label, labels_file_to_use);
+    // pruning reloads the stitched graph from disk
+    stitched_graph = flat_graph();
 
     // 6. run a prune on the stitched index, and save to disk
     if (data_type == "uint8")
-        prune_and_save<uint8_t>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_graph,
-                                stitched_R, label_entry_points, universal_label, labels_file_to_use, num_threads);
+        prune_and_save<uint8_t>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_R,
+                                universal_label, labels_file_to_use, num_threads);
     else if (data_type == "int8")
-        prune_and_save<int8_t>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_graph,
-                               stitched_R, label_entry_points, universal_label, labels_file_to_use, num_threads);
+        prune_and_save<int8_t>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_R,
+                               universal_label, labels_file_to_use, num_threads);
     else if (data_type == "float")
-        prune_and_save<float>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_graph,
-                              stitched_R, label_entry_points, universal_label, labels_file_to_use, num_threads);
+        prune_and_save<float>(final_index_path_prefix, full_index_path_prefix, input_data_path, stitched_R,
+                              universal_label, labels_file_to_use, num_threads);
     else
         throw;
 
@@ -294,7 +294,8 @@ int main(int argc, char **argv)
                                        po::value<std::vector<uint32_t>>(&Lvec)->multitoken()->required(),
                                        program_options_utils::SEARCH_LIST_DESCRIPTION);
         required_configs.add_options()("range_threshold,K", po::value<float>(&range)->required(),
-                                       "Number of neighbors to be returned");
+                                       "Radius of the search: squared L2 for l2/cosine, smallest inner product "
+                                       "for mips");
 
         // Optional parameters
         po::options_description optional_configs("Optional");
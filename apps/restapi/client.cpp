@@ -69,11 +69,87 @@ void query_loop(const std::string &ip_addr_port, const std::string &query_file,
     }
 }
 
+template <typename T>
+void binary_query_loop(const std::string &ip_addr_port, const std::string &query_file, const unsigned nq,
+                       const unsigned Ls, const unsigned k_value, const unsigned batch_size)
+{
+    web::http::client::http_client client(U(ip_addr_port));
+
+    T *data;
+    size_t npts = 1, ndims = 128, rounded_dim = 128;
+    diskann::load_aligned_bin<T>(query_file, data, npts, ndims, rounded_dim);
+
+    const unsigned num_queries = (std::min)(nq, (unsigned)npts);
+    for (unsigned start = 0; start < num_queries; start += batch_size)
+    {
+        const unsigned count = (std::min)(batch_size, num_queries - start);
+
+        BinaryQueryHeader header;
+        header.magic = BINARY_PROTOCOL_MAGIC;
+        header.num_queries = count;
+        header.dimensions = (uint32_t)ndims;
+        header.k = k_value;
+        header.Ls = Ls;
+
+        std::vector<unsigned char> body(sizeof(header) + (size_t)count * ndims * sizeof(T));
+        memcpy(body.data(), &header, sizeof(header));
+        for (unsigned i = 0; i < count; i++)
+        {
+            memcpy(body.data() + sizeof(header) + i * ndims * sizeof(T), data + (size_t)(start + i) * rounded_dim,
+                   ndims * sizeof(T));
+        }
+
+        web::http::http_request http_query(methods::POST);
+        http_query.set_body(std::move(body));
+
+        client.request(http_query)
+            .then([](web::http::http_response response) { return response.extract_vector(); })
+            .then([start](pplx::task<std::vector<unsigned char>> previousTask) {
+                try
+                {
+                    std::vector<unsigned char> response = previousTask.get();
+                    BinaryResponseHeader response_header;
+                    if (response.size() < sizeof(response_header))
+                    {
+                        std::cerr << "Query batch failed: " << std::string(response.begin(), response.end())
+                                  << std::endl;
+                        return;
+                    }
+                    memcpy(&response_header, response.data(), sizeof(response_header));
+                    if (response_header.magic != BINARY_PROTOCOL_MAGIC)
+                    {
+                        std::cerr << "Query batch failed: " << std::string(response.begin(), response.end())
+                                  << std::endl;
+                        return;
+                    }
+
+                    const uint32_t *ids = (const uint32_t *)(response.data() + sizeof(response_header));
+                    const float *dists = (const float *)(ids + response_header.num_queries * response_header.k);
+                    for (uint32_t q = 0; q < response_header.num_queries; q++)
+                    {
+                        std::cout << start + q << ":";
+                        for (uint32_t j = 0; j < response_header.k; j++)
+                            std::cout << " " << ids[q * response_header.k + j] << "("
+                                      << dists[q * response_header.k + j] << ")";
+                        std::cout << std::endl;
+                    }
+                    std::cout << "Batch time: " << response_header.time_taken_in_us << "us" << std::endl;
+                }
+                catch (http_exception const &e)
+                {
+                    std::wcout << e.what() << std::endl;
+                }
+            })
+            .wait();
+    }
+    diskann::aligned_free(data);
+}
+
 int main(int argc, char *argv[])
 {
     std::string data_type, query_file, address;
     uint32_t num_queries;
-    uint32_t l_search, k_value;
+    uint32_t l_search, k_value, batch_size;
 
     po::options_description desc{"Arguments"};
     try
@@ -87,6 +163,9 @@ int main(int argc, char *argv[])
                            "Number of queries to search");
         desc.add_options()("l_search", po::value<uint32_t>(&l_search)->required(), "Value of L");
         desc.add_options()("k_value,K", po::value<uint32_t>(&k_value)->default_value(10), "Value of K (default 10)");
+        desc.add_options()("batch_size", po::value<uint32_t>(&batch_size)->default_value(0),
+                           "Send the queries in batches of this size with the binary protocol; 0 sends one JSON "
+                           "request per query");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         if (vm.count("help"))
@@ -104,15 +183,24 @@ int main(int argc, char *argv[])
 
     if (data_type == std::string("float"))
     {
-        query_loop<float>(address, query_file, num_queries, l_search, k_value);
+        if (batch_size > 0)
+            binary_query_loop<float>(address, query_file, num_queries, l_search, k_value, batch_size);
+        else
+            query_loop<float>(address, query_file, num_queries, l_search, k_value);
     }
     else if (data_type == std::string("int8"))
     {
-        query_loop<int8_t>(address, query_file, num_queries, l_search, k_value);
+        if (batch_size > 0)
+            binary_query_loop<int8_t>(address, query_file, num_queries, l_search, k_value, batch_size);
+        else
+            query_loop<int8_t>(address, query_file, num_queries, l_search, k_value);
     }
     else if (data_type == std::string("uint8"))
     {
-        query_loop<uint8_t>(address, query_file, num_queries, l_search, k_value);
+        if (batch_size > 0)
+            binary_query_loop<uint8_t>(address, query_file, num_queries, l_search, k_value, batch_size);
+        else
+            query_loop<uint8_t>(address, query_file, num_queries, l_search, k_value);
     }
     else
     {
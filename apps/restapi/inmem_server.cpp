@@ -16,6 +16,7 @@ namespace po = boost::program_options;
 
 std::unique_ptr<Server> g_httpServer(nullptr);
 std::vector<std::unique_ptr<diskann::BaseSearch>> g_inMemorySearch;
+bool g_debug = false;
 
 void setup(const utility::string_t &address, const std::string &typestring)
 {
@@ -24,7 +25,7 @@ void setup(const utility::string_t &address, const std::string &typestring)
 
     std::cout << "Attempting to start server on " << uri.to_string() << std::endl;
 
-    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_inMemorySearch, typestring));
+    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_inMemorySearch, typestring, 0, 0, false, g_debug));
     std::cout << "Created a server object" << std::endl;
 
     g_httpServer->open().wait();
@@ -41,6 +42,7 @@ int main(int argc, char *argv[])
     std::string data_type, index_file, data_file, address, dist_fn, tags_file;
     uint32_t num_threads;
     uint32_t l_search;
+    diskann::AdmissionParams admission;
 
     po::options_description desc{"Arguments"};
     try
@@ -59,6 +61,18 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("max_in_flight", po::value<uint32_t>(&admission.max_in_flight)->default_value(0),
+                           "Maximum number of concurrent searches per index, 0 disables admission control");
+        desc.add_options()("max_queue_depth", po::value<uint32_t>(&admission.max_queue_depth)->default_value(0),
+                           "Maximum number of searches waiting for a slot before new ones are rejected");
+        desc.add_options()("max_queue_wait_ms",
+                           po::value<uint32_t>(&admission.max_queue_wait_ms)->default_value(0),
+                           "Maximum time in milliseconds a search waits for a slot, 0 waits indefinitely");
+        desc.add_options()("degrade_queue_depth",
+                           po::value<uint32_t>(&admission.degrade_queue_depth)->default_value(0),
+                           "Queue depth from which searches run with a reduced L and beamwidth, 0 never degrades");
+        desc.add_options()("debug", po::bool_switch(&g_debug)->default_value(false),
+                           "Log every request and response");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         if (vm.count("help"))
@@ -107,6 +121,9 @@ int main(int argc, char *argv[])
         std::cerr << "Unsupported data type " << argv[2] << std::endl;
     }
 
+    for (auto &searcher : g_inMemorySearch)
+        searcher->set_admission_params(admission);
+
     while (1)
     {
         try
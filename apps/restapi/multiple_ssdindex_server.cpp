@@ -17,6 +17,8 @@ namespace po = boost::program_options;
 
 std::unique_ptr<Server> g_httpServer(nullptr);
 std::vector<std::unique_ptr<diskann::BaseSearch>> g_ssdSearch;
+uint32_t g_shard_threads = 0, g_shard_timeout_ms = 0;
+bool g_partial_results = false, g_debug = false;
 
 void setup(const utility::string_t &address, const std::string &typestring)
 {
@@ -25,7 +27,8 @@ void setup(const utility::string_t &address, const std::string &typestring)
 
     std::cout << "Attempting to start server on " << uri.to_string() << std::endl;
 
-    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_ssdSearch, typestring));
+    g_httpServer = std::unique_ptr<Server>(
+        new Server(uri, g_ssdSearch, typestring, g_shard_threads, g_shard_timeout_ms, g_partial_results, g_debug));
     std::cout << "Created a server object" << std::endl;
 
     g_httpServer->open().wait();
@@ -42,6 +45,8 @@ int main(int argc, char *argv[])
     std::string data_type, index_prefix_paths, address, dist_fn, tags_file;
     uint32_t num_nodes_to_cache;
     uint32_t num_threads;
+    diskann::AdmissionParams admission;
+    uint32_t beamwidth;
 
     po::options_description desc{"Arguments"};
     try
@@ -60,6 +65,27 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("beamwidth,W", po::value<uint32_t>(&beamwidth)->default_value(diskann::DEFAULT_W),
+                           "Beamwidth for search");
+        desc.add_options()("max_in_flight", po::value<uint32_t>(&admission.max_in_flight)->default_value(0),
+                           "Maximum number of concurrent searches per index, 0 disables admission control");
+        desc.add_options()("max_queue_depth", po::value<uint32_t>(&admission.max_queue_depth)->default_value(0),
+                           "Maximum number of searches waiting for a slot before new ones are rejected");
+        desc.add_options()("max_queue_wait_ms",
+                           po::value<uint32_t>(&admission.max_queue_wait_ms)->default_value(0),
+                           "Maximum time in milliseconds a search waits for a slot, 0 waits indefinitely");
+        desc.add_options()("degrade_queue_depth",
+                           po::value<uint32_t>(&admission.degrade_queue_depth)->default_value(0),
+                           "Queue depth from which searches run with a reduced L and beamwidth, 0 never degrades");
+        desc.add_options()("shard_threads", po::value<uint32_t>(&g_shard_threads)->default_value(0),
+                           "Number of threads, shared by all requests, searching the indices of queries "
+                           "concurrently (defaults to the number of hardware threads, at least one per index)");
+        desc.add_options()("shard_timeout_ms", po::value<uint32_t>(&g_shard_timeout_ms)->default_value(0),
+                           "Time in milliseconds to wait for every index to answer a query, 0 waits forever");
+        desc.add_options()("partial_results", po::bool_switch(&g_partial_results)->default_value(false),
+                           "Answer from the indices that responded in time instead of failing the query");
+        desc.add_options()("debug", po::bool_switch(&g_debug)->default_value(false),
+                           "Log every request and response");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -123,7 +149,8 @@ int main(int argc, char *argv[])
         for (auto &index_tag : index_tag_paths)
         {
             auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<float>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
+                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric,
+                beamwidth));
             g_ssdSearch.push_back(std::move(searcher));
         }
     }
@@ -132,7 +159,8 @@ int main(int argc, char *argv[])
         for (auto &index_tag : index_tag_paths)
         {
             auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<int8_t>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
+                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric,
+                beamwidth));
             g_ssdSearch.push_back(std::move(searcher));
         }
     }
@@ -141,7 +169,8 @@ int main(int argc, char *argv[])
         for (auto &index_tag : index_tag_paths)
         {
             auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<uint8_t>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
+                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric,
+                beamwidth));
             g_ssdSearch.push_back(std::move(searcher));
         }
     }
@@ -151,6 +180,9 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    for (auto &searcher : g_ssdSearch)
+        searcher->set_admission_params(admission);
+
     while (1)
     {
         try
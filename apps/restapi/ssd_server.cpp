@@ -17,6 +17,7 @@ namespace po = boost::program_options;
 
 std::unique_ptr<Server> g_httpServer(nullptr);
 std::vector<std::unique_ptr<diskann::BaseSearch>> g_ssdSearch;
+bool g_debug = false;
 
 void setup(const utility::string_t &address, const std::string &typestring)
 {
@@ -25,7 +26,7 @@ void setup(const utility::string_t &address, const std::string &typestring)
 
     std::cout << "Attempting to start server on " << uri.to_string() << std::endl;
 
-    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_ssdSearch, typestring));
+    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_ssdSearch, typestring, 0, 0, false, g_debug));
     std::cout << "Created a server object" << std::endl;
 
     g_httpServer->open().wait();
@@ -42,6 +43,8 @@ int main(int argc, char *argv[])
     std::string data_type, index_path_prefix, address, dist_fn, tags_file;
     uint32_t num_nodes_to_cache;
     uint32_t num_threads;
+    diskann::AdmissionParams admission;
+    uint32_t beamwidth;
 
     po::options_description desc{"Arguments"};
     try
@@ -60,6 +63,20 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("beamwidth,W", po::value<uint32_t>(&beamwidth)->default_value(diskann::DEFAULT_W),
+                           "Beamwidth for search");
+        desc.add_options()("max_in_flight", po::value<uint32_t>(&admission.max_in_flight)->default_value(0),
+                           "Maximum number of concurrent searches per index, 0 disables admission control");
+        desc.add_options()("max_queue_depth", po::value<uint32_t>(&admission.max_queue_depth)->default_value(0),
+                           "Maximum number of searches waiting for a slot before new ones are rejected");
+        desc.add_options()("max_queue_wait_ms",
+                           po::value<uint32_t>(&admission.max_queue_wait_ms)->default_value(0),
+                           "Maximum time in milliseconds a search waits for a slot, 0 waits indefinitely");
+        desc.add_options()("degrade_queue_depth",
+                           po::value<uint32_t>(&admission.degrade_queue_depth)->default_value(0),
+                           "Queue depth from which searches run with a reduced L and beamwidth, 0 never degrades");
+        desc.add_options()("debug", po::bool_switch(&g_debug)->default_value(false),
+                           "Log every request and response");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         if (vm.count("help"))
@@ -89,19 +106,22 @@ int main(int argc, char *argv[])
     if (data_type == std::string("float"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<float>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<float>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric,
+                                              beamwidth));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("int8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<int8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<int8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric,
+                                               beamwidth));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("uint8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<uint8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<uint8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric,
+                                                beamwidth));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else
@@ -110,6 +130,9 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    for (auto &searcher : g_ssdSearch)
+        searcher->set_admission_params(admission);
+
     while (1)
     {
         try
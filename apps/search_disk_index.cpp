@@ -53,7 +53,10 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
                       const uint32_t num_threads, const uint32_t recall_at, const uint32_t beamwidth,
                       const uint32_t num_nodes_to_cache, const uint32_t search_io_limit,
                       const std::vector<uint32_t> &Lvec, const float fail_if_recall_below,
-                      const std::vector<std::string> &query_filters, const bool use_reorder_data = false)
+                      const std::vector<std::string> &query_filters, const bool use_reorder_data = false,
+                      const std::string &query_trace_file = std::string(""),
+                      const std::string &query_trace_format = std::string("json"),
+                      const float query_trace_sample_rate = 1.0f)
 {
     diskann::cout << "Search parameters: #threads: " << num_threads << ", ";
     if (beamwidth <= 0)
@@ -120,8 +123,21 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
     }
 
     std::vector<uint32_t> node_list;
-    diskann::cout << "Caching " << num_nodes_to_cache << " nodes around medoid(s)" << std::endl;
-    _pFlashIndex->cache_bfs_levels(num_nodes_to_cache, node_list);
+    if (filtered_search)
+    {
+        // Spread the cache over the entry points of the labels being queried.
+        std::vector<LabelT> cache_labels;
+        for (const auto &filter : query_filters)
+            cache_labels.push_back(_pFlashIndex->get_converted_label(filter));
+        diskann::cout << "Caching " << num_nodes_to_cache << " nodes around medoid(s) and query label entry points"
+                      << std::endl;
+        _pFlashIndex->cache_label_bfs_levels(num_nodes_to_cache, node_list, cache_labels);
+    }
+    else
+    {
+        diskann::cout << "Caching " << num_nodes_to_cache << " nodes around medoid(s)" << std::endl;
+        _pFlashIndex->cache_bfs_levels(num_nodes_to_cache, node_list);
+    }
     // if (num_nodes_to_cache > 0)
     //     _pFlashIndex->generate_cache_list_from_sample_queries(warmup_query_file, 15, 6, num_nodes_to_cache,
     //     num_threads, node_list);
@@ -197,6 +213,14 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
 
     double best_recall = 0.0;
 
+    std::shared_ptr<diskann::QueryTracer> query_tracer;
+    if (!query_trace_file.empty())
+    {
+        query_tracer = std::make_shared<diskann::QueryTracer>(std::max<size_t>(1, query_num * Lvec.size()),
+                                                              query_trace_sample_rate);
+        _pFlashIndex->set_query_tracer(query_tracer);
+    }
+
     for (uint32_t test_id = 0; test_id < Lvec.size(); test_id++)
     {
         uint32_t L = Lvec[test_id];
@@ -290,6 +314,13 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
         delete[] stats;
     }
 
+    if (query_tracer != nullptr)
+    {
+        _pFlashIndex->set_query_tracer(nullptr);
+        query_tracer->save(query_trace_file, query_trace_format);
+        diskann::cout << "Saved " << query_tracer->num_traced() << " query traces to " << query_trace_file << std::endl;
+    }
+
     diskann::cout << "Done searching. Now saving results " << std::endl;
     uint64_t test_id = 0;
     for (auto L : Lvec)
@@ -318,6 +349,8 @@ int main(int argc, char **argv)
     std::vector<uint32_t> Lvec;
     bool use_reorder_data = false;
     float fail_if_recall_below = 0.0f;
+    std::string query_trace_file, query_trace_format;
+    float query_trace_sample_rate = 1.0f;
 
     po::options_description desc{
         program_options_utils::make_program_description("search_disk_index", "Searches on-disk DiskANN indexes")};
@@ -372,6 +405,15 @@ int main(int argc, char **argv)
         optional_configs.add_options()("fail_if_recall_below",
                                        po::value<float>(&fail_if_recall_below)->default_value(0.0f),
                                        program_options_utils::FAIL_IF_RECALL_BELOW);
+        optional_configs.add_options()("query_trace_file",
+                                       po::value<std::string>(&query_trace_file)->default_value(std::string("")),
+                                       program_options_utils::QUERY_TRACE_FILE);
+        optional_configs.add_options()("query_trace_format",
+                                       po::value<std::string>(&query_trace_format)->default_value(std::string("json")),
+                                       program_options_utils::QUERY_TRACE_FORMAT);
+        optional_configs.add_options()("query_trace_sample_rate",
+                                       po::value<float>(&query_trace_sample_rate)->default_value(1.0f),
+                                       program_options_utils::QUERY_TRACE_SAMPLE_RATE);
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -451,15 +493,18 @@ int main(int argc, char **argv)
             if (data_type == std::string("float"))
                 return search_disk_index<float, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    query_trace_file, query_trace_format, query_trace_sample_rate);
             else if (data_type == std::string("int8"))
                 return search_disk_index<int8_t, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    query_trace_file, query_trace_format, query_trace_sample_rate);
             else if (data_type == std::string("uint8"))
                 return search_disk_index<uint8_t, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    query_trace_file, query_trace_format, query_trace_sample_rate);
             else
             {
                 std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
@@ -471,15 +516,18 @@ int main(int argc, char **argv)
             if (data_type == std::string("float"))
                 return search_disk_index<float>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                 num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                fail_if_recall_below, query_filters, use_reorder_data);
+                                                fail_if_recall_below, query_filters, use_reorder_data,
+                                                query_trace_file, query_trace_format, query_trace_sample_rate);
             else if (data_type == std::string("int8"))
                 return search_disk_index<int8_t>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                  num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                 fail_if_recall_below, query_filters, use_reorder_data);
+                                                 fail_if_recall_below, query_filters, use_reorder_data,
+                                                 query_trace_file, query_trace_format, query_trace_sample_rate);
             else if (data_type == std::string("uint8"))
                 return search_disk_index<uint8_t>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                   num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                  fail_if_recall_below, query_filters, use_reorder_data);
+                                                  fail_if_recall_below, query_filters, use_reorder_data,
+                                                  query_trace_file, query_trace_format, query_trace_sample_rate);
             else
             {
                 std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
@@ -30,7 +30,9 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
                         const std::string &query_file, const std::string &truthset_file, const uint32_t num_threads,
                         const uint32_t recall_at, const bool print_all_recalls, const std::vector<uint32_t> &Lvec,
                         const bool dynamic, const bool tags, const bool show_qps_per_thread,
-                        const std::vector<std::string> &query_filters, const float fail_if_recall_below)
+                        const std::vector<std::string> &query_filters, const float fail_if_recall_below,
+                        const std::string &query_trace_file, const std::string &query_trace_format,
+                        const float query_trace_sample_rate)
 {
     using TagT = uint32_t;
     // Load the query file
@@ -144,6 +146,14 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
 
     double best_recall = 0.0;
 
+    std::shared_ptr<diskann::QueryTracer> query_tracer;
+    if (!query_trace_file.empty())
+    {
+        query_tracer = std::make_shared<diskann::QueryTracer>(std::max<size_t>(1, query_num * Lvec.size()),
+                                                              query_trace_sample_rate);
+        index->set_query_tracer(query_tracer);
+    }
+
     for (uint32_t test_id = 0; test_id < Lvec.size(); test_id++)
     {
         uint32_t L = Lvec[test_id];
@@ -251,6 +261,13 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
         std::cout << std::endl;
     }
 
+    if (query_tracer != nullptr)
+    {
+        index->set_query_tracer(nullptr);
+        query_tracer->save(query_trace_file, query_trace_format);
+        std::cout << "Saved " << query_tracer->num_traced() << " query traces to " << query_trace_file << std::endl;
+    }
+
     std::cout << "Done searching. Now saving results " << std::endl;
     uint64_t test_id = 0;
     for (auto L : Lvec)
@@ -283,6 +300,8 @@ int main(int argc, char **argv)
     std::vector<uint32_t> Lvec;
     bool print_all_recalls, dynamic, tags, show_qps_per_thread;
     float fail_if_recall_below = 0.0f;
+    std::string query_trace_file, query_trace_format;
+    float query_trace_sample_rate = 1.0f;
 
     po::options_description desc{
         program_options_utils::make_program_description("search_memory_index", "Searches in-memory DiskANN indexes")};
@@ -331,6 +350,15 @@ int main(int argc, char **argv)
         optional_configs.add_options()("fail_if_recall_below",
                                        po::value<float>(&fail_if_recall_below)->default_value(0.0f),
                                        program_options_utils::FAIL_IF_RECALL_BELOW);
+        optional_configs.add_options()("query_trace_file",
+                                       po::value<std::string>(&query_trace_file)->default_value(std::string("")),
+                                       program_options_utils::QUERY_TRACE_FILE);
+        optional_configs.add_options()("query_trace_format",
+                                       po::value<std::string>(&query_trace_format)->default_value(std::string("json")),
+                                       program_options_utils::QUERY_TRACE_FORMAT);
+        optional_configs.add_options()("query_trace_sample_rate",
+                                       po::value<float>(&query_trace_sample_rate)->default_value(1.0f),
+                                       program_options_utils::QUERY_TRACE_SAMPLE_RATE);
 
         // Output controls
         po::options_description output_controls("Output controls");
@@ -421,19 +449,22 @@ int main(int argc, char **argv)
             {
                 return search_memory_index<int8_t, uint16_t>(
                     metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
-                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below);
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, query_trace_file,
+                    query_trace_format, query_trace_sample_rate);
             }
             else if (data_type == std::string("uint8"))
             {
                 return search_memory_index<uint8_t, uint16_t>(
                     metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
-                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below);
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, query_trace_file,
+                    query_trace_format, query_trace_sample_rate);
             }
             else if (data_type == std::string("float"))
             {
-                return search_memory_index<float, uint16_t>(metric, index_path_prefix, result_path, query_file, gt_file,
-                                                            num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                            show_qps_per_thread, query_filters, fail_if_recall_below);
+                return search_memory_index<float, uint16_t>(
+                    metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, query_trace_file,
+                    query_trace_format, query_trace_sample_rate);
             }
             else
             {
@@ -447,19 +478,22 @@ int main(int argc, char **argv)
             {
                 return search_memory_index<int8_t>(metric, index_path_prefix, result_path, query_file, gt_file,
                                                    num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                   show_qps_per_thread, query_filters, fail_if_recall_below);
+                                                   show_qps_per_thread, query_filters, fail_if_recall_below,
+                                                   query_trace_file, query_trace_format, query_trace_sample_rate);
             }
             else if (data_type == std::string("uint8"))
             {
                 return search_memory_index<uint8_t>(metric, index_path_prefix, result_path, query_file, gt_file,
                                                     num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                    show_qps_per_thread, query_filters, fail_if_recall_below);
+                                                    show_qps_per_thread, query_filters, fail_if_recall_below,
+                                                    query_trace_file, query_trace_format, query_trace_sample_rate);
             }
             else if (data_type == std::string("float"))
             {
                 return search_memory_index<float>(metric, index_path_prefix, result_path, query_file, gt_file,
                                                   num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                  show_qps_per_thread, query_filters, fail_if_recall_below);
+                                                  show_qps_per_thread, query_filters, fail_if_recall_below,
+                                                  query_trace_file, query_trace_format, query_trace_sample_rate);
             }
             else
             {
@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <type_traits>
+
+#include "utils.h"
+
+namespace diskann
+{
+namespace benchmarks
+{
+constexpr uint64_t BENCHMARK_SEED = 42;
+
+// Fills an aligned buffer with n vectors of the given dimension, drawn from a
+// fixed seed so that runs are comparable. The caller frees it with
+// diskann::aligned_free.
+template <typename T> T *random_aligned_vectors(const size_t n, const size_t dim, const size_t alignment = 64)
+{
+    T *data = nullptr;
+    diskann::alloc_aligned((void **)&data, ROUND_UP(n * dim * sizeof(T), alignment), alignment);
+    std::mt19937 gen(BENCHMARK_SEED);
+    if (std::is_floating_point<T>::value)
+    {
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        for (size_t i = 0; i < n * dim; i++)
+            data[i] = (T)dist(gen);
+    }
+    else
+    {
+        std::uniform_int_distribution<int32_t> dist(std::is_signed<T>::value ? -127 : 0,
+                                                    std::is_signed<T>::value ? 127 : 255);
+        for (size_t i = 0; i < n * dim; i++)
+            data[i] = (T)dist(gen);
+    }
+    return data;
+}
+
+// Swallows std::cout and std::cerr for its lifetime. Library calls made while
+// setting up a benchmark log freely, which would otherwise interleave with the
+// results.
+class QuietLog
+{
+  public:
+    QuietLog() : _saved_cout(std::cout.rdbuf(_sink.rdbuf())), _saved_cerr(std::cerr.rdbuf(_sink.rdbuf()))
+    {
+    }
+    ~QuietLog()
+    {
+        std::cout.rdbuf(_saved_cout);
+        std::cerr.rdbuf(_saved_cerr);
+    }
+
+  private:
+    std::stringstream _sink;
+    std::streambuf *_saved_cout;
+    std::streambuf *_saved_cerr;
+};
+} // namespace benchmarks
+} // namespace diskann
@@ -0,0 +1,98 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_utils.h"
+#include "distance.h"
+
+namespace
+{
+using namespace diskann::benchmarks;
+
+// Number of base vectors compared against in turn. Large enough that the
+// working set at high dimensions spills out of L1, as it does during search.
+constexpr size_t NUM_BASE_VECTORS = 4096;
+
+// Times one compare call through the Distance<T> interface, as the search
+// paths make it. range(0) is the dimension.
+template <typename T, typename DistanceT> void BM_DistanceCompare(benchmark::State &state)
+{
+    const uint32_t dim = (uint32_t)state.range(0);
+    T *query = random_aligned_vectors<T>(1, dim);
+    T *base = random_aligned_vectors<T>(NUM_BASE_VECTORS, dim);
+    std::unique_ptr<diskann::Distance<T>> dist(new DistanceT());
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dist->compare(query, base + i * dim, dim));
+        i = (i + 1) % NUM_BASE_VECTORS;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * dim * sizeof(T));
+
+    diskann::aligned_free(query);
+    diskann::aligned_free(base);
+}
+
+// The implementation get_distance_function picks on this machine.
+template <typename T, diskann::Metric metric> void BM_DistanceDispatched(benchmark::State &state)
+{
+    const uint32_t dim = (uint32_t)state.range(0);
+    T *query = random_aligned_vectors<T>(1, dim);
+    T *base = random_aligned_vectors<T>(NUM_BASE_VECTORS, dim);
+    std::unique_ptr<diskann::Distance<T>> dist;
+    {
+        QuietLog quiet;
+        dist.reset(diskann::get_distance_function<T>(metric));
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dist->compare(query, base + i * dim, dim));
+        i = (i + 1) % NUM_BASE_VECTORS;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * dim * sizeof(T));
+
+    diskann::aligned_free(query);
+    diskann::aligned_free(base);
+}
+
+// Dimensions are multiples of 32 so that every vector stays 32 byte aligned
+// for the AVX kernels.
+void Dimensions(benchmark::internal::Benchmark *b)
+{
+    for (int64_t dim : {32, 64, 96, 128, 256, 384, 768, 1024})
+        b->Arg(dim);
+}
+} // namespace
+
+// The AVX (non-AVX2) L2 kernels are only implemented in Windows builds.
+#ifdef _WINDOWS
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::AVXDistanceL2Float)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, int8_t, diskann::AVXDistanceL2Int8)->Apply(Dimensions);
+#endif
+
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::DistanceL2Float)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::SlowDistanceL2<float>)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::AVXDistanceInnerProductFloat)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::AVXNormalizedCosineDistanceFloat)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, float, diskann::DistanceCosineFloat)->Apply(Dimensions);
+
+BENCHMARK_TEMPLATE(BM_DistanceCompare, int8_t, diskann::DistanceL2Int8)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, int8_t, diskann::SlowDistanceL2<int8_t>)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, int8_t, diskann::DistanceCosineInt8)->Apply(Dimensions);
+
+BENCHMARK_TEMPLATE(BM_DistanceCompare, uint8_t, diskann::DistanceL2UInt8)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, uint8_t, diskann::SlowDistanceL2<uint8_t>)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceCompare, uint8_t, diskann::SlowDistanceCosineUInt8)->Apply(Dimensions);
+
+BENCHMARK_TEMPLATE(BM_DistanceDispatched, float, diskann::Metric::L2)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceDispatched, float, diskann::Metric::INNER_PRODUCT)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceDispatched, int8_t, diskann::Metric::L2)->Apply(Dimensions);
+BENCHMARK_TEMPLATE(BM_DistanceDispatched, uint8_t, diskann::Metric::L2)->Apply(Dimensions);
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_utils.h"
+#include "linux_aligned_file_reader.h"
+
+namespace
+{
+using namespace diskann::benchmarks;
+
+constexpr uint64_t IO_FILE_SIZE = 128ull << 20;
+
+// The reader opens files with O_DIRECT, which some file systems (tmpfs among
+// them) reject. DISKANN_BENCHMARK_DIR points the benchmark at the device whose
+// reads should be measured, normally the one holding the SSD indices.
+std::string io_benchmark_file()
+{
+    const char *dir = std::getenv("DISKANN_BENCHMARK_DIR");
+    const std::filesystem::path base = dir != nullptr ? std::filesystem::path(dir)
+                                                      : std::filesystem::temp_directory_path();
+    return (base / "diskann_io_benchmark.bin").string();
+}
+
+bool create_io_file(const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    std::vector<char> block(1 << 20);
+    std::mt19937 gen(BENCHMARK_SEED);
+    for (auto &c : block)
+        c = (char)gen();
+    for (uint64_t written = 0; out && written < IO_FILE_SIZE; written += block.size())
+        out.write(block.data(), block.size());
+    return (bool)out;
+}
+
+// One batch of range(0) random reads of range(1) bytes each, like a beam of
+// node reads in PQFlashIndex::cached_beam_search.
+void BM_LinuxAlignedFileReaderRead(benchmark::State &state)
+{
+    const size_t batch = (size_t)state.range(0);
+    const uint64_t read_size = (uint64_t)state.range(1);
+    const std::string path = io_benchmark_file();
+
+    if (!create_io_file(path))
+    {
+        state.SkipWithError(("Could not write " + path).c_str());
+        return;
+    }
+    const int probe = ::open(path.c_str(), O_DIRECT | O_RDONLY);
+    if (probe == -1)
+    {
+        std::remove(path.c_str());
+        state.SkipWithError("O_DIRECT open failed; set DISKANN_BENCHMARK_DIR to a directory on a block device");
+        return;
+    }
+    ::close(probe);
+
+    char *buf = nullptr;
+    diskann::alloc_aligned((void **)&buf, batch * read_size, 4096);
+    std::vector<uint64_t> offsets(4096 * batch);
+    std::mt19937_64 gen(BENCHMARK_SEED);
+    std::uniform_int_distribution<uint64_t> dist(0, IO_FILE_SIZE / read_size - 1);
+    for (auto &offset : offsets)
+        offset = dist(gen) * read_size;
+
+    LinuxAlignedFileReader reader;
+    QuietLog quiet;
+    reader.open(path);
+    reader.register_thread();
+    auto &ctx = reader.get_ctx();
+
+    std::vector<AlignedRead> reads(batch);
+    size_t next = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < batch; i++)
+            reads[i] = AlignedRead(offsets[next + i], read_size, buf + i * read_size);
+        reader.read(reads, ctx);
+        next = (next + batch) % offsets.size();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * read_size);
+
+    reader.deregister_thread();
+    reader.close();
+    diskann::aligned_free(buf);
+    std::remove(path.c_str());
+}
+} // namespace
+
+BENCHMARK(BM_LinuxAlignedFileReaderRead)
+    ->ArgNames({"batch", "bytes"})
+    ->ArgsProduct({{1, 4, 8, 16, 32}, {4096, 8192}})
+    ->UseRealTime();
@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "utils.h"
+
+namespace
+{
+// Tags the results with the instruction sets the kernels may use, so that
+// numbers from different machines and builds are not compared blindly.
+void add_cpu_feature_context()
+{
+#ifdef _WINDOWS
+    benchmark::AddCustomContext("cpu_avx", AvxSupportedCPU ? "yes" : "no");
+    benchmark::AddCustomContext("cpu_avx2", Avx2SupportedCPU ? "yes" : "no");
+#else
+    __builtin_cpu_init();
+    benchmark::AddCustomContext("cpu_avx", __builtin_cpu_supports("avx") ? "yes" : "no");
+    benchmark::AddCustomContext("cpu_avx2", __builtin_cpu_supports("avx2") ? "yes" : "no");
+    benchmark::AddCustomContext("cpu_fma", __builtin_cpu_supports("fma") ? "yes" : "no");
+    benchmark::AddCustomContext("cpu_avx512f", __builtin_cpu_supports("avx512f") ? "yes" : "no");
+    benchmark::AddCustomContext("cpu_avx512bw", __builtin_cpu_supports("avx512bw") ? "yes" : "no");
+#endif
+
+    std::string build_flags;
+#ifdef USE_AVX2
+    build_flags += "USE_AVX2 ";
+#endif
+#ifdef USE_ACCELERATED_PQ
+    build_flags += "USE_ACCELERATED_PQ ";
+#endif
+#ifdef __AVX512F__
+    build_flags += "__AVX512F__ ";
+#endif
+#ifdef NDEBUG
+    build_flags += "NDEBUG ";
+#endif
+    benchmark::AddCustomContext("diskann_build_flags", build_flags.empty() ? "none" : build_flags);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    add_cpu_feature_context();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
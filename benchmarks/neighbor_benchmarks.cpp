@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/dynamic_bitset.hpp>
+
+#include "benchmark_utils.h"
+#include "neighbor.h"
+#include "tsl/robin_set.h"
+
+namespace
+{
+using namespace diskann::benchmarks;
+
+std::vector<uint32_t> random_ids(const size_t n, const uint32_t universe)
+{
+    std::vector<uint32_t> ids(n);
+    std::mt19937 gen(BENCHMARK_SEED);
+    std::uniform_int_distribution<uint32_t> dist(0, universe - 1);
+    for (auto &id : ids)
+        id = dist(gen);
+    return ids;
+}
+
+// One query's worth of candidate insertions into a search list of capacity L:
+// 8L candidates with random distances, most of which are rejected once the
+// list fills up, as in the later hops of a search. range(0) is L.
+void BM_NeighborPriorityQueueInsert(benchmark::State &state)
+{
+    const size_t L = (size_t)state.range(0);
+    const size_t num_candidates = 8 * L;
+    const auto ids = random_ids(num_candidates, 1 << 20);
+    std::vector<diskann::Neighbor> candidates;
+    std::mt19937 gen(BENCHMARK_SEED);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (size_t i = 0; i < num_candidates; i++)
+        candidates.emplace_back(ids[i], dist(gen));
+
+    diskann::NeighborPriorityQueue queue(L);
+    for (auto _ : state)
+    {
+        queue.clear();
+        for (const auto &nbr : candidates)
+            queue.insert(nbr);
+        benchmark::DoNotOptimize(queue.size());
+    }
+    state.SetItemsProcessed(state.iterations() * num_candidates);
+}
+
+// Visited set operations of one search: the set is cleared, then each of
+// range(1) ids from an index of range(0) points is checked and inserted.
+// Index::iterate_to_fixed_point uses a bitset up to 10M points and a
+// robin_set beyond; the bitset pays for clearing all of its words per query.
+void BM_VisitedRobinSet(benchmark::State &state)
+{
+    const uint32_t num_points = (uint32_t)state.range(0);
+    const size_t num_visits = (size_t)state.range(1);
+    const auto ids = random_ids(num_visits, num_points);
+
+    tsl::robin_set<uint32_t> visited;
+    visited.reserve(num_visits);
+    for (auto _ : state)
+    {
+        visited.clear();
+        size_t inserted = 0;
+        for (const auto id : ids)
+        {
+            if (visited.find(id) == visited.end())
+            {
+                visited.insert(id);
+                inserted++;
+            }
+        }
+        benchmark::DoNotOptimize(inserted);
+    }
+    state.SetItemsProcessed(state.iterations() * num_visits);
+}
+
+void BM_VisitedDynamicBitset(benchmark::State &state)
+{
+    const uint32_t num_points = (uint32_t)state.range(0);
+    const size_t num_visits = (size_t)state.range(1);
+    const auto ids = random_ids(num_visits, num_points);
+
+    boost::dynamic_bitset<> visited(num_points);
+    for (auto _ : state)
+    {
+        visited.reset();
+        size_t inserted = 0;
+        for (const auto id : ids)
+        {
+            if (visited[id] == 0)
+            {
+                visited[id] = 1;
+                inserted++;
+            }
+        }
+        benchmark::DoNotOptimize(inserted);
+    }
+    state.SetItemsProcessed(state.iterations() * num_visits);
+}
+
+void PointsAndVisits(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"points", "visits"});
+    for (int64_t num_points : {100000, 1000000, 10000000})
+        for (int64_t num_visits : {1000, 5000, 20000})
+            b->Args({num_points, num_visits});
+}
+} // namespace
+
+BENCHMARK(BM_NeighborPriorityQueueInsert)->Arg(16)->Arg(64)->Arg(128)->Arg(256)->Arg(512);
+BENCHMARK(BM_VisitedRobinSet)->Apply(PointsAndVisits);
+BENCHMARK(BM_VisitedDynamicBitset)->Apply(PointsAndVisits);
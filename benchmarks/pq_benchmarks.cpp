@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_utils.h"
+#include "pq.h"
+
+namespace
+{
+using namespace diskann::benchmarks;
+
+constexpr uint32_t NUM_CENTERS = 256;
+
+// Compressed vectors gathered from; at 128 chunks this is 32MB, more than a
+// typical last level cache, so gathers miss as they do on a real index.
+constexpr size_t NUM_PQ_POINTS = 1 << 18;
+
+// Distances from a batch of compressed neighbours to the query, looked up in a
+// per-query table. range(0) is the batch size, range(1) the number of chunks.
+void BM_PQDistLookup(benchmark::State &state)
+{
+    const size_t batch = (size_t)state.range(0);
+    const size_t n_chunks = (size_t)state.range(1);
+    uint8_t *pq_ids = random_aligned_vectors<uint8_t>(batch, n_chunks);
+    float *pq_dists = random_aligned_vectors<float>(n_chunks, NUM_CENTERS);
+    float *dists_out = nullptr;
+    diskann::alloc_aligned((void **)&dists_out, ROUND_UP(batch * sizeof(float), 64), 64);
+
+    for (auto _ : state)
+    {
+        diskann::pq_dist_lookup(pq_ids, batch, n_chunks, pq_dists, dists_out);
+        benchmark::DoNotOptimize(dists_out);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+
+    diskann::aligned_free(pq_ids);
+    diskann::aligned_free(pq_dists);
+    diskann::aligned_free(dists_out);
+}
+
+// Gathers the compressed vectors of a batch of random ids into a contiguous
+// buffer, as done for each expanded node's neighbours.
+void BM_AggregateCoords(benchmark::State &state)
+{
+    const size_t batch = (size_t)state.range(0);
+    const size_t n_chunks = (size_t)state.range(1);
+    uint8_t *all_coords = random_aligned_vectors<uint8_t>(NUM_PQ_POINTS, n_chunks);
+    uint8_t *out = nullptr;
+    diskann::alloc_aligned((void **)&out, ROUND_UP(batch * n_chunks, 64), 64);
+
+    // Cycle through many id batches so the gathered rows are not cache resident.
+    constexpr size_t NUM_ID_BATCHES = 1024;
+    std::vector<uint32_t> ids(NUM_ID_BATCHES * batch);
+    std::mt19937 gen(BENCHMARK_SEED);
+    std::uniform_int_distribution<uint32_t> dist(0, (uint32_t)NUM_PQ_POINTS - 1);
+    for (auto &id : ids)
+        id = dist(gen);
+
+    size_t b = 0;
+    for (auto _ : state)
+    {
+        diskann::aggregate_coords(ids.data() + b * batch, batch, all_coords, n_chunks, out);
+        benchmark::DoNotOptimize(out);
+        benchmark::ClobberMemory();
+        b = (b + 1) % NUM_ID_BATCHES;
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * n_chunks);
+
+    diskann::aligned_free(all_coords);
+    diskann::aligned_free(out);
+}
+
+void BatchesAndChunks(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"batch", "chunks"});
+    for (int64_t batch : {8, 32, 64, 128, 256})
+        for (int64_t n_chunks : {16, 32, 64, 128})
+            b->Args({batch, n_chunks});
+}
+} // namespace
+
+BENCHMARK(BM_PQDistLookup)->Apply(BatchesAndChunks);
+BENCHMARK(BM_AggregateCoords)->Apply(BatchesAndChunks);
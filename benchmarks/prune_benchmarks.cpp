@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <omp.h>
+
+#include "benchmark_utils.h"
+#include "index.h"
+
+namespace
+{
+using namespace diskann::benchmarks;
+
+constexpr size_t NUM_PRUNE_POINTS = 5000;
+constexpr uint32_t BUILD_DEGREE = 64;
+constexpr uint32_t BUILD_L = 100;
+constexpr uint32_t MAX_OCCLUSION = 750;
+constexpr float ALPHA = 1.2f;
+
+std::unique_ptr<diskann::Index<float>> new_index(const size_t dim)
+{
+    auto params = std::make_shared<diskann::IndexWriteParameters>(
+        diskann::IndexWriteParametersBuilder(BUILD_L, BUILD_DEGREE)
+            .with_max_occlusion_size(MAX_OCCLUSION)
+            .with_alpha(ALPHA)
+            .with_num_threads(1)
+            .build());
+    return std::unique_ptr<diskann::Index<float>>(
+        new diskann::Index<float>(diskann::Metric::L2, dim, NUM_PRUNE_POINTS, params, nullptr));
+}
+
+// Number of nodes of the saved graph at index_path with more than
+// max_degree neighbours, which are the ones prune_all_neighbors prunes.
+size_t count_nodes_above(const std::string &index_path, const uint32_t max_degree)
+{
+    std::ifstream in(index_path, std::ios::binary);
+    uint64_t file_size, num_frozen;
+    uint32_t graph_degree, start;
+    in.read((char *)&file_size, sizeof(file_size));
+    in.read((char *)&graph_degree, sizeof(graph_degree));
+    in.read((char *)&start, sizeof(start));
+    in.read((char *)&num_frozen, sizeof(num_frozen));
+    size_t count = 0;
+    uint32_t degree;
+    while (in.read((char *)&degree, sizeof(degree)))
+    {
+        count += degree > max_degree;
+        in.seekg(degree * sizeof(uint32_t), std::ios::cur);
+    }
+    return count;
+}
+
+// occlude_list is private to Index; prune_all_neighbors is its public entry
+// point. Each iteration loads a graph built with degree 64 and prunes every
+// node above range(1) down to it, which is one occlude_list call per such node
+// over a sorted candidate pool of its current neighbours, on all threads.
+// range(0) is the dimension.
+void BM_OccludeList(benchmark::State &state)
+{
+    const size_t dim = (size_t)state.range(0);
+    const uint32_t target_degree = (uint32_t)state.range(1);
+    const std::string index_path =
+        (std::filesystem::temp_directory_path() / ("diskann_prune_benchmark_" + std::to_string(dim))).string();
+
+    QuietLog quiet;
+    {
+        float *data = random_aligned_vectors<float>(NUM_PRUNE_POINTS, dim);
+        auto index = new_index(dim);
+        index->build(data, NUM_PRUNE_POINTS, std::vector<uint32_t>());
+        index->save(index_path.c_str());
+        diskann::aligned_free(data);
+    }
+    const size_t num_pruned = count_nodes_above(index_path, target_degree);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto index = new_index(dim);
+        index->load(index_path.c_str(), omp_get_max_threads(), BUILD_L);
+        state.ResumeTiming();
+
+        index->prune_all_neighbors(target_degree, MAX_OCCLUSION, ALPHA);
+
+        state.PauseTiming();
+        index.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * num_pruned);
+
+    for (const char *suffix : {"", ".data", ".tags"})
+        std::remove((index_path + suffix).c_str());
+}
+} // namespace
+
+BENCHMARK(BM_OccludeList)
+    ->ArgNames({"dim", "degree"})
+    ->Args({32, 32})
+    ->Args({128, 32})
+    ->Args({128, 48})
+    ->Unit(benchmark::kMillisecond);
@@ -5,6 +5,7 @@
 #include "types.h"
 #include "index_config.h"
 #include "index_build_params.h"
+#include "query_trace.h"
 #include <any>
 
 namespace diskann
@@ -101,6 +102,8 @@ class AbstractIndex
 
     virtual void optimize_index_layout() = 0;
 
+    virtual void set_query_tracer(std::shared_ptr<QueryTracer> tracer) = 0;
+
     // memory should be allocated for vec before calling this function
     template <typename tag_type, typename data_type> int get_vector_by_tag(tag_type &tag, data_type *vec);
 
@@ -0,0 +1,93 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Records the stages of a multi-stage index build that have completed, with
+// the parameters they were run with and the size and modification time of
+// every artifact they produced. A restarted build consults the manifest and
+// skips a stage when it was completed with identical parameters and its
+// artifacts are still present and unmodified.
+//
+// With verify set, artifacts are also checksummed when a stage completes and
+// re-checksummed on a rerun. That reads every artifact in full, which at
+// scale can cost more than the stages it skips, so it is off by default.
+// Artifacts recorded without verify are only checked by size and time.
+//
+// Stages are assumed to run in a fixed order, each possibly depending on any
+// earlier one. Marking a stage complete therefore drops the records of every
+// stage that had completed after its previous record, since their inputs may
+// have changed.
+//
+// A manifest constructed with an empty path is disabled: no stage is ever
+// considered complete and nothing is written.
+//
+// Thread-safety: this class is not thread-safe.
+class BuildManifest
+{
+  public:
+    DISKANN_DLLEXPORT BuildManifest(const std::string &manifest_path = std::string(""), const bool verify = false);
+
+    DISKANN_DLLEXPORT bool enabled() const;
+
+    // True if stage was completed with the same params and all of its
+    // artifacts still match the recorded size and modification time, and
+    // with verify, the recorded checksum.
+    DISKANN_DLLEXPORT bool is_complete(const std::string &stage, const std::string &params) const;
+
+    // Records stage as completed with those of the given artifacts that
+    // exist, and persists the manifest. result is stored with the stage
+    // for stages whose outcome a rerun needs, such as a count of outputs.
+    DISKANN_DLLEXPORT void mark_complete(const std::string &stage, const std::string &params,
+                                         const std::vector<std::string> &artifacts,
+                                         const std::string &result = std::string(""));
+
+    // The result recorded with stage, or an empty string.
+    DISKANN_DLLEXPORT std::string result(const std::string &stage) const;
+
+    // Runs build unless the stage is complete, then marks it complete.
+    // Returns true if build was run.
+    DISKANN_DLLEXPORT bool run_stage(const std::string &stage, const std::string &params,
+                                     const std::vector<std::string> &artifacts, const std::function<void()> &build);
+
+    // 64-bit checksum of the contents of a file.
+    DISKANN_DLLEXPORT static uint64_t file_checksum(const std::string &filename);
+
+    // Path, size and modification time of a file, for the params of a stage
+    // that reads an input the manifest does not track.
+    DISKANN_DLLEXPORT static std::string file_identity(const std::string &filename);
+
+  private:
+    struct Artifact
+    {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+        uint64_t checksum; // 0 if not verified
+    };
+
+    struct Stage
+    {
+        std::string name;
+        std::string params;
+        std::vector<Artifact> artifacts;
+        std::string result;
+    };
+
+    void load();
+    void save() const;
+
+    std::string _manifest_path;
+    bool _verify;
+    std::vector<Stage> _stages;
+};
+} // namespace diskann
@@ -16,6 +16,28 @@ const uint32_t FILTER_LIST_SIZE = 0;
 const uint32_t NUM_FROZEN_POINTS_STATIC = 0;
 const uint32_t NUM_FROZEN_POINTS_DYNAMIC = 1;
 
+// Optional coarse first pass of the Vamana build; a list size of 0 disables it
+const uint32_t FIRST_PASS_LIST_SIZE = 0;
+const float FIRST_PASS_ALPHA = 1.0f;
+const float FIRST_PASS_SAMPLE_RATE = 1.0f;
+
+// Optional kNN seeding of the Vamana build; a degree of 0 disables it
+const uint32_t KNN_SEED_DEGREE = 0;
+const uint32_t KNN_SEED_CLUSTER_SIZE = 2048;
+const uint32_t KNN_SEED_MAX_CLUSTER_SIZE = 8192;
+const uint32_t KNN_SEED_NUM_PROBES = 2;
+
+// Filtered search planning: a filter matching at least this fraction of the
+// points is answered by an unrestricted walk, whose list grows by at most
+// this factor
+const float FILTER_POST_FILTER_MIN_SELECTIVITY = 0.5f;
+const uint32_t FILTER_POST_FILTER_MAX_EXPANSION = 8;
+// Points of a label without a medoid tried as its start point
+const uint32_t FILTER_START_CANDIDATES = 32;
+// Dynamic filtered indices move a label's start to its point nearest the mean
+// when the label reaches this many points, and again at every doubling
+const uint32_t LABEL_START_FIRST_REFRESH = 16;
+
 // In-mem index related limits
 const float GRAPH_SLACK_FACTOR = 1.3f;
 
@@ -42,6 +42,7 @@ const uint32_t WARMUP_L = 20;
 const uint32_t NUM_KMEANS_REPS = 12;
 
 template <typename T, typename LabelT> class PQFlashIndex;
+class BuildManifest;
 
 DISKANN_DLLEXPORT double get_memory_budget(const std::string &mem_budget_str);
 DISKANN_DLLEXPORT double get_memory_budget(double search_ram_budget_in_gb);
@@ -82,7 +83,8 @@ DISKANN_DLLEXPORT int build_merged_vamana_index(std::string base_file, diskann::
                                                 uint32_t num_threads, bool use_filters = false,
                                                 const std::string &label_file = std::string(""),
                                                 const std::string &labels_to_medoids_file = std::string(""),
-                                                const std::string &universal_label = "", const uint32_t Lf = 0);
+                                                const std::string &universal_label = "", const uint32_t Lf = 0,
+                                                BuildManifest *manifest = nullptr);
 
 template <typename T, typename LabelT>
 DISKANN_DLLEXPORT uint32_t optimize_beamwidth(std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> &_pFlashIndex,
@@ -98,7 +100,11 @@ DISKANN_DLLEXPORT int build_disk_index(
     bool use_filters = false,
     const std::string &label_file = std::string(""), // default is empty string for no label_file
     const std::string &universal_label = "", const uint32_t filter_threshold = 0,
-    const uint32_t Lf = 0); // default is empty string for no universal label
+    const uint32_t Lf = 0, // default is empty string for no universal label
+    const bool checkpoint = false, // record completed stages in <indexFilePath>_build_manifest.txt and
+                                   // skip them when the build is rerun; intermediate files are kept
+    const bool verify_checkpoint = false); // also checksum the kept files instead of only checking their
+                                           // size and modification time
 
 template <typename T>
 DISKANN_DLLEXPORT void create_disk_layout(const std::string base_file, const std::string mem_index_file,
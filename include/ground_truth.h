@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "distance.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Exact ground truth by brute force. The base file is streamed in blocks: the
+// next block is read and converted to float while the current one goes through
+// a GEMM against a tile of queries, and each query keeps a bounded top-K heap
+// across blocks, so memory is independent of the number of base points.
+//
+// Peak memory is about 2 * block_size * dim floats for the double-buffered
+// base blocks plus block_size * query_tile floats for the distance matrix.
+struct GroundTruthParameters
+{
+    Metric metric = Metric::L2;
+    // Nearest neighbours kept per query. Queries with fewer candidates get
+    // trailing entries of id UINT32_MAX and distance FLT_MAX.
+    uint32_t K = 100;
+    // Also collect every point within range of each query. The radius bounds
+    // the distances reported: squared L2 for L2 and cosine, and the smallest
+    // inner product kept for mips, as in the range searches of both indices.
+    bool compute_range = false;
+    float range = 0;
+    // Keep the unfiltered top K. Callers that only need the filtered or range
+    // results clear it to skip that work; ids and distances are then empty.
+    bool compute_unfiltered = true;
+    size_t block_size = (size_t)1 << 18;
+    size_t query_tile = 512;
+    // 0 uses the OpenMP default.
+    uint32_t num_threads = 0;
+};
+
+// Labels for filtered ground truth, computed in the same pass as the
+// unfiltered one. Query q matches a point carrying query_labels[q] or, when
+// use_universal_label is set, the universal label.
+struct GroundTruthLabels
+{
+    std::vector<std::vector<uint32_t>> point_labels;
+    std::vector<uint32_t> query_labels;
+    bool use_universal_label = false;
+    uint32_t universal_label = 0;
+};
+
+// ids and distances are num_queries x K, row major, nearest first. Distances
+// are squared L2 for L2 and cosine, and inner products for mips, as
+// compute_groundtruth has always written them.
+struct GroundTruthResult
+{
+    size_t num_queries = 0;
+    uint32_t K = 0;
+    std::vector<uint32_t> ids;
+    std::vector<float> distances;
+    // Filled when labels are given.
+    std::vector<uint32_t> filtered_ids;
+    std::vector<float> filtered_distances;
+    // Filled when compute_range is set; nearest first.
+    std::vector<std::vector<uint32_t>> range_ids;
+};
+
+// queries holds num_queries x dim floats. With location_to_tag, results are
+// reported as tags and points tagged 0 are skipped.
+template <typename T>
+DISKANN_DLLEXPORT void compute_ground_truth(const std::string &base_file, const float *queries,
+                                            const size_t num_queries, const size_t dim,
+                                            const GroundTruthParameters &params, GroundTruthResult &result,
+                                            const GroundTruthLabels *labels = nullptr,
+                                            const std::vector<uint32_t> *location_to_tag = nullptr);
+
+// Writes npts, K, the id matrix and the distance matrix, the layout
+// load_truthset reads.
+DISKANN_DLLEXPORT void save_ground_truth(const std::string &gt_file, const size_t num_queries, const uint32_t K,
+                                         const std::vector<uint32_t> &ids, const std::vector<float> &distances);
+
+// Writes npts, the total number of ids, the per-query counts and then the ids,
+// the layout load_range_truthset reads.
+DISKANN_DLLEXPORT void save_range_ground_truth(const std::string &gt_file,
+                                               const std::vector<std::vector<uint32_t>> &ids);
+} // namespace diskann
@@ -21,6 +21,9 @@
 #include "in_mem_data_store.h"
 #include "in_mem_graph_store.h"
 #include "abstract_index.h"
+#include "query_trace.h"
+#include "label_filter.h"
+#include "percentile_stats.h"
 
 #include "quantized_distance.h"
 #include "pq_data_store.h"
@@ -122,6 +125,10 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // to have higher consistency between index builds.
     DISKANN_DLLEXPORT void set_start_points_at_random(T radius, uint32_t random_seed = 0);
 
+    // Record per-query traces for a sample of searches. Pass nullptr to stop
+    // tracing. Must not be called concurrently with searches.
+    DISKANN_DLLEXPORT void set_query_tracer(std::shared_ptr<QueryTracer> tracer);
+
     // For FastL2 search on a static index, we interleave the data with graph
     DISKANN_DLLEXPORT void optimize_index_layout();
 
@@ -145,6 +152,43 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
                                                                         const size_t K, const uint32_t L,
                                                                         IndexType *indices, float *distances);
 
+    // Search restricted to points matching a boolean label predicate, see
+    // LabelFilter. As with a single label, fewer than K entries are written if
+    // fewer matching points are found. On a static index the search is planned
+    // from label cardinalities, see plan_filtered_search; stats, if given,
+    // receives the plan, hops and distance computations.
+    template <typename IndexType>
+    DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> search_with_filters(const T *query,
+                                                                        const LabelFilter<LabelT> &filter,
+                                                                        const size_t K, const uint32_t L,
+                                                                        IndexType *indices, float *distances,
+                                                                        QueryStats *stats = nullptr);
+
+    // Returns every point within radius of the query, nearest first, as
+    // locations in indices with their distances in distances. radius bounds
+    // the distances search reports: for inner product it is the smallest
+    // inner product returned, as in PQFlashIndex::range_search and the range
+    // ground truth. The list starts at min_l_search and doubles while at least
+    // a quarter of it is in range and new points in range keep turning up, up
+    // to max_l_search. Both vectors are cleared and refilled, so reusing them
+    // across queries avoids allocations. Returns the number of points found.
+    DISKANN_DLLEXPORT size_t range_search(const T *query, const float radius, const uint32_t min_l_search,
+                                          const uint32_t max_l_search, std::vector<uint32_t> &indices,
+                                          std::vector<float> &distances, QueryStats *stats = nullptr);
+
+    // Range search restricted to points matching filter, planned as in
+    // search_with_filters for a list of max_l_search. A scan of the matching
+    // points keeps the nearest max_l_search of them.
+    DISKANN_DLLEXPORT size_t range_search(const T *query, const float radius, const LabelFilter<LabelT> &filter,
+                                          const uint32_t min_l_search, const uint32_t max_l_search,
+                                          std::vector<uint32_t> &indices, std::vector<float> &distances,
+                                          QueryStats *stats = nullptr);
+
+    // As range_search, reporting tags; lazily deleted points are left out.
+    DISKANN_DLLEXPORT size_t range_search_with_tags(const T *query, const float radius, const uint32_t min_l_search,
+                                                    const uint32_t max_l_search, std::vector<TagT> &tags,
+                                                    std::vector<float> &distances, QueryStats *stats = nullptr);
+
     // Will fail if tag already in the index or if tag=0.
     DISKANN_DLLEXPORT int insert_point(const T *point, const TagT tag);
 
@@ -249,16 +293,62 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
 
     void parse_label_file(const std::string &label_file, size_t &num_pts_labels);
 
+    // The filter labels reduced once per search (or per point during build),
+    // so that detect_common_filters does no work per neighbour beyond the match.
+    struct FilterMatch
+    {
+        // The universal label is among the filter labels of a point being
+        // inserted, so every node matches.
+        bool match_all = false;
+        // All labels to test are below LABEL_BITMAP_BITS; match on bitmaps.
+        bool use_bits = false;
+        uint64_t bits = 0;
+    };
+    FilterMatch prepare_filter_match(const std::vector<LabelT> &incoming_labels, bool search_invocation) const;
+    bool detect_common_filters(uint32_t point_id, const std::vector<LabelT> &incoming_labels,
+                               const FilterMatch &match) const;
+    bool matches_label_filter(uint32_t location, const LabelFilter<LabelT> &filter) const;
+    size_t estimate_filter_matches(const LabelFilter<LabelT> &filter) const;
+    // Exact search over the points the filter may match, leaving the best L in
+    // scratch->best_l_nodes(). Returns the number of distances computed.
+    uint32_t scan_filtered_points(const LabelFilter<LabelT> &filter, const uint32_t L,
+                                  InMemQueryScratch<T> *scratch) const;
+
     std::unordered_map<std::string, LabelT> load_label_map(const std::string &map_file);
 
     // Returns the locations of start point and frozen points suitable for use
     // with iterate_to_fixed_point.
     std::vector<uint32_t> get_init_ids();
 
-    // The query to use is placed in scratch->aligned_query
+    // The query to use is placed in scratch->aligned_query. When scored is
+    // given, every point whose distance is computed is appended to it, and
+    // every expanded point once more with expanded set; the search can then
+    // be continued with a longer list by calling again without init_ids.
     std::pair<uint32_t, uint32_t> iterate_to_fixed_point(InMemQueryScratch<T> *scratch, const uint32_t Lindex,
                                                          const std::vector<uint32_t> &init_ids, bool use_filter,
-                                                         const std::vector<LabelT> &filters, bool search_invocation);
+                                                         const std::vector<LabelT> &filters, bool search_invocation,
+                                                         QueryTrace *trace = nullptr,
+                                                         std::vector<Neighbor> *scored = nullptr);
+
+    // Runs iterate_to_fixed_point with list size L and continues it with a
+    // doubled list while at least a quarter of the list is within range and
+    // the last round found new points within range, up to max_L. Appends to
+    // results every point scored within radius, as range_search takes it,
+    // that matches check_filter, if given.
+    std::pair<uint32_t, uint32_t> range_iterate(InMemQueryScratch<T> *scratch, const float radius, const uint32_t L,
+                                                const uint32_t max_L, const std::vector<uint32_t> &init_ids,
+                                                bool use_filter, const std::vector<LabelT> &filter_labels,
+                                                const LabelFilter<LabelT> *check_filter,
+                                                std::vector<Neighbor> &results);
+    // Range search, restricted to filter if given, leaving the points found
+    // in scratch->pool(), nearest first. Callers hold _update_lock.
+    std::pair<uint32_t, uint32_t> range_search_points(InMemQueryScratch<T> *scratch, const T *query,
+                                                      const float radius, const LabelFilter<LabelT> *filter,
+                                                      const uint32_t min_l_search, const uint32_t max_l_search,
+                                                      QueryStats *stats);
+    size_t range_search_locations(const T *query, const float radius, const LabelFilter<LabelT> *filter,
+                                  const uint32_t min_l_search, const uint32_t max_l_search,
+                                  std::vector<uint32_t> &indices, std::vector<float> &distances, QueryStats *stats);
 
     void search_for_point_and_prune(int location, uint32_t Lindex, std::vector<uint32_t> &pruned_list,
                                     InMemQueryScratch<T> *scratch, bool use_filter = false,
@@ -286,6 +376,17 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Acquire exclusive _update_lock before calling
     void link();
 
+    // One insertion pass of link() over visit_order with the given build list
+    // sizes; prunes with the current _indexingAlpha.
+    void link_pass(const std::vector<uint32_t> &visit_order, const uint32_t Lindex, const uint32_t filteredLindex);
+
+    // Seed the graph over points with the pruned k nearest neighbours of each
+    // point, found by blocked GEMM within its nearest k-means clusters, which
+    // are split when they exceed KNN_SEED_MAX_CLUSTER_SIZE points. The
+    // distances are L2 and labels are ignored; link() only seeds unfiltered
+    // L2 builds.
+    void knn_seed_graph(const std::vector<uint32_t> &points, const uint32_t k);
+
     // Acquire exclusive _tag_lock and _delete_lock before calling
     int reserve_location();
 
@@ -293,6 +394,43 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     size_t release_location(int location);
     size_t release_locations(const tsl::robin_set<uint32_t> &locations);
 
+    // Label start points of a dynamic filtered index. A new label starts from a
+    // frozen point, claimed from the ones freed at consolidation or from the
+    // unused ones past _frozen_pts_used, and moves to a data point near the
+    // mean of its points as it grows. Acquire exclusive _tag_lock before
+    // calling available_frozen_pts, claim_frozen_point and the functions
+    // changing label starts.
+    size_t available_frozen_pts() const;
+    uint32_t claim_frozen_point();
+    // Adds frozen points at the end of the index. Each new one is a copy of
+    // _start linked to it, so that searches seeded with it reach the graph.
+    // Acquire exclusive _update_lock, _tag_lock and _delete_lock before calling.
+    void grow_frozen_points(size_t num_new_pts);
+    // Grows the frozen points until needed() of them can be claimed. Called
+    // holding shared_ul alone, which is released while growing.
+    void reserve_frozen_points(const std::function<size_t()> &needed,
+                               std::shared_lock<std::shared_timed_mutex> &shared_ul);
+    // Number of distinct labels in labels without a start point.
+    size_t count_new_labels(const std::vector<LabelT> &labels) const;
+    void add_label_start(const LabelT label, const T *point);
+    // Adds (sign 1) or removes (sign -1) the vector at location to the running
+    // means of its labels; point, if given, is used in place of the stored
+    // vector. Returns the labels due for a start refresh.
+    std::vector<LabelT> update_label_means(const uint32_t location, const float sign, const T *point = nullptr);
+    void label_mean_point(const LabelT label, T *point) const;
+    // Moves the start of label to its point nearest to the mean. Takes
+    // _tag_lock itself.
+    void refresh_label_start(const LabelT label, InMemQueryScratch<T> *scratch);
+    // Frozen points no longer used as starts stay linked until the next
+    // consolidation, which unlinks them and frees them for reuse.
+    void retire_label_start(const uint32_t location);
+    void release_frozen_point(const uint32_t location);
+    // Removes labels left without points and moves start points off deleted
+    // locations. Called by consolidate_deletes before releasing deleted.
+    void consolidate_label_starts(const tsl::robin_set<uint32_t> &deleted);
+    // Recomputes the label means and frozen point bookkeeping after loading.
+    void rebuild_label_starts();
+
     // Resize the index when no slots are left for insertion.
     // Acquire exclusive _update_lock and _tag_lock before calling.
     void resize(size_t new_max_points);
@@ -379,11 +517,33 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Location to label is only updated during insert_point(), all other reads are protected by
     // default as a location can only be released at end of consolidate deletes
     std::vector<std::vector<LabelT>> _location_to_labels;
+    // Labels below LABEL_BITMAP_BITS mirrored as one bitmap per location, so
+    // that matching in a small label space is a single AND. Kept in step with
+    // _location_to_labels.
+    std::vector<uint64_t> _location_to_label_bits;
+    // Locations carrying each label, for planning filtered searches. Only
+    // built for static indices, whose labels do not change after loading.
+    std::unordered_map<LabelT, std::vector<uint32_t>> _label_to_locations;
     tsl::robin_set<LabelT> _labels;
     std::string _labels_file;
     std::unordered_map<LabelT, uint32_t> _label_to_start_id;
     std::unordered_map<uint32_t, uint32_t> _medoid_counts;
 
+    // Dynamic filtered indices: the running sum of the vectors of each label,
+    // which its start point follows, guarded by _tag_lock like
+    // _label_to_start_id.
+    struct LabelMean
+    {
+        int64_t num_points = 0;
+        int64_t next_refresh = defaults::LABEL_START_FIRST_REFRESH;
+        std::vector<float> sum;
+    };
+    std::unordered_map<LabelT, LabelMean> _label_means;
+    // Frozen points, as offsets from _max_points, that can be claimed again,
+    // and ones replaced as label starts that are unlinked at consolidation.
+    std::vector<uint32_t> _free_frozen_pts;
+    std::vector<uint32_t> _retired_frozen_pts;
+
     bool _use_universal_label = false;
     LabelT _universal_label = 0;
     uint32_t _filterIndexingQueueSize;
@@ -396,9 +556,18 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     float _indexingAlpha;
     uint32_t _indexingThreads;
 
+    // Optional coarse first build pass, disabled when _firstPassQueueSize is 0
+    uint32_t _firstPassQueueSize = defaults::FIRST_PASS_LIST_SIZE;
+    float _firstPassAlpha = defaults::FIRST_PASS_ALPHA;
+    float _firstPassSampleRate = defaults::FIRST_PASS_SAMPLE_RATE;
+    uint32_t _knnSeedDegree = defaults::KNN_SEED_DEGREE;
+
     // Query scratch data structures
     ConcurrentQueue<InMemQueryScratch<T> *> _query_scratch;
 
+    // Samples search latency breakdowns when set
+    std::shared_ptr<QueryTracer> _query_tracer;
+
     // Flags for PQ based distance calculation
     bool _pq_dist = false;
     bool _use_opq = false;
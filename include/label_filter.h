@@ -0,0 +1,232 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ann_exception.h"
+#include "defaults.h"
+
+namespace diskann
+{
+// Labels below this value are mirrored into a per-point bitmap, so that filter
+// matching in a small label space is a single AND. Label ids come from
+// convert_labels_string_to_int, which numbers labels densely from 1.
+constexpr uint64_t LABEL_BITMAP_BITS = 64;
+
+template <typename LabelT> uint64_t label_bitmap(const LabelT *labels, const size_t num_labels)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < num_labels; i++)
+        if ((uint64_t)labels[i] < LABEL_BITMAP_BITS)
+            bits |= (uint64_t)1 << labels[i];
+    return bits;
+}
+
+template <typename LabelT> uint64_t label_bitmap(const std::vector<LabelT> &labels)
+{
+    return label_bitmap(labels.data(), labels.size());
+}
+
+// A boolean predicate over the labels of a point, in disjunctive normal form:
+// a point matches if it satisfies any clause, and satisfies a clause if it has
+// every label of all_of and none of none_of. The universal label is handled by
+// the index, which lets a point carrying it match any filter.
+//
+// Search walks the filtered graph over one anchor label per clause, the first
+// of its all_of, since the graph is only navigable per label, and keeps the
+// results that satisfy the whole predicate. Listing the most selective label
+// first in each clause keeps the walk short.
+template <typename LabelT> class LabelFilter
+{
+  public:
+    struct Clause
+    {
+        std::vector<LabelT> all_of;
+        std::vector<LabelT> none_of;
+        uint64_t all_of_bits = 0;
+        uint64_t none_of_bits = 0;
+    };
+
+    LabelFilter() = default;
+
+    explicit LabelFilter(const LabelT label)
+    {
+        add_clause({label});
+    }
+
+    LabelFilter &add_clause(std::vector<LabelT> all_of, std::vector<LabelT> none_of = std::vector<LabelT>())
+    {
+        if (all_of.empty() && none_of.empty())
+            throw ANNException("A label filter clause needs at least one label", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+        Clause clause;
+        clause.all_of_bits = label_bitmap(all_of);
+        clause.none_of_bits = label_bitmap(none_of);
+        for (const auto label : all_of)
+            _fits_bitmap = _fits_bitmap && (uint64_t)label < LABEL_BITMAP_BITS;
+        for (const auto label : none_of)
+            _fits_bitmap = _fits_bitmap && (uint64_t)label < LABEL_BITMAP_BITS;
+        _single_labels = _single_labels && all_of.size() == 1 && none_of.empty();
+        clause.all_of = std::move(all_of);
+        clause.none_of = std::move(none_of);
+        _clauses.push_back(std::move(clause));
+        return *this;
+    }
+
+    // Parses clauses separated by '|', each a list of labels separated by '&',
+    // where '!' negates a label: "shoes&red|boots&!used". Whitespace around
+    // labels is ignored; convert maps each label string to its id.
+    static LabelFilter parse(const std::string &expression, const std::function<LabelT(const std::string &)> &convert)
+    {
+        auto trim = [](const std::string &s) {
+            const auto begin = s.find_first_not_of(" \t");
+            return begin == std::string::npos ? std::string() : s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+        };
+
+        LabelFilter filter;
+        size_t clause_begin = 0;
+        while (clause_begin <= expression.size())
+        {
+            size_t clause_end = std::min(expression.find('|', clause_begin), expression.size());
+            std::vector<LabelT> all_of, none_of;
+            size_t term_begin = clause_begin;
+            while (term_begin <= clause_end)
+            {
+                size_t term_end = std::min(expression.find('&', term_begin), clause_end);
+                std::string term = trim(expression.substr(term_begin, term_end - term_begin));
+                const bool negated = !term.empty() && term[0] == '!';
+                if (negated)
+                    term = trim(term.substr(1));
+                if (term.empty())
+                    throw ANNException("Malformed label filter expression: " + expression, -1, __FUNCSIG__, __FILE__,
+                                       __LINE__);
+                (negated ? none_of : all_of).push_back(convert(term));
+                term_begin = term_end + 1;
+            }
+            filter.add_clause(std::move(all_of), std::move(none_of));
+            clause_begin = clause_end + 1;
+        }
+        return filter;
+    }
+
+    const std::vector<Clause> &clauses() const
+    {
+        return _clauses;
+    }
+
+    bool empty() const
+    {
+        return _clauses.empty();
+    }
+
+    // Every label in the filter is below LABEL_BITMAP_BITS.
+    bool fits_bitmap() const
+    {
+        return _fits_bitmap;
+    }
+
+    // The filter is an OR of single labels, so any point reached by the
+    // filtered walk over the anchor labels already matches.
+    bool is_label_disjunction() const
+    {
+        return _single_labels;
+    }
+
+    // The labels the search walks over, one per clause; empty if some clause
+    // has only negated labels, in which case the walk cannot be restricted.
+    std::vector<LabelT> anchor_labels() const
+    {
+        std::vector<LabelT> anchors;
+        for (const auto &clause : _clauses)
+        {
+            if (clause.all_of.empty())
+                return std::vector<LabelT>();
+            anchors.push_back(clause.all_of[0]);
+        }
+        std::sort(anchors.begin(), anchors.end());
+        anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+        return anchors;
+    }
+
+    // Upper bound on the number of points matching the filter, where
+    // count(label) is the number of points carrying label. Points matching
+    // through the universal label are not included.
+    template <typename CountFn> size_t estimate_matches(const CountFn &count, const size_t num_points) const
+    {
+        size_t estimate = 0;
+        for (const auto &clause : _clauses)
+        {
+            size_t clause_estimate = num_points;
+            for (const auto label : clause.all_of)
+                clause_estimate = std::min(clause_estimate, (size_t)count(label));
+            estimate += clause_estimate;
+        }
+        return std::min(estimate, num_points);
+    }
+
+    // Requires fits_bitmap().
+    bool matches(const uint64_t point_bits) const
+    {
+        for (const auto &clause : _clauses)
+            if ((point_bits & clause.all_of_bits) == clause.all_of_bits && (point_bits & clause.none_of_bits) == 0)
+                return true;
+        return false;
+    }
+
+    bool matches(const LabelT *labels, const size_t num_labels) const
+    {
+        auto has = [labels, num_labels](const LabelT label) {
+            return std::find(labels, labels + num_labels, label) != labels + num_labels;
+        };
+        for (const auto &clause : _clauses)
+            if (std::all_of(clause.all_of.begin(), clause.all_of.end(), has) &&
+                std::none_of(clause.none_of.begin(), clause.none_of.end(), has))
+                return true;
+        return false;
+    }
+
+  private:
+    std::vector<Clause> _clauses;
+    bool _fits_bitmap = true;
+    bool _single_labels = true;
+};
+
+// How a filtered search is answered, reported in QueryStats::filter_plan.
+enum class FilterPlan : uint8_t
+{
+    None,       // unfiltered search
+    Graph,      // walk restricted to the anchor labels
+    PostFilter, // unrestricted walk with a longer list, filtered afterwards
+    Exact       // distances to every point the filter may match
+};
+
+// Chooses a plan from an upper bound on the points matching the filter. A
+// graph search computes about L * max_degree distances, so smaller matching
+// sets are scanned instead. An unrestricted walk is used when most points
+// match anyway, or when no anchor label has a start point to walk from.
+inline FilterPlan plan_filtered_search(const size_t estimated_matches, const size_t num_points, const uint32_t L,
+                                       const uint64_t max_degree, const bool has_start_point)
+{
+    if (estimated_matches <= L * max_degree)
+        return FilterPlan::Exact;
+    if (!has_start_point ||
+        (double)estimated_matches >= defaults::FILTER_POST_FILTER_MIN_SELECTIVITY * (double)num_points)
+        return FilterPlan::PostFilter;
+    return FilterPlan::Graph;
+}
+
+// List size for a PostFilter search, scaled so that about L matching points
+// are expected on the list.
+inline uint32_t post_filter_list_size(const size_t estimated_matches, const size_t num_points, const uint32_t L)
+{
+    const double scaled = (double)L * (double)num_points / (double)std::max<size_t>(estimated_matches, 1);
+    return (uint32_t)std::max<double>(
+        L, std::min<double>(scaled, (double)L * defaults::FILTER_POST_FILTER_MAX_EXPANSION));
+}
+} // namespace diskann
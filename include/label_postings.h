@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// The points of each label as a sorted list, stored as varint encoded gaps in
+// one buffer. Labels of a few percent of the points take a byte or two per
+// entry, a quarter of a plain id list. Built once by add() and finalize(),
+// then read concurrently.
+template <typename LabelT> class LabelPostings
+{
+  public:
+    // Points must be added in non-decreasing id order; repeats are dropped.
+    DISKANN_DLLEXPORT void add(const uint32_t point_id, const LabelT label);
+    // Packs the lists into a single buffer. Lookups are valid afterwards.
+    DISKANN_DLLEXPORT void finalize();
+    DISKANN_DLLEXPORT void clear();
+
+    // Number of points carrying label.
+    DISKANN_DLLEXPORT uint32_t count(const LabelT label) const;
+    // Appends up to max_points ids of label to out, in increasing order.
+    DISKANN_DLLEXPORT void decode(const LabelT label, std::vector<uint32_t> &out,
+                                  const size_t max_points = SIZE_MAX) const;
+
+    DISKANN_DLLEXPORT size_t num_labels() const;
+    // The labels with at least one point, in no particular order.
+    DISKANN_DLLEXPORT std::vector<LabelT> labels() const;
+    // Size of the encoded lists in bytes.
+    DISKANN_DLLEXPORT size_t encoded_bytes() const;
+
+  private:
+    struct List
+    {
+        uint64_t offset = 0;
+        uint32_t count = 0;
+        uint32_t last = 0;
+    };
+
+    std::unordered_map<LabelT, List> _lists;
+    // Lists being built, by label; moved into _buffer by finalize.
+    std::unordered_map<LabelT, std::vector<uint8_t>> _pending;
+    std::vector<uint8_t> _buffer;
+};
+} // namespace diskann
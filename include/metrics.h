@@ -0,0 +1,130 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Counters and histograms are sharded by thread: an update is a relaxed atomic
+// add on the calling thread's shard, and reads sum over all shards. Shards are
+// cache line aligned so that threads updating the same metric do not contend.
+constexpr uint32_t METRICS_NUM_SHARDS = 32;
+
+// Histograms are exported with a bucket for every power of two microseconds
+// up to 2^35 us (about 9.5 hours), whether or not it holds values.
+constexpr uint32_t METRICS_EXPORT_MAX_LOG2 = 35;
+
+class Counter
+{
+  public:
+    DISKANN_DLLEXPORT void add(const uint64_t n = 1);
+    DISKANN_DLLEXPORT uint64_t value() const;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> count{0};
+    };
+    Shard _shards[METRICS_NUM_SHARDS];
+};
+
+// Log-linear (HDR-style) histogram of non-negative integer values, typically
+// latencies in microseconds. Values below 16 get a bucket each; above that,
+// every power of two is split into 8 buckets, bounding the relative error of a
+// reported quantile by 12.5%.
+class Histogram
+{
+  public:
+    static constexpr uint32_t NUM_BUCKETS = 16 + 60 * 8;
+
+    DISKANN_DLLEXPORT void record(const uint64_t value);
+    DISKANN_DLLEXPORT uint64_t count() const;
+    DISKANN_DLLEXPORT uint64_t sum() const;
+    // Upper bound of the bucket holding the given quantile, 0 if empty.
+    DISKANN_DLLEXPORT uint64_t quantile(const double q) const;
+    // Adds the bucket counts over all shards into counts[NUM_BUCKETS].
+    DISKANN_DLLEXPORT void bucket_counts(uint64_t *counts) const;
+
+    DISKANN_DLLEXPORT static uint32_t bucket_index(const uint64_t value);
+    // Smallest value that does not fit in the bucket.
+    DISKANN_DLLEXPORT static uint64_t bucket_limit(const uint32_t index);
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+    };
+    std::unique_ptr<Shard[]> _shards{new Shard[METRICS_NUM_SHARDS]};
+};
+
+// Named metrics exported in the Prometheus text exposition format.
+// Registration takes a lock and returns the existing metric if the name is
+// already registered, so components look their metrics up once and keep the
+// reference; updates never touch the registry.
+//
+// Histograms record microseconds and are exported in seconds, so their names
+// should end in "_seconds". The bucket for 2^k us counts the values below it,
+// which for integer microseconds is le = 2^k - 1 us.
+class MetricsRegistry
+{
+  public:
+    DISKANN_DLLEXPORT static MetricsRegistry &global();
+
+    DISKANN_DLLEXPORT Counter &counter(const std::string &name, const std::string &help);
+    DISKANN_DLLEXPORT Histogram &histogram(const std::string &name, const std::string &help);
+
+    DISKANN_DLLEXPORT void write_prometheus(std::ostream &out) const;
+    DISKANN_DLLEXPORT std::string prometheus_text() const;
+
+  private:
+    template <typename MetricT> struct Entry
+    {
+        std::string help;
+        std::unique_ptr<MetricT> metric;
+    };
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Entry<Counter>> _counters;
+    std::map<std::string, Entry<Histogram>> _histograms;
+};
+
+// Metrics updated by every in-memory Index, registered in the global registry.
+struct InMemoryIndexMetrics
+{
+    Counter &queries;
+    Counter &inserts;
+    Counter &deletes;
+    Counter &consolidations;
+    Histogram &query_latency;
+    Histogram &scratch_wait;
+    Histogram &insert_latency;
+    Histogram &consolidation_duration;
+
+    DISKANN_DLLEXPORT static InMemoryIndexMetrics &get();
+};
+
+// Metrics updated by every PQFlashIndex, registered in the global registry.
+struct DiskIndexMetrics
+{
+    Counter &queries;
+    Counter &ios;
+    Counter &cache_hits;
+    Histogram &query_latency;
+    Histogram &scratch_wait;
+    Histogram &io_latency;
+
+    DISKANN_DLLEXPORT static DiskIndexMetrics &get();
+};
+} // namespace diskann
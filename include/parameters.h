@@ -24,12 +24,31 @@ class IndexWriteParameters
     const uint32_t num_threads;
     const uint32_t filter_list_size; // Lf
 
+    // Coarse first pass of the build: a cheap graph over a (sampled) subset of
+    // the points is linked with a small list size and alpha before the full
+    // pass at the target parameters refines it. 0 disables the first pass.
+    const uint32_t first_pass_list_size; // L1
+    const float first_pass_alpha;
+    const float first_pass_sample_rate;
+
+    // Seed the graph with the pruned exact k nearest neighbours of each point
+    // within its nearest k-means clusters before the Vamana passes. 0 disables.
+    // The neighbours are found by L2 distance without regard to labels, so the
+    // build rejects it for other metrics and for filtered builds.
+    const uint32_t knn_seed_degree;
+
     IndexWriteParameters(const uint32_t search_list_size, const uint32_t max_degree, const bool saturate_graph,
                          const uint32_t max_occlusion_size, const float alpha, const uint32_t num_threads,
-                         const uint32_t filter_list_size)
+                         const uint32_t filter_list_size,
+                         const uint32_t first_pass_list_size = defaults::FIRST_PASS_LIST_SIZE,
+                         const float first_pass_alpha = defaults::FIRST_PASS_ALPHA,
+                         const float first_pass_sample_rate = defaults::FIRST_PASS_SAMPLE_RATE,
+                         const uint32_t knn_seed_degree = defaults::KNN_SEED_DEGREE)
         : search_list_size(search_list_size), max_degree(max_degree), saturate_graph(saturate_graph),
           max_occlusion_size(max_occlusion_size), alpha(alpha), num_threads(num_threads),
-          filter_list_size(filter_list_size)
+          filter_list_size(filter_list_size), first_pass_list_size(first_pass_list_size),
+          first_pass_alpha(first_pass_alpha), first_pass_sample_rate(first_pass_sample_rate),
+          knn_seed_degree(knn_seed_degree)
     {
     }
 
@@ -91,16 +110,43 @@ class IndexWriteParametersBuilder
         return *this;
     }
 
+    IndexWriteParametersBuilder &with_first_pass_list_size(const uint32_t first_pass_list_size)
+    {
+        _first_pass_list_size = first_pass_list_size;
+        return *this;
+    }
+
+    IndexWriteParametersBuilder &with_first_pass_alpha(const float first_pass_alpha)
+    {
+        _first_pass_alpha = first_pass_alpha;
+        return *this;
+    }
+
+    IndexWriteParametersBuilder &with_first_pass_sample_rate(const float first_pass_sample_rate)
+    {
+        _first_pass_sample_rate = first_pass_sample_rate;
+        return *this;
+    }
+
+    IndexWriteParametersBuilder &with_knn_seed_degree(const uint32_t knn_seed_degree)
+    {
+        _knn_seed_degree = knn_seed_degree;
+        return *this;
+    }
+
     IndexWriteParameters build() const
     {
         return IndexWriteParameters(_search_list_size, _max_degree, _saturate_graph, _max_occlusion_size, _alpha,
-                                    _num_threads, _filter_list_size);
+                                    _num_threads, _filter_list_size, _first_pass_list_size, _first_pass_alpha,
+                                    _first_pass_sample_rate, _knn_seed_degree);
     }
 
     IndexWriteParametersBuilder(const IndexWriteParameters &wp)
         : _search_list_size(wp.search_list_size), _max_degree(wp.max_degree),
           _max_occlusion_size(wp.max_occlusion_size), _saturate_graph(wp.saturate_graph), _alpha(wp.alpha),
-          _filter_list_size(wp.filter_list_size)
+          _filter_list_size(wp.filter_list_size), _first_pass_list_size(wp.first_pass_list_size),
+          _first_pass_alpha(wp.first_pass_alpha), _first_pass_sample_rate(wp.first_pass_sample_rate),
+          _knn_seed_degree(wp.knn_seed_degree)
     {
     }
     IndexWriteParametersBuilder(const IndexWriteParametersBuilder &) = delete;
@@ -114,6 +160,10 @@ class IndexWriteParametersBuilder
     float _alpha{defaults::ALPHA};
     uint32_t _num_threads{defaults::NUM_THREADS};
     uint32_t _filter_list_size{defaults::FILTER_LIST_SIZE};
+    uint32_t _first_pass_list_size{defaults::FIRST_PASS_LIST_SIZE};
+    float _first_pass_alpha{defaults::FIRST_PASS_ALPHA};
+    float _first_pass_sample_rate{defaults::FIRST_PASS_SAMPLE_RATE};
+    uint32_t _knn_seed_degree{defaults::KNN_SEED_DEGREE};
 };
 
 } // namespace diskann
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "distance.h"
+#include "label_filter.h"
 #include "parameters.h"
 
 namespace diskann
@@ -33,6 +34,8 @@ struct QueryStats
     unsigned n_cmps = 0;       // # cmps
     unsigned n_cache_hits = 0; // # cache_hits
     unsigned n_hops = 0;       // # search hops
+
+    FilterPlan filter_plan = FilterPlan::None; // how a filtered search was answered
 };
 
 template <typename T>
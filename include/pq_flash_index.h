@@ -6,10 +6,13 @@
 
 #include "aligned_file_reader.h"
 #include "concurrent_queue.h"
+#include "label_filter.h"
+#include "label_postings.h"
 #include "neighbor.h"
 #include "parameters.h"
 #include "percentile_stats.h"
 #include "pq.h"
+#include "query_trace.h"
 #include "utils.h"
 #include "windows_customizations.h"
 #include "scratch.h"
@@ -50,17 +53,35 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     DISKANN_DLLEXPORT void generate_cache_list_from_sample_queries(MemoryMappedFiles &files, std::string sample_bin,
                                                                    uint64_t l_search, uint64_t beamwidth,
                                                                    uint64_t num_nodes_to_cache, uint32_t nthreads,
-                                                                   std::vector<uint32_t> &node_list);
+                                                                   std::vector<uint32_t> &node_list,
+                                                                   const std::vector<LabelT> &sample_labels =
+                                                                       std::vector<LabelT>());
 #else
+    // sample_labels holds the filter label of each sample query, or one label
+    // for all of them. If empty, a filtered index searches each sample with a
+    // label drawn from the base label distribution.
     DISKANN_DLLEXPORT void generate_cache_list_from_sample_queries(std::string sample_bin, uint64_t l_search,
                                                                    uint64_t beamwidth, uint64_t num_nodes_to_cache,
                                                                    uint32_t num_threads,
-                                                                   std::vector<uint32_t> &node_list);
+                                                                   std::vector<uint32_t> &node_list,
+                                                                   const std::vector<LabelT> &sample_labels =
+                                                                       std::vector<LabelT>());
 #endif
 
     DISKANN_DLLEXPORT void cache_bfs_levels(uint64_t num_nodes_to_cache, std::vector<uint32_t> &node_list,
                                             const bool shuffle = false);
 
+    // Like cache_bfs_levels, but splits the budget between the neighbourhood
+    // of the medoids and those of the entry points of each label, in
+    // proportion to how often searches start there. query_labels holds the
+    // label of each sample filtered query and num_unfiltered_queries counts
+    // the unfiltered ones; with neither, labels are weighted by their number
+    // of points. A label's neighbourhood only takes points its filtered walk
+    // can reach. The allocation is logged.
+    DISKANN_DLLEXPORT void cache_label_bfs_levels(uint64_t num_nodes_to_cache, std::vector<uint32_t> &node_list,
+                                                  const std::vector<LabelT> &query_labels = std::vector<LabelT>(),
+                                                  const uint64_t num_unfiltered_queries = 0);
+
     DISKANN_DLLEXPORT void cached_beam_search(const T *query, const uint64_t k_search, const uint64_t l_search,
                                               uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
                                               const bool use_reorder_data = false, QueryStats *stats = nullptr);
@@ -81,8 +102,28 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
                                               const uint32_t io_limit, const bool use_reorder_data = false,
                                               QueryStats *stats = nullptr);
 
+    // Search restricted to points matching a boolean label predicate, see
+    // LabelFilter. Fewer than k_search entries are written if fewer matching
+    // points are found. The search is planned from label cardinalities, and
+    // stats->filter_plan reports the plan; see plan_filtered_search.
+    DISKANN_DLLEXPORT void cached_beam_search(const T *query, const uint64_t k_search, const uint64_t l_search,
+                                              uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
+                                              const LabelFilter<LabelT> &filter,
+                                              const uint32_t io_limit = std::numeric_limits<uint32_t>::max(),
+                                              const bool use_reorder_data = false, QueryStats *stats = nullptr);
+
     DISKANN_DLLEXPORT LabelT get_converted_label(const std::string &filter_label);
 
+    // Number of points carrying a label, and the points themselves in
+    // increasing order; 0 and empty for an index without labels.
+    DISKANN_DLLEXPORT uint32_t get_label_count(const LabelT &label) const;
+    DISKANN_DLLEXPORT std::vector<uint32_t> get_label_points(const LabelT &label) const;
+
+    // Returns the points within range of the query, nearest first, and their
+    // count. range bounds the distances reported, as in Index::range_search:
+    // for inner product it is the smallest inner product returned. The search
+    // starts with a list of min_l_search and grows it up to max_l_search while
+    // results keep filling it, see RangeQuery.
     DISKANN_DLLEXPORT uint32_t range_search(const T *query1, const double range, const uint64_t min_l_search,
                                             const uint64_t max_l_search, std::vector<uint64_t> &indices,
                                             std::vector<float> &distances, const uint64_t min_beam_width,
@@ -108,6 +149,10 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     DISKANN_DLLEXPORT std::vector<std::uint8_t> get_pq_vector(std::uint64_t vid);
     DISKANN_DLLEXPORT uint64_t get_num_points();
 
+    // Record per-query traces for a sample of searches. Pass nullptr to stop
+    // tracing. Must not be called concurrently with searches.
+    DISKANN_DLLEXPORT void set_query_tracer(std::shared_ptr<QueryTracer> tracer);
+
   protected:
     DISKANN_DLLEXPORT void use_medoids_data_as_centroids();
     DISKANN_DLLEXPORT void setup_thread_data(uint64_t nthreads, uint64_t visited_reserve = 4096);
@@ -116,6 +161,38 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
 
   private:
     DISKANN_DLLEXPORT inline bool point_has_label(uint32_t point_id, LabelT label_id);
+    bool matches_label_filter(uint32_t point_id, const LabelFilter<LabelT> &filter);
+    size_t estimate_filter_matches(const LabelFilter<LabelT> &filter) const;
+    // Sets candidates to a sorted superset of the points filter matches.
+    void get_filter_candidates(const LabelFilter<LabelT> &filter, std::vector<uint32_t> &candidates) const;
+    // A range query run by cached_beam_search_impl. Once the walk converges,
+    // the list grows to twice its size while at least a quarter of it is in
+    // range and the last round found new results, up to max_l_search. Expanded
+    // nodes, the visited set and the candidates dropped from the full list are
+    // kept, so each sector is read once.
+    struct RangeQuery
+    {
+        // In the space of the distances reported: squared L2 for L2 and
+        // cosine, the smallest inner product returned for mips.
+        float range = 0;
+        uint64_t max_l_search = 0;
+        uint64_t min_beam_width = 0;
+        std::vector<uint64_t> *indices = nullptr;
+        std::vector<float> *distances = nullptr;
+    };
+
+    // filter is nullptr for an unfiltered search. With range, results are
+    // written to range->indices and range->distances instead of res_ids and
+    // res_dists.
+    void cached_beam_search_impl(const T *query, const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids,
+                                 float *res_dists, const uint64_t beam_width, const LabelFilter<LabelT> *filter,
+                                 const uint32_t io_limit, const bool use_reorder_data, QueryStats *stats,
+                                 RangeQuery *range = nullptr);
+    // Adds up to budget points to node_set by a BFS from seeds over the points
+    // admit accepts, and returns the number added. Points already in node_set
+    // are expanded but not counted.
+    uint64_t cache_neighbourhood(const std::vector<uint32_t> &seeds, const uint64_t budget,
+                                 const std::function<bool(uint32_t)> &admit, tsl::robin_set<uint32_t> &node_set);
     std::unordered_map<std::string, LabelT> load_label_map(std::basic_istream<char> &infile);
     DISKANN_DLLEXPORT void parse_label_file(std::basic_istream<char> &infile, size_t &num_pts_labels);
     DISKANN_DLLEXPORT void get_label_file_metadata(const std::string &fileContent, uint32_t &num_pts,
@@ -215,6 +292,7 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
 
     // thread-specific scratch
     ConcurrentQueue<SSDThreadData<T> *> _thread_data;
+    std::shared_ptr<QueryTracer> _query_tracer;
     uint64_t _max_nthreads;
     bool _load_flag = false;
     bool _count_visited_nodes = false;
@@ -225,6 +303,10 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     uint32_t *_pts_to_label_offsets = nullptr;
     uint32_t *_pts_to_label_counts = nullptr;
     LabelT *_pts_to_labels = nullptr;
+    // Labels below LABEL_BITMAP_BITS of each point as a bitmap.
+    std::vector<uint64_t> _pts_to_label_bits;
+    // Points of each label, built when the label file is loaded.
+    LabelPostings<LabelT> _label_postings;
     std::unordered_map<LabelT, std::vector<uint32_t>> _filter_to_medoid_ids;
     bool _use_universal_label = false;
     LabelT _universal_filter_label;
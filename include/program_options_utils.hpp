@@ -58,6 +58,10 @@ const char *FAIL_IF_RECALL_BELOW =
                                                                  // still get my results even if the return code is -1?
 
 const char *NUMBER_OF_NODES_TO_CACHE = "Number of BFS nodes around medoid(s) to cache.  Default value: 0";
+const char *QUERY_TRACE_FILE = "Write per-query latency breakdowns (scratch wait, PQ table, per-hop and re-rank "
+                               "times, cache hits by hop) of the searched queries to this file.  Default: no tracing";
+const char *QUERY_TRACE_FORMAT = "Format of the query trace file: json or chrome (chrome://tracing, Perfetto)";
+const char *QUERY_TRACE_SAMPLE_RATE = "Fraction of queries to trace, between 0 and 1.  Default value: 1";
 const char *BEAMWIDTH = "Beamwidth for search. Set 0 to optimize internally.  Default value: 2";
 const char *MAX_BUILD_DEGREE = "Maximum graph degree";
 const char *GRAPH_BUILD_COMPLEXITY =
@@ -66,6 +70,13 @@ const char *GRAPH_BUILD_COMPLEXITY =
     "graph.";
 const char *GRAPH_BUILD_ALPHA = "Alpha controls density and diameter of graph, set 1 for sparse graph, 1.2 or 1.4 for "
                                 "denser graphs with lower diameter";
+const char *FIRST_PASS_LBUILD = "Build complexity of an optional coarse first build pass, 0 builds in a single pass";
+const char *FIRST_PASS_ALPHA = "Alpha used to prune in the coarse first build pass";
+const char *FIRST_PASS_SAMPLE_RATE =
+    "Fraction of the points linked in the coarse first build pass; all points are linked in the second pass";
+const char *KNN_SEED_K = "Seed the graph with the k nearest neighbours of each point computed within k-means "
+                         "clusters before the greedy build passes, 0 disables seeding. Only for unfiltered "
+                         "builds with the l2 metric";
 const char *BUIlD_GRAPH_PQ_BYTES = "Number of PQ bytes to build the index; 0 for full precision build";
 const char *USE_OPQ = "Use Optimized Product Quantization (OPQ).";
 const char *LABEL_FILE = "Input label file in txt format for Filtered Index build. The file should contain comma "
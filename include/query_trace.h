@@ -0,0 +1,131 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Per-query breakdown of where search time went. Filled in by Index and
+// PQFlashIndex for the queries sampled by a QueryTracer. All times are in
+// microseconds; begin offsets are relative to the start of the query.
+struct QueryTrace
+{
+    static constexpr uint32_t MAX_HOPS = 64;   // per-hop timings kept for the first MAX_HOPS hops
+    static constexpr uint32_t MAX_LEVELS = 16; // cache lookups at deeper hops are folded into the last level
+
+    uint64_t query_id = 0;
+    uint64_t thread_id = 0;
+    int64_t start_us = 0; // relative to the tracer's creation
+
+    float total_us = 0;
+    float scratch_wait_us = 0; // waiting for a scratch space from the pool
+    float pq_table_begin_us = 0;
+    float pq_table_us = 0; // query preprocessing and PQ distance table construction
+    float rerank_begin_us = 0;
+    float rerank_us = 0; // full precision re-ranking, including its IO
+    float io_us = 0;
+
+    uint32_t n_hops = 0;
+    uint32_t n_cmps = 0;
+    uint32_t n_ios = 0;
+
+    float hop_begin_us[MAX_HOPS] = {};
+    float hop_us[MAX_HOPS] = {};
+    uint32_t cache_hits[MAX_LEVELS] = {};
+    uint32_t cache_misses[MAX_LEVELS] = {};
+
+    std::chrono::steady_clock::time_point started;
+
+    void reset()
+    {
+        *this = QueryTrace{};
+        started = std::chrono::steady_clock::now();
+    }
+
+    float elapsed_us() const
+    {
+        return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    void add_hop(const float begin_us)
+    {
+        if (n_hops < MAX_HOPS)
+        {
+            hop_begin_us[n_hops] = begin_us;
+            hop_us[n_hops] = elapsed_us() - begin_us;
+        }
+        n_hops++;
+    }
+
+    void add_cache_lookup(const uint32_t level, const bool hit)
+    {
+        const uint32_t l = level < MAX_LEVELS ? level : MAX_LEVELS - 1;
+        if (hit)
+            cache_hits[l]++;
+        else
+            cache_misses[l]++;
+    }
+};
+
+// Samples queries at a fixed rate and keeps the traces of the most recent ones
+// in a fixed-size ring buffer. Recording is lock-free: each slot is guarded by
+// a sequence number, so a dump taken while searches are running skips slots
+// that are being overwritten. The capacity should exceed the number of
+// concurrently running queries.
+//
+// Usage from a search path:
+//     QueryTrace *trace = tracer ? tracer->begin_query() : nullptr;
+//     ... if (trace != nullptr) trace->... ...
+//     if (trace != nullptr) tracer->end_query(trace);
+class QueryTracer
+{
+  public:
+    DISKANN_DLLEXPORT QueryTracer(const size_t capacity, const float sample_rate = 1.0f);
+    DISKANN_DLLEXPORT ~QueryTracer();
+
+    QueryTracer(const QueryTracer &) = delete;
+    QueryTracer &operator=(const QueryTracer &) = delete;
+
+    // Returns the calling thread's trace, reset and started, if this query is
+    // sampled and nullptr otherwise. The trace stays valid until end_query.
+    DISKANN_DLLEXPORT QueryTrace *begin_query();
+    DISKANN_DLLEXPORT void end_query(QueryTrace *trace);
+
+    // Traces currently held in the ring buffer, oldest first.
+    DISKANN_DLLEXPORT std::vector<QueryTrace> snapshot() const;
+
+    DISKANN_DLLEXPORT uint64_t num_queries() const;
+    DISKANN_DLLEXPORT uint64_t num_traced() const;
+
+    // One JSON object per trace, with per-hop timings and cache counts by level.
+    DISKANN_DLLEXPORT void dump_json(std::ostream &out) const;
+    // Chrome trace event format, viewable in chrome://tracing or Perfetto.
+    DISKANN_DLLEXPORT void dump_chrome_trace(std::ostream &out) const;
+    // format is either "json" or "chrome".
+    DISKANN_DLLEXPORT void save(const std::string &path, const std::string &format = "json") const;
+
+  private:
+    struct Slot
+    {
+        std::atomic<uint64_t> seq{0}; // 2 * ticket + 1 while being written, 2 * ticket + 2 once complete
+        QueryTrace trace;
+    };
+
+    size_t _capacity;
+    double _sample_rate;
+    std::unique_ptr<Slot[]> _slots;
+    std::atomic<uint64_t> _num_queries{0};
+    std::atomic<uint64_t> _next_ticket{0};
+    std::chrono::steady_clock::time_point _epoch;
+};
+} // namespace diskann
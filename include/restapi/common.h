@@ -12,7 +12,41 @@ namespace diskann
 static const std::string VECTOR_KEY = "query", K_KEY = "k", INDICES_KEY = "indices", DISTANCES_KEY = "distances",
                          TAGS_KEY = "tags", QUERY_ID_KEY = "query_id", ERROR_MESSAGE_KEY = "error", L_KEY = "Ls",
                          TIME_TAKEN_KEY = "time_taken_in_us", PARTITION_KEY = "partition",
-                         UNKNOWN_ERROR = "unknown_error";
+                         MISSING_PARTITIONS_KEY = "missing_partitions", UNKNOWN_ERROR = "unknown_error",
+                         IN_FLIGHT_KEY = "in_flight", QUEUE_DEPTH_KEY = "queue_depth", ADMITTED_KEY = "admitted",
+                         DEGRADED_KEY = "degraded", REJECTED_KEY = "rejected", TIMED_OUT_KEY = "timed_out";
 const unsigned int DEFAULT_L = 100;
 
+// GET on this path returns the metrics registry in the Prometheus text format.
+static const std::string METRICS_PATH = "/metrics";
+
+// Binary batched query protocol, used for POST requests with content type
+// BINARY_CONTENT_TYPE. All fields are in host (little-endian) byte order.
+// Request:  BinaryQueryHeader followed by num_queries * dimensions elements
+//           of the index data type, one query after the other.
+// Response: BinaryResponseHeader followed by num_queries * k uint32_t ids and
+//           then num_queries * k float distances, both row-major by query.
+//           Rows with fewer than k results are padded with
+//           std::numeric_limits<uint32_t>::max() / std::numeric_limits<float>::max().
+// Failed requests are answered with an error status and a text message.
+static const std::string BINARY_CONTENT_TYPE = "application/octet-stream";
+const uint32_t BINARY_PROTOCOL_MAGIC = 0x314e4e41; // "ANN1"
+
+struct BinaryQueryHeader
+{
+    uint32_t magic;
+    uint32_t num_queries;
+    uint32_t dimensions;
+    uint32_t k;
+    uint32_t Ls;
+};
+
+struct BinaryResponseHeader
+{
+    uint32_t magic;
+    uint32_t num_queries;
+    uint32_t k;
+    uint32_t time_taken_in_us;
+};
+
 } // namespace diskann
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -81,6 +83,86 @@ class SearchNotImplementedException : public std::logic_error
     }
 };
 
+const unsigned int DEFAULT_W = 1;
+
+// Limits on the searches one BaseSearch runs at a time. A request that finds
+// all max_in_flight slots busy waits in a queue of at most max_queue_depth
+// requests, for at most max_queue_wait_ms, and is rejected otherwise. While
+// degrade_queue_depth or more requests are waiting, admitted requests search
+// with degraded_l_factor * Ls (but at least K) and beamwidth 1.
+struct AdmissionParams
+{
+    uint32_t max_in_flight = 0; // 0 disables admission control
+    uint32_t max_queue_depth = 0;
+    uint32_t max_queue_wait_ms = 0; // 0 waits until a slot frees up
+    uint32_t degrade_queue_depth = 0; // 0 never degrades
+    float degraded_l_factor = 0.5f;
+};
+
+struct AdmissionStats
+{
+    uint64_t in_flight = 0;
+    uint64_t queue_depth = 0;
+    uint64_t admitted = 0;
+    uint64_t degraded = 0;
+    uint64_t rejected = 0;
+    uint64_t timed_out = 0;
+};
+
+class SearchRejectedException : public std::runtime_error
+{
+  public:
+    SearchRejectedException(const std::string &msg) : std::runtime_error(msg)
+    {
+    }
+};
+
+class AdmissionController
+{
+  public:
+    AdmissionController(const AdmissionParams &params);
+
+    // Blocks until the request may run and returns whether it should run
+    // degraded; throws SearchRejectedException if the queue is full or the
+    // request waited for longer than max_queue_wait_ms.
+    bool acquire();
+    void release();
+
+    AdmissionStats stats() const;
+
+  private:
+    const AdmissionParams _params;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    AdmissionStats _stats;
+};
+
+// Holds an admission slot for the duration of one search.
+class AdmissionTicket
+{
+  public:
+    AdmissionTicket(AdmissionController *controller)
+        : _controller(controller), _degraded(controller != nullptr ? controller->acquire() : false)
+    {
+    }
+    ~AdmissionTicket()
+    {
+        if (_controller != nullptr)
+            _controller->release();
+    }
+    AdmissionTicket(const AdmissionTicket &) = delete;
+    AdmissionTicket &operator=(const AdmissionTicket &) = delete;
+
+    bool degraded() const
+    {
+        return _degraded;
+    }
+
+  private:
+    AdmissionController *_controller;
+    const bool _degraded;
+};
+
 class BaseSearch
 {
   public:
@@ -104,9 +186,17 @@ class BaseSearch
 
     void lookup_tags(const unsigned K, const unsigned *indices, std::string *ret_tags);
 
+    void set_admission_params(const AdmissionParams &params);
+    AdmissionStats admission_stats() const;
+
   protected:
+    unsigned degraded_l(const unsigned K, const unsigned Ls) const;
+
     bool _tags_enabled;
     std::vector<std::string> _tags_str;
+
+    AdmissionParams _admission_params;
+    std::unique_ptr<AdmissionController> _admission;
 };
 
 template <typename T> class InMemorySearch : public BaseSearch
@@ -127,7 +217,7 @@ template <typename T> class PQFlashSearch : public BaseSearch
 {
   public:
     PQFlashSearch(const std::string &indexPrefix, const unsigned num_nodes_to_cache, const unsigned num_threads,
-                  const std::string &tagsFile, Metric m);
+                  const std::string &tagsFile, Metric m, const unsigned beamwidth = DEFAULT_W);
     virtual ~PQFlashSearch();
 
     SearchResult search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls);
@@ -136,5 +226,6 @@ template <typename T> class PQFlashSearch : public BaseSearch
     unsigned int _dimensions, _numPoints;
     std::unique_ptr<diskann::PQFlashIndex<T>> _index;
     std::shared_ptr<AlignedFileReader> reader;
+    unsigned _beamwidth;
 };
 } // namespace diskann
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <restapi/common.h>
+#include <restapi/thread_pool.h>
 #include <cpprest/http_listener.h>
 
 namespace diskann
@@ -11,8 +12,16 @@ namespace diskann
 class Server
 {
   public:
+    // With more than one searcher, queries are fanned out to all of them on a
+    // pool of shard_threads workers shared by all requests (when 0, one per
+    // hardware thread but at least one per searcher). A searcher that has not
+    // answered within shard_timeout_ms (0: no timeout) or that fails fails the
+    // query, unless partial_results is set, in which case the query is answered
+    // from the remaining searchers. Searches still queued at the deadline are
+    // dropped. is_debug logs every request body and response.
     Server(web::uri &url, std::vector<std::unique_ptr<diskann::BaseSearch>> &multi_searcher,
-           const std::string &typestring);
+           const std::string &typestring, const unsigned shard_threads = 0, const unsigned shard_timeout_ms = 0,
+           const bool partial_results = false, const bool is_debug = false);
     virtual ~Server();
 
     pplx::task<void> open();
@@ -20,6 +29,10 @@ class Server
 
   protected:
     template <class T> void handle_post(web::http::http_request message);
+    template <class T> void handle_binary_post(web::http::http_request message);
+    // Reports the admission control counters of every searcher, or the
+    // Prometheus metrics when the path is METRICS_PATH.
+    void handle_get(web::http::http_request message);
 
     template <typename T>
     web::json::value toJsonArray(const std::vector<T> &v, std::function<web::json::value(const T &)> valConverter);
@@ -34,12 +47,25 @@ class Server
     web::json::value tagsToJsonArray(const diskann::SearchResult &result);
     web::json::value partitionsToJsonArray(const diskann::SearchResult &result);
 
-    SearchResult aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results);
+    template <class T>
+    std::vector<diskann::SearchResult> search_shards(const std::shared_ptr<T> &queryVector, const unsigned int dimensions,
+                                                     const unsigned int K, const unsigned int Ls,
+                                                     std::vector<unsigned> &partitions,
+                                                     std::vector<unsigned> &missing_partitions);
+
+    SearchResult aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results,
+                                   const std::vector<unsigned> &partitions);
 
   private:
     bool _isDebug;
     std::unique_ptr<web::http::experimental::listener::http_listener> _listener;
     const bool _multi_search;
     std::vector<std::unique_ptr<diskann::BaseSearch>> _multi_searcher;
+
+    const unsigned _shard_timeout_ms;
+    const bool _partial_results;
+    std::unique_ptr<ThreadPool> _shard_pool;
+    // Queries of a binary batch searched concurrently.
+    unsigned _batch_threads;
 };
 } // namespace diskann
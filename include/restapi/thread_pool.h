@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace diskann
+{
+// Fixed-size pool of worker threads used by the server to run per-shard
+// searches concurrently. Tasks are run in submission order; tasks still queued
+// when the pool is destroyed are run before the workers exit.
+class ThreadPool
+{
+  public:
+    ThreadPool(const size_t num_threads)
+    {
+        for (size_t i = 0; i < num_threads; i++)
+            _workers.emplace_back([this] { worker_loop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+        for (auto &worker : _workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _tasks.push(std::move(task));
+        }
+        _cv.notify_one();
+    }
+
+    size_t num_threads() const
+    {
+        return _workers.size();
+    }
+
+  private:
+    void worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+                if (_tasks.empty())
+                    return;
+                task = std::move(_tasks.front());
+                _tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stopping = false;
+};
+} // namespace diskann
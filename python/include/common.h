@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <stdexcept>
 #include <stdint.h>
 #include <utility>
 
@@ -21,4 +22,18 @@ typedef uint32_t DynamicIdType;
 
 template <class IdType> using NeighborsAndDistances = std::pair<py::array_t<IdType>, py::array_t<float>>;
 
+// Throws std::invalid_argument (ValueError in python) unless ids and dists are
+// writeable (num_queries, knn) arrays that results can be written into in place.
+template <class IdType>
+void check_batch_outputs(py::array_t<IdType, py::array::c_style> &ids, py::array_t<float, py::array::c_style> &dists,
+                         const uint64_t num_queries, const uint64_t knn)
+{
+    if (ids.ndim() != 2 || (uint64_t)ids.shape(0) != num_queries || (uint64_t)ids.shape(1) != knn)
+        throw std::invalid_argument("neighbors output must have shape (num_queries, knn)");
+    if (dists.ndim() != 2 || (uint64_t)dists.shape(0) != num_queries || (uint64_t)dists.shape(1) != knn)
+        throw std::invalid_argument("distances output must have shape (num_queries, knn)");
+    if (!ids.writeable() || !dists.writeable())
+        throw std::invalid_argument("output arrays must be writeable");
+}
+
 }; // namespace diskannpy
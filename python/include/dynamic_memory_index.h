@@ -40,6 +40,12 @@ class DynamicMemoryIndex
     NeighborsAndDistances<DynamicIdType> batch_search(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries,
                                             uint64_t num_queries, uint64_t knn, uint64_t complexity,
                                             uint32_t num_threads);
+    // Like batch_search, but writes into caller-provided (num_queries, knn)
+    // arrays. The GIL is released while searching.
+    void batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries,
+                           uint64_t knn, uint64_t complexity, uint32_t num_threads,
+                           py::array_t<DynamicIdType, py::array::c_style> &ids,
+                           py::array_t<float, py::array::c_style> &dists);
     void consolidate_delete();
     size_t num_points();
 
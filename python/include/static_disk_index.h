@@ -46,6 +46,13 @@ template <typename DT> class StaticDiskIndex
         py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries, uint64_t knn,
         uint64_t complexity, uint64_t beam_width, uint32_t num_threads);
 
+    // Like batch_search, but writes into caller-provided (num_queries, knn)
+    // arrays. The GIL is released while searching.
+    void batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries,
+                           uint64_t knn, uint64_t complexity, uint64_t beam_width, uint32_t num_threads,
+                           py::array_t<StaticIdType, py::array::c_style> &ids,
+                           py::array_t<float, py::array::c_style> &dists);
+
   private:
     std::shared_ptr<AlignedFileReader> _reader;
     diskann::PQFlashIndex<DT> _index;
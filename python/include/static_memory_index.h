@@ -34,6 +34,13 @@ template <typename DT> class StaticMemoryIndex
         py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries, uint64_t knn,
         uint64_t complexity, uint32_t num_threads);
 
+    // Like batch_search, but writes into caller-provided (num_queries, knn)
+    // arrays. The GIL is released while searching.
+    void batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries,
+                           uint64_t knn, uint64_t complexity, uint32_t num_threads,
+                           py::array_t<StaticIdType, py::array::c_style> &ids,
+                           py::array_t<float, py::array::c_style> &dists);
+
   private:
     diskann::Index<DT, StaticIdType, filterT> _index;
 };
@@ -2,7 +2,9 @@
 # Licensed under the MIT license.
 
 import os
+import threading
 import warnings
+from concurrent.futures import Executor, ThreadPoolExecutor
 from enum import Enum
 from pathlib import Path
 from typing import Literal, NamedTuple, Optional, Tuple, Type, Union
@@ -66,7 +68,7 @@ def _castable_dtype_or_raise(
     data: Union[VectorLike, VectorLikeBatch, VectorIdentifierBatch], expected: np.dtype
 ) -> np.ndarray:
     if isinstance(data, np.ndarray) and np.can_cast(data.dtype, expected):
-        return data.astype(expected, casting="safe")
+        return data.astype(expected, casting="safe", copy=False)
     else:
         raise TypeError(
             f"expecting a numpy ndarray of dtype {expected}, not a {type(data)}"
@@ -77,6 +79,56 @@ def _assert_2d(vectors: np.ndarray, name: str):
     _assert(len(vectors.shape) == 2, f"{name} must be 2d numpy array")
 
 
+def _valid_batch_outputs(
+    neighbors_out: Optional[np.ndarray],
+    distances_out: Optional[np.ndarray],
+    num_queries: int,
+    k_neighbors: int,
+) -> bool:
+    """
+    Returns whether preallocated batch search outputs were provided, and raises if they cannot be written to in place.
+    """
+    if neighbors_out is None and distances_out is None:
+        return False
+    _assert(
+        neighbors_out is not None and distances_out is not None,
+        "neighbors_out and distances_out must be provided together",
+    )
+    for output, name, dtype in (
+        (neighbors_out, "neighbors_out", np.uint32),
+        (distances_out, "distances_out", np.float32),
+    ):
+        _assert(
+            isinstance(output, np.ndarray) and output.dtype == dtype,
+            f"{name} must be a numpy ndarray of dtype {dtype.__name__}",
+        )
+        _assert(
+            output.shape == (num_queries, k_neighbors),
+            f"{name} must have shape (num_queries, k_neighbors) = {(num_queries, k_neighbors)}",
+        )
+        _assert(
+            output.flags.c_contiguous and output.flags.writeable,
+            f"{name} must be C-contiguous and writeable",
+        )
+    return True
+
+
+_ASYNC_EXECUTOR: Optional[ThreadPoolExecutor] = None
+_ASYNC_EXECUTOR_LOCK = threading.Lock()
+
+
+def _async_executor() -> Executor:
+    """
+    The executor used by the `batch_search_async` methods when none is given. It has a single worker, as every batch
+    search already runs on its own pool of native threads.
+    """
+    global _ASYNC_EXECUTOR
+    with _ASYNC_EXECUTOR_LOCK:
+        if _ASYNC_EXECUTOR is None:
+            _ASYNC_EXECUTOR = ThreadPoolExecutor(max_workers=1, thread_name_prefix="diskannpy")
+        return _ASYNC_EXECUTOR
+
+
 __MAX_UINT32_VAL = 4_294_967_295
 
 
@@ -3,6 +3,7 @@
 
 import os
 import warnings
+from concurrent.futures import Executor, Future
 from typing import Optional
 
 import numpy as np
@@ -21,8 +22,10 @@ from ._common import (
     _assert_2d,
     _assert_is_nonnegative_uint32,
     _assert_is_positive_uint32,
+    _async_executor,
     _castable_dtype_or_raise,
     _ensure_index_metadata,
+    _valid_batch_outputs,
     _valid_index_prefix,
     _valid_metric,
 )
@@ -153,6 +156,8 @@ class StaticDiskIndex:
         complexity: int,
         num_threads: int,
         beam_width: int = 2,
+        neighbors_out: Optional[np.ndarray] = None,
+        distances_out: Optional[np.ndarray] = None,
     ) -> QueryResponseBatch:
         """
         Searches the index by a batch of query vectors.
@@ -173,6 +178,11 @@ class StaticDiskIndex:
           throughput with a fixed SSD IOps rating, use W=1. For best latency, use W=4,8 or higher complexity search.
           Specifying 0 will optimize the beamwidth depending on the number of threads performing search, but will
           involve some tuning overhead.
+        - **neighbors_out**: Optional preallocated, C-contiguous `numpy.uint32` array of shape
+          (number of queries, k_neighbors) that the identifiers are written into in place. Must be given together with
+          `distances_out`.
+        - **distances_out**: Optional preallocated, C-contiguous `numpy.float32` array of shape
+          (number of queries, k_neighbors) that the distances are written into in place.
         """
         _queries = _castable_dtype_or_raise(queries, expected=self._vector_dtype)
         _assert_2d(_queries, "queries")
@@ -188,6 +198,18 @@ class StaticDiskIndex:
             complexity = k_neighbors
 
         num_queries, dim = _queries.shape
+        if _valid_batch_outputs(neighbors_out, distances_out, num_queries, k_neighbors):
+            self._index.batch_search_into(
+                queries=_queries,
+                num_queries=num_queries,
+                knn=k_neighbors,
+                complexity=complexity,
+                beam_width=beam_width,
+                num_threads=num_threads,
+                neighbors=neighbors_out,
+                distances=distances_out,
+            )
+            return QueryResponseBatch(identifiers=neighbors_out, distances=distances_out)
         neighbors, distances = self._index.batch_search(
             queries=_queries,
             num_queries=num_queries,
@@ -197,3 +219,18 @@ class StaticDiskIndex:
             num_threads=num_threads,
         )
         return QueryResponseBatch(identifiers=neighbors, distances=distances)
+
+    def batch_search_async(
+        self, *args, executor: Optional[Executor] = None, **kwargs
+    ) -> "Future[QueryResponseBatch]":
+        """
+        Runs `batch_search` with the given arguments in the background and returns a `concurrent.futures.Future` of its
+        `QueryResponseBatch`. The native search does not hold the GIL, so other Python threads keep running meanwhile.
+
+        ### Parameters
+        - **executor**: The `concurrent.futures.Executor` to run the search on. Defaults to a shared single-worker
+          thread pool.
+        """
+        return (executor if executor is not None else _async_executor()).submit(
+            self.batch_search, *args, **kwargs
+        )
@@ -4,6 +4,7 @@
 import json
 import os
 import warnings
+from concurrent.futures import Executor, Future
 from typing import Optional
 
 import numpy as np
@@ -21,8 +22,10 @@ from ._common import (
     _assert,
     _assert_is_nonnegative_uint32,
     _assert_is_positive_uint32,
+    _async_executor,
     _castable_dtype_or_raise,
     _ensure_index_metadata,
+    _valid_batch_outputs,
     _valid_index_prefix,
     _valid_metric,
 )
@@ -184,6 +187,8 @@ class StaticMemoryIndex:
         k_neighbors: int,
         complexity: int,
         num_threads: int,
+        neighbors_out: Optional[np.ndarray] = None,
+        distances_out: Optional[np.ndarray] = None,
     ) -> QueryResponseBatch:
         """
         Searches the index by a batch of query vectors.
@@ -198,6 +203,11 @@ class StaticMemoryIndex:
         - **complexity**: Size of distance ordered list of candidate neighbors to use while searching. List size
           increases accuracy at the cost of latency. Must be at least k_neighbors in size.
         - **num_threads**: Number of threads to use when searching this index. (>= 0), 0 = num_threads in system
+        - **neighbors_out**: Optional preallocated, C-contiguous `numpy.uint32` array of shape
+          (number of queries, k_neighbors) that the identifiers are written into in place. Must be given together with
+          `distances_out`.
+        - **distances_out**: Optional preallocated, C-contiguous `numpy.float32` array of shape
+          (number of queries, k_neighbors) that the distances are written into in place.
         """
 
         _queries = _castable_dtype_or_raise(queries, expected=self._vector_dtype)
@@ -218,6 +228,17 @@ class StaticMemoryIndex:
             complexity = k_neighbors
 
         num_queries, dim = _queries.shape
+        if _valid_batch_outputs(neighbors_out, distances_out, num_queries, k_neighbors):
+            self._index.batch_search_into(
+                queries=_queries,
+                num_queries=num_queries,
+                knn=k_neighbors,
+                complexity=complexity,
+                num_threads=num_threads,
+                neighbors=neighbors_out,
+                distances=distances_out,
+            )
+            return QueryResponseBatch(identifiers=neighbors_out, distances=distances_out)
         neighbors, distances = self._index.batch_search(
             queries=_queries,
             num_queries=num_queries,
@@ -226,3 +247,18 @@ class StaticMemoryIndex:
             num_threads=num_threads,
         )
         return QueryResponseBatch(identifiers=neighbors, distances=distances)
+
+    def batch_search_async(
+        self, *args, executor: Optional[Executor] = None, **kwargs
+    ) -> "Future[QueryResponseBatch]":
+        """
+        Runs `batch_search` with the given arguments in the background and returns a `concurrent.futures.Future` of its
+        `QueryResponseBatch`. The native search does not hold the GIL, so other Python threads keep running meanwhile.
+
+        ### Parameters
+        - **executor**: The `concurrent.futures.Executor` to run the search on. Defaults to a shared single-worker
+          thread pool.
+        """
+        return (executor if executor is not None else _async_executor()).submit(
+            self.batch_search, *args, **kwargs
+        )
@@ -85,16 +85,24 @@ py::array_t<int> DynamicMemoryIndex<DT>::batch_insert(
     py::array_t<DynamicIdType, py::array::c_style | py::array::forcecast> &ids, const int32_t num_inserts,
     const int num_threads)
 {
-    if (num_threads == 0)
-        omp_set_num_threads(omp_get_num_procs());
-    else
-        omp_set_num_threads(num_threads);
     py::array_t<int> insert_retvals(num_inserts);
+    const DT *vector_data = vectors.data();
+    const uint64_t dim = vectors.ndim() > 1 ? vectors.shape(1) : vectors.size();
+    const DynamicIdType *id_data = ids.data();
+    int *retval_data = insert_retvals.mutable_data();
 
-#pragma omp parallel for schedule(dynamic, 1) default(none) shared(num_inserts, insert_retvals, vectors, ids)
-    for (int32_t i = 0; i < num_inserts; i++)
     {
-        insert_retvals.mutable_data()[i] = _index.insert_point(vectors.data(i), *(ids.data(i)));
+        py::gil_scoped_release release;
+        if (num_threads == 0)
+            omp_set_num_threads(omp_get_num_procs());
+        else
+            omp_set_num_threads(num_threads);
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(num_inserts, retval_data, vector_data, dim, id_data)
+        for (int32_t i = 0; i < num_inserts; i++)
+        {
+            retval_data[i] = _index.insert_point(vector_data + i * dim, id_data[i]);
+        }
     }
 
     return insert_retvals;
@@ -130,24 +138,39 @@ NeighborsAndDistances<DynamicIdType> DynamicMemoryIndex<DT>::batch_search(
     py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint32_t num_threads)
 {
-    py::array_t<DynamicIdType> ids({num_queries, knn});
-    py::array_t<float> dists({num_queries, knn});
+    py::array_t<DynamicIdType, py::array::c_style> ids({num_queries, knn});
+    py::array_t<float, py::array::c_style> dists({num_queries, knn});
+    batch_search_into(queries, num_queries, knn, complexity, num_threads, ids, dists);
+    return std::make_pair(ids, dists);
+}
+
+template <class DT>
+void DynamicMemoryIndex<DT>::batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries,
+                                               const uint64_t num_queries, const uint64_t knn,
+                                               const uint64_t complexity, const uint32_t num_threads,
+                                               py::array_t<DynamicIdType, py::array::c_style> &ids,
+                                               py::array_t<float, py::array::c_style> &dists)
+{
+    check_batch_outputs(ids, dists, num_queries, knn);
+    const DT *query_data = queries.data();
+    const uint64_t dim = queries.ndim() > 1 ? queries.shape(1) : queries.size();
+    DynamicIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
     std::vector<DT *> empty_vector;
 
+    py::gil_scoped_release release;
     if (num_threads == 0)
         omp_set_num_threads(omp_get_num_procs());
     else
         omp_set_num_threads(static_cast<int32_t>(num_threads));
 
 #pragma omp parallel for schedule(dynamic, 1) default(none)                                                            \
-    shared(num_queries, queries, knn, complexity, ids, dists, empty_vector)
+    shared(num_queries, query_data, dim, knn, complexity, ids_data, dists_data, empty_vector)
     for (int64_t i = 0; i < (int64_t)num_queries; i++)
     {
-        _index.search_with_tags(queries.data(i), knn, complexity, ids.mutable_data(i), dists.mutable_data(i),
+        _index.search_with_tags(query_data + i * dim, knn, complexity, ids_data + i * knn, dists_data + i * knn,
                                 empty_vector);
     }
-
-    return std::make_pair(ids, dists);
 }
 
 template <class DT> void DynamicMemoryIndex<DT>::consolidate_delete()
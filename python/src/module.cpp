@@ -60,7 +60,9 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("search_with_filter", &diskannpy::StaticMemoryIndex<T>::search_with_filter, "query"_a, "knn"_a,
              "complexity"_a, "filter"_a)
         .def("batch_search", &diskannpy::StaticMemoryIndex<T>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
-             "complexity"_a, "num_threads"_a);
+             "complexity"_a, "num_threads"_a)
+        .def("batch_search_into", &diskannpy::StaticMemoryIndex<T>::batch_search_into, "queries"_a, "num_queries"_a,
+             "knn"_a, "complexity"_a, "num_threads"_a, "neighbors"_a.noconvert(), "distances"_a.noconvert());
 
     py::class_<diskannpy::DynamicMemoryIndex<T>>(m, variant.dynamic_memory_index_name.c_str())
         .def(py::init<const diskann::Metric, const size_t, const size_t, const uint32_t, const uint32_t, const bool,
@@ -77,6 +79,8 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("load", &diskannpy::DynamicMemoryIndex<T>::load, "index_path"_a)
         .def("batch_search", &diskannpy::DynamicMemoryIndex<T>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
              "complexity"_a, "num_threads"_a)
+        .def("batch_search_into", &diskannpy::DynamicMemoryIndex<T>::batch_search_into, "queries"_a, "num_queries"_a,
+             "knn"_a, "complexity"_a, "num_threads"_a, "neighbors"_a.noconvert(), "distances"_a.noconvert())
         .def("batch_insert", &diskannpy::DynamicMemoryIndex<T>::batch_insert, "vectors"_a, "ids"_a, "num_inserts"_a,
              "num_threads"_a)
         .def("save", &diskannpy::DynamicMemoryIndex<T>::save, "save_path"_a = "", "compact_before_save"_a = false)
@@ -92,7 +96,10 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("cache_bfs_levels", &diskannpy::StaticDiskIndex<T>::cache_bfs_levels, "num_nodes_to_cache"_a)
         .def("search", &diskannpy::StaticDiskIndex<T>::search, "query"_a, "knn"_a, "complexity"_a, "beam_width"_a)
         .def("batch_search", &diskannpy::StaticDiskIndex<T>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
-             "complexity"_a, "beam_width"_a, "num_threads"_a);
+             "complexity"_a, "beam_width"_a, "num_threads"_a)
+        .def("batch_search_into", &diskannpy::StaticDiskIndex<T>::batch_search_into, "queries"_a, "num_queries"_a,
+             "knn"_a, "complexity"_a, "beam_width"_a, "num_threads"_a, "neighbors"_a.noconvert(),
+             "distances"_a.noconvert());
 }
 
 PYBIND11_MODULE(_diskannpy, m)
@@ -80,27 +80,42 @@ NeighborsAndDistances<StaticIdType> StaticDiskIndex<DT>::batch_search(
     py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint64_t beam_width, const uint32_t num_threads)
 {
-    py::array_t<StaticIdType> ids({num_queries, knn});
-    py::array_t<float> dists({num_queries, knn});
+    py::array_t<StaticIdType, py::array::c_style> ids({num_queries, knn});
+    py::array_t<float, py::array::c_style> dists({num_queries, knn});
+    batch_search_into(queries, num_queries, knn, complexity, beam_width, num_threads, ids, dists);
+    return std::make_pair(ids, dists);
+}
 
-    omp_set_num_threads(num_threads);
+template <typename DT>
+void StaticDiskIndex<DT>::batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries,
+                                            const uint64_t num_queries, const uint64_t knn, const uint64_t complexity,
+                                            const uint64_t beam_width, const uint32_t num_threads,
+                                            py::array_t<StaticIdType, py::array::c_style> &ids,
+                                            py::array_t<float, py::array::c_style> &dists)
+{
+    check_batch_outputs(ids, dists, num_queries, knn);
+    const DT *query_data = queries.data();
+    const uint64_t dim = queries.ndim() > 1 ? queries.shape(1) : queries.size();
+    StaticIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
 
-    std::vector<uint64_t> u64_ids(knn * num_queries);
+    py::gil_scoped_release release;
+    omp_set_num_threads(num_threads);
 
-#pragma omp parallel for schedule(dynamic, 1) default(none)                                                            \
-    shared(num_queries, queries, knn, complexity, u64_ids, dists, beam_width)
-    for (int64_t i = 0; i < (int64_t)num_queries; i++)
+#pragma omp parallel default(none)                                                                                     \
+    shared(num_queries, query_data, dim, knn, complexity, ids_data, dists_data, beam_width)
     {
-        _index.cached_beam_search(queries.data(i), knn, complexity, u64_ids.data() + i * knn, dists.mutable_data(i),
-                                  beam_width);
+        // cached_beam_search reports 64-bit ids; narrow them one query at a time.
+        std::vector<uint64_t> u64_ids(knn);
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t i = 0; i < (int64_t)num_queries; i++)
+        {
+            _index.cached_beam_search(query_data + i * dim, knn, complexity, u64_ids.data(), dists_data + i * knn,
+                                      beam_width);
+            for (uint64_t j = 0; j < knn; ++j)
+                ids_data[i * knn + j] = (StaticIdType)u64_ids[j];
+        }
     }
-
-    auto r = ids.mutable_unchecked();
-    for (uint64_t i = 0; i < num_queries; ++i)
-        for (uint64_t j = 0; j < knn; ++j)
-            r(i, j) = (uint32_t)u64_ids[i * knn + j];
-
-    return std::make_pair(ids, dists);
 }
 
 template class StaticDiskIndex<float>;
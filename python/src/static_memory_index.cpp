@@ -68,20 +68,35 @@ NeighborsAndDistances<StaticIdType> StaticMemoryIndex<DT>::batch_search(
     py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint32_t num_threads)
 {
+    py::array_t<StaticIdType, py::array::c_style> ids({num_queries, knn});
+    py::array_t<float, py::array::c_style> dists({num_queries, knn});
+    batch_search_into(queries, num_queries, knn, complexity, num_threads, ids, dists);
+    return std::make_pair(ids, dists);
+}
+
+template <typename DT>
+void StaticMemoryIndex<DT>::batch_search_into(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries,
+                                              const uint64_t num_queries, const uint64_t knn,
+                                              const uint64_t complexity, const uint32_t num_threads,
+                                              py::array_t<StaticIdType, py::array::c_style> &ids,
+                                              py::array_t<float, py::array::c_style> &dists)
+{
+    check_batch_outputs(ids, dists, num_queries, knn);
     const uint32_t _num_threads = num_threads != 0 ? num_threads : omp_get_num_procs();
-    py::array_t<StaticIdType> ids({num_queries, knn});
-    py::array_t<float> dists({num_queries, knn});
-    std::vector<DT *> empty_vector;
+    const DT *query_data = queries.data();
+    const uint64_t dim = queries.ndim() > 1 ? queries.shape(1) : queries.size();
+    StaticIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
 
+    py::gil_scoped_release release;
     omp_set_num_threads(static_cast<int32_t>(_num_threads));
 
-#pragma omp parallel for schedule(dynamic, 1) default(none) shared(num_queries, queries, knn, complexity, ids, dists)
+#pragma omp parallel for schedule(dynamic, 1) default(none)                                                            \
+    shared(num_queries, query_data, dim, knn, complexity, ids_data, dists_data)
     for (int64_t i = 0; i < (int64_t)num_queries; i++)
     {
-        _index.search(queries.data(i), knn, complexity, ids.mutable_data(i), dists.mutable_data(i));
+        _index.search(query_data + i * dim, knn, complexity, ids_data + i * knn, dists_data + i * knn);
     }
-
-    return std::make_pair(ids, dists);
 }
 
 template class StaticMemoryIndex<float>;
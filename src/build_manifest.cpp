@@ -0,0 +1,225 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include "ann_exception.h"
+#include "build_manifest.h"
+#include "logger.h"
+#include "timer.h"
+#include "utils.h"
+
+namespace diskann
+{
+namespace
+{
+const char *MANIFEST_HEADER = "diskann build manifest v2";
+
+int64_t file_mtime(const std::string &filename)
+{
+    return (int64_t)std::filesystem::last_write_time(filename).time_since_epoch().count();
+}
+} // namespace
+
+BuildManifest::BuildManifest(const std::string &manifest_path, const bool verify)
+    : _manifest_path(manifest_path), _verify(verify)
+{
+    if (enabled() && file_exists(_manifest_path))
+        load();
+}
+
+bool BuildManifest::enabled() const
+{
+    return !_manifest_path.empty();
+}
+
+bool BuildManifest::is_complete(const std::string &stage, const std::string &params) const
+{
+    for (const auto &s : _stages)
+    {
+        if (s.name != stage)
+            continue;
+        if (s.params != params)
+        {
+            diskann::cout << "Build stage " << stage << " was completed with different parameters, rerunning it."
+                          << std::endl;
+            return false;
+        }
+        for (const auto &a : s.artifacts)
+        {
+            if (!file_exists(a.path) || get_file_size(a.path) != a.size || file_mtime(a.path) != a.mtime ||
+                (_verify && a.checksum != 0 && file_checksum(a.path) != a.checksum))
+            {
+                diskann::cout << "Artifact " << a.path << " of build stage " << stage
+                              << " is missing or modified, rerunning the stage." << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void BuildManifest::mark_complete(const std::string &stage, const std::string &params,
+                                  const std::vector<std::string> &artifacts, const std::string &result)
+{
+    if (!enabled())
+        return;
+
+    for (size_t i = 0; i < _stages.size(); i++)
+    {
+        if (_stages[i].name == stage)
+        {
+            _stages.resize(i);
+            break;
+        }
+    }
+
+    Stage s{stage, params, {}, result};
+    for (const auto &path : artifacts)
+    {
+        // optional outputs that the stage did not produce are not tracked
+        if (file_exists(path))
+            s.artifacts.push_back(
+                Artifact{path, get_file_size(path), file_mtime(path), _verify ? file_checksum(path) : 0});
+    }
+    _stages.push_back(s);
+    save();
+}
+
+std::string BuildManifest::result(const std::string &stage) const
+{
+    for (const auto &s : _stages)
+        if (s.name == stage)
+            return s.result;
+    return std::string("");
+}
+
+bool BuildManifest::run_stage(const std::string &stage, const std::string &params,
+                              const std::vector<std::string> &artifacts, const std::function<void()> &build)
+{
+    if (is_complete(stage, params))
+    {
+        diskann::cout << "Skipping build stage " << stage << ", already completed." << std::endl;
+        return false;
+    }
+
+    Timer timer;
+    build();
+    diskann::cout << timer.elapsed_seconds_for_step("build stage " + stage) << std::endl;
+    mark_complete(stage, params, artifacts);
+    return true;
+}
+
+std::string BuildManifest::file_identity(const std::string &filename)
+{
+    return filename + " " + std::to_string(get_file_size(filename)) + " " + std::to_string(file_mtime(filename));
+}
+
+uint64_t BuildManifest::file_checksum(const std::string &filename)
+{
+    const size_t read_blk_size = 64 * 1024 * 1024;
+    std::ifstream reader(filename, std::ios::binary);
+    if (!reader.is_open())
+        throw diskann::ANNException("Failed to open " + filename + " for checksum", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+
+    // 64-bit multiply-xorshift over 8-byte words, with the tail zero padded.
+    // Not cryptographic; only meant to detect truncated or rewritten files.
+    std::unique_ptr<uint64_t[]> buf = std::make_unique<uint64_t[]>(read_blk_size / sizeof(uint64_t));
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (reader)
+    {
+        reader.read((char *)buf.get(), read_blk_size);
+        size_t n_bytes = (size_t)reader.gcount();
+        if (n_bytes == 0)
+            break;
+        size_t n_words = DIV_ROUND_UP(n_bytes, sizeof(uint64_t));
+        if (n_bytes % sizeof(uint64_t) != 0)
+            memset((char *)buf.get() + n_bytes, 0, n_words * sizeof(uint64_t) - n_bytes);
+        for (size_t i = 0; i < n_words; i++)
+        {
+            h ^= buf[i];
+            h *= 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 29;
+        }
+        h ^= n_bytes;
+    }
+    return h;
+}
+
+// Manifest format: a header line, then one stage per line, fields separated
+// by tabs: name, params, number of artifacts, then path, size, mtime and
+// checksum per artifact, then the result if the stage recorded one.
+void BuildManifest::load()
+{
+    std::ifstream reader(_manifest_path);
+    std::string line;
+    if (!std::getline(reader, line) || line != MANIFEST_HEADER)
+    {
+        diskann::cout << "Ignoring build manifest " << _manifest_path << " written by an older version." << std::endl;
+        return;
+    }
+    while (std::getline(reader, line))
+    {
+        if (line.empty())
+            continue;
+        std::vector<std::string> fields;
+        std::stringstream line_stream(line);
+        std::string field;
+        while (std::getline(line_stream, field, '\t'))
+            fields.push_back(field);
+
+        if (fields.size() < 3)
+            throw diskann::ANNException("Malformed build manifest " + _manifest_path, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        Stage s{fields[0], fields[1], {}, std::string("")};
+        size_t num_artifacts = std::stoull(fields[2]);
+        if (fields.size() != 3 + 4 * num_artifacts && fields.size() != 4 + 4 * num_artifacts)
+            throw diskann::ANNException("Malformed build manifest " + _manifest_path, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        for (size_t i = 0; i < num_artifacts; i++)
+        {
+            s.artifacts.push_back(Artifact{fields[3 + 4 * i], std::stoull(fields[4 + 4 * i]),
+                                           std::stoll(fields[5 + 4 * i]), std::stoull(fields[6 + 4 * i])});
+        }
+        if (fields.size() == 4 + 4 * num_artifacts)
+            s.result = fields.back();
+        _stages.push_back(s);
+    }
+    diskann::cout << "Loaded build manifest " << _manifest_path << " with " << _stages.size()
+                  << " completed stages." << std::endl;
+}
+
+void BuildManifest::save() const
+{
+    // write to a temporary file first so a crash never leaves a torn manifest
+    std::string tmp_path = _manifest_path + ".tmp";
+    {
+        std::ofstream writer(tmp_path, std::ios::trunc);
+        writer << MANIFEST_HEADER << '\n';
+        for (const auto &s : _stages)
+        {
+            writer << s.name << '\t' << s.params << '\t' << s.artifacts.size();
+            for (const auto &a : s.artifacts)
+                writer << '\t' << a.path << '\t' << a.size << '\t' << a.mtime << '\t' << a.checksum;
+            if (!s.result.empty())
+                writer << '\t' << s.result;
+            writer << '\n';
+        }
+        if (!writer)
+            throw diskann::ANNException("Failed to write build manifest " + tmp_path, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+    }
+#ifdef _WINDOWS
+    std::remove(_manifest_path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), _manifest_path.c_str()) != 0)
+        throw diskann::ANNException("Failed to rename build manifest to " + _manifest_path, -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+}
+} // namespace diskann
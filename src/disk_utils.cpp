@@ -9,6 +9,7 @@
 
 #include "logger.h"
 #include "disk_utils.h"
+#include "build_manifest.h"
 #include "cached_io.h"
 #include "index.h"
 #include "mkl.h"
@@ -19,6 +20,9 @@
 #include "timer.h"
 #include "tsl/robin_set.h"
 
+#include <future>
+#include <numeric>
+
 namespace diskann
 {
 
@@ -624,14 +628,72 @@ void extract_shard_labels(const std::string &in_label_file, const std::string &s
         delete[] ids;
 }
 
+// builds the Vamana index of shard p of a partitioned build and saves it next to
+// the shard's id file
+template <typename T, typename LabelT>
+void build_shard_index(const std::string &base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R,
+                       size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters,
+                       const std::string &label_file, const std::string &universal_label, const uint32_t Lf,
+                       const std::string &merged_index_prefix, int p)
+{
+#if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
+    MallocExtension::instance()->ReleaseFreeMemory();
+#endif
+
+    std::string shard_base_file = merged_index_prefix + "_subshard-" + std::to_string(p) + ".bin";
+
+    std::string shard_ids_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_ids_uint32.bin";
+
+    std::string shard_labels_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_labels.txt";
+
+    retrieve_shard_data_from_ids<T>(base_file, shard_ids_file, shard_base_file);
+
+    std::string shard_index_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_mem.index";
+
+    diskann::IndexWriteParameters low_degree_params = diskann::IndexWriteParametersBuilder(L, 2 * R / 3)
+                                                          .with_filter_list_size(Lf)
+                                                          .with_saturate_graph(false)
+                                                          .with_num_threads(num_threads)
+                                                          .build();
+
+    uint64_t shard_base_dim, shard_base_pts;
+    get_bin_metadata(shard_base_file, shard_base_pts, shard_base_dim);
+
+    diskann::Index<T> _index(compareMetric, shard_base_dim, shard_base_pts,
+                             std::make_shared<diskann::IndexWriteParameters>(low_degree_params), nullptr,
+                             defaults::NUM_FROZEN_POINTS_STATIC, false, false, false, build_pq_bytes > 0,
+                             build_pq_bytes, use_opq);
+    if (!use_filters)
+    {
+        _index.build(shard_base_file.c_str(), shard_base_pts);
+    }
+    else
+    {
+        diskann::extract_shard_labels(label_file, shard_ids_file, shard_labels_file);
+        if (universal_label != "")
+        { //  indicates no universal label
+            LabelT unv_label_as_num = 0;
+            _index.set_universal_label(unv_label_as_num);
+        }
+        _index.build_filtered_index(shard_base_file.c_str(), shard_labels_file, shard_base_pts);
+    }
+    _index.save(shard_index_file.c_str());
+
+    std::remove(shard_base_file.c_str());
+}
+
 template <typename T, typename LabelT>
 int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R,
                               double sampling_rate, double ram_budget, std::string mem_index_path,
                               std::string medoids_file, std::string centroids_file, size_t build_pq_bytes, bool use_opq,
                               uint32_t num_threads, bool use_filters, const std::string &label_file,
                               const std::string &labels_to_medoids_file, const std::string &universal_label,
-                              const uint32_t Lf)
+                              const uint32_t Lf, BuildManifest *manifest)
 {
+    BuildManifest no_manifest;
+    if (manifest == nullptr)
+        manifest = &no_manifest;
+
     size_t base_num, base_dim;
     diskann::get_bin_metadata(base_file, base_num, base_dim);
 
@@ -687,58 +749,54 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
     std::string merged_index_prefix = mem_index_path + "_tempFiles";
 
     Timer timer;
-    int num_parts =
-        partition_with_ram_budget<T>(base_file, sampling_rate, ram_budget, 2 * R / 3, merged_index_prefix, 2);
-    diskann::cout << timer.elapsed_seconds_for_step("partitioning data ") << std::endl;
+    int num_parts = 0;
+    std::string partition_params = base_file + " " + std::to_string(sampling_rate) + " " + std::to_string(ram_budget) +
+                                   " " + std::to_string(2 * R / 3);
+    if (manifest->is_complete("partition", partition_params) && !manifest->result("partition").empty())
+    {
+        num_parts = std::stoi(manifest->result("partition"));
+        diskann::cout << "Skipping partitioning, reusing " << num_parts << " existing shards." << std::endl;
+    }
+    else
+    {
+        num_parts =
+            partition_with_ram_budget<T>(base_file, sampling_rate, ram_budget, 2 * R / 3, merged_index_prefix, 2);
+        diskann::cout << timer.elapsed_seconds_for_step("partitioning data ") << std::endl;
 
-    std::string cur_centroid_filepath = merged_index_prefix + "_centroids.bin";
-    std::rename(cur_centroid_filepath.c_str(), centroids_file.c_str());
+        std::string cur_centroid_filepath = merged_index_prefix + "_centroids.bin";
+        std::rename(cur_centroid_filepath.c_str(), centroids_file.c_str());
+
+        std::vector<std::string> partition_artifacts{centroids_file};
+        for (int p = 0; p < num_parts; p++)
+            partition_artifacts.push_back(merged_index_prefix + "_subshard-" + std::to_string(p) + "_ids_uint32.bin");
+        manifest->mark_complete("partition", partition_params, partition_artifacts, std::to_string(num_parts));
+    }
 
     timer.reset();
     for (int p = 0; p < num_parts; p++)
     {
-#if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
-        MallocExtension::instance()->ReleaseFreeMemory();
-#endif
-
-        std::string shard_base_file = merged_index_prefix + "_subshard-" + std::to_string(p) + ".bin";
-
         std::string shard_ids_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_ids_uint32.bin";
 
-        std::string shard_labels_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_labels.txt";
-
-        retrieve_shard_data_from_ids<T>(base_file, shard_ids_file, shard_base_file);
-
         std::string shard_index_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_mem.index";
 
-        diskann::IndexWriteParameters low_degree_params = diskann::IndexWriteParametersBuilder(L, 2 * R / 3)
-                                                              .with_filter_list_size(Lf)
-                                                              .with_saturate_graph(false)
-                                                              .with_num_threads(num_threads)
-                                                              .build();
-
-        uint64_t shard_base_dim, shard_base_pts;
-        get_bin_metadata(shard_base_file, shard_base_pts, shard_base_dim);
-
-        diskann::Index<T> _index(compareMetric, shard_base_dim, shard_base_pts,
-                                 std::make_shared<diskann::IndexWriteParameters>(low_degree_params), nullptr,
-                                 defaults::NUM_FROZEN_POINTS_STATIC, false, false, false, build_pq_bytes > 0,
-                                 build_pq_bytes, use_opq);
-        if (!use_filters)
+        std::string shard_stage = "shard-" + std::to_string(p);
+        std::string shard_params = std::to_string(L) + " " + std::to_string(2 * R / 3) + " " + std::to_string(Lf) +
+                                   " " + std::to_string(build_pq_bytes) + " " + std::to_string(use_opq) + " " +
+                                   std::to_string(use_filters) + " " + universal_label;
+        if (manifest->is_complete(shard_stage, shard_params))
         {
-            _index.build(shard_base_file.c_str(), shard_base_pts);
+            diskann::cout << "Skipping build of shard " << p << ", already completed." << std::endl;
         }
         else
         {
-            diskann::extract_shard_labels(label_file, shard_ids_file, shard_labels_file);
-            if (universal_label != "")
-            { //  indicates no universal label
-                LabelT unv_label_as_num = 0;
-                _index.set_universal_label(unv_label_as_num);
-            }
-            _index.build_filtered_index(shard_base_file.c_str(), shard_labels_file, shard_base_pts);
+            build_shard_index<T, LabelT>(base_file, compareMetric, L, R, build_pq_bytes, use_opq, num_threads,
+                                         use_filters, label_file, universal_label, Lf, merged_index_prefix, p);
+            manifest->mark_complete(shard_stage, shard_params,
+                                    {shard_index_file, shard_index_file + "_labels.txt",
+                                     shard_index_file + "_labels_to_medoids.txt",
+                                     shard_index_file + "_universal_label.txt"});
         }
-        _index.save(shard_index_file.c_str());
+
         // copy universal label file from first shard to the final destination
         // index, since all shards anyway share the universal label
         if (p == 0)
@@ -749,8 +807,6 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
                 copy_file(shard_universal_label_file, final_index_universal_label_file);
             }
         }
-
-        std::remove(shard_base_file.c_str());
     }
     diskann::cout << timer.elapsed_seconds_for_step("building indices on shards") << std::endl;
 
@@ -760,6 +816,10 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
                           labels_to_medoids_file);
     diskann::cout << timer.elapsed_seconds_for_step("merging indices") << std::endl;
 
+    // with checkpointing, the shards are kept for a rerun to skip rebuilding
+    if (manifest->enabled())
+        return 0;
+
     // delete tempFiles
     for (int p = 0; p < num_parts; p++)
     {
@@ -843,6 +903,113 @@ uint32_t optimize_beamwidth(std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> &p
     return best_bw;
 }
 
+// Positional writer used by create_disk_layout. Buffers handed to write_at
+// must be aligned to and sized in multiples of defaults::SECTOR_LEN. On Linux
+// the file is opened with O_DIRECT when the file system supports it, so the
+// large layout writes bypass the page cache.
+class sector_file_writer
+{
+  public:
+    sector_file_writer(const std::string &filename) : _filename(filename)
+    {
+#ifdef _WINDOWS
+        _writer.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        try
+        {
+            _writer.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+        }
+        catch (std::system_error &e)
+        {
+            throw diskann::FileException(filename, e, __FUNCSIG__, __FILE__, __LINE__);
+        }
+#else
+        _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (_fd == -1 && errno == EINVAL)
+            _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_fd == -1)
+        {
+            throw diskann::ANNException(std::string("Failed to open ") + filename + " for write: " + strerror(errno),
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+#endif
+    }
+
+    ~sector_file_writer()
+    {
+        close();
+    }
+
+    void write_at(const char *buf, uint64_t n_bytes, uint64_t offset)
+    {
+        assert(n_bytes % defaults::SECTOR_LEN == 0);
+        assert(offset % defaults::SECTOR_LEN == 0);
+#ifdef _WINDOWS
+        _writer.seekp(offset, _writer.beg);
+        _writer.write(buf, n_bytes);
+#else
+        while (n_bytes > 0)
+        {
+            ssize_t ret = ::pwrite(_fd, buf, n_bytes, (off_t)offset);
+            if (ret == -1 && errno == EINVAL && (fcntl(_fd, F_GETFL) & O_DIRECT))
+            {
+                // some file systems accept O_DIRECT at open but reject the
+                // write itself; fall back to buffered writes.
+                fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) & ~O_DIRECT);
+                continue;
+            }
+            if (ret == -1 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+            {
+                throw diskann::ANNException(std::string("Failed to write to ") + _filename + ": " + strerror(errno),
+                                            -1, __FUNCSIG__, __FILE__, __LINE__);
+            }
+            buf += ret;
+            n_bytes -= ret;
+            offset += ret;
+        }
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WINDOWS
+        if (_writer.is_open())
+            _writer.close();
+#else
+        if (_fd != -1)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+#endif
+    }
+
+  private:
+    std::string _filename;
+#ifdef _WINDOWS
+    std::ofstream _writer;
+#else
+    int _fd = -1;
+#endif
+};
+
+// Inputs for one batch of consecutive nodes of create_disk_layout.
+template <typename T> struct disk_layout_batch
+{
+    uint64_t start_id = 0;
+    uint64_t num_nodes = 0;
+    std::unique_ptr<T[]> coords;
+    std::unique_ptr<uint32_t[]> nnbrs;
+    std::unique_ptr<uint32_t[]> nbrs;
+    std::unique_ptr<char[]> reorder_data;
+};
+
+// The layout is produced in batches of consecutive nodes. For each batch a
+// loader thread reads the coordinates, the adjacency lists and, if requested,
+// the reorder vectors of the next batch while OpenMP workers assemble the
+// sectors of the current batch directly into an aligned output buffer, which
+// is then written out asynchronously at its final offset in output_file.
 template <typename T>
 void create_disk_layout(const std::string base_file, const std::string mem_index_file, const std::string output_file,
                         const std::string reorder_data_file)
@@ -892,8 +1059,8 @@ void create_disk_layout(const std::string base_file, const std::string mem_index
     // create cached reader + writer
     size_t actual_file_size = get_file_size(mem_index_file);
     diskann::cout << "Vamana index file size=" << actual_file_size << std::endl;
-    std::ifstream vamana_reader(mem_index_file, std::ios::binary);
-    cached_ofstream diskann_writer(output_file, write_blk_size);
+    cached_ifstream vamana_reader(mem_index_file, read_blk_size);
+    sector_file_writer diskann_writer(output_file);
 
     // metadata: width, medoid
     uint32_t width_u32, medoid_u32;
@@ -927,22 +1094,18 @@ void create_disk_layout(const std::string base_file, const std::string mem_index
     diskann::cout << "max_node_len: " << max_node_len << "B" << std::endl;
     diskann::cout << "nnodes_per_sector: " << nnodes_per_sector << "B" << std::endl;
 
-    // defaults::SECTOR_LEN buffer for each sector
-    std::unique_ptr<char[]> sector_buf = std::make_unique<char[]>(defaults::SECTOR_LEN);
-    std::unique_ptr<char[]> multisector_buf = std::make_unique<char[]>(ROUND_UP(max_node_len, defaults::SECTOR_LEN));
-    std::unique_ptr<char[]> node_buf = std::make_unique<char[]>(max_node_len);
-    uint32_t &nnbrs = *(uint32_t *)(node_buf.get() + ndims_64 * sizeof(T));
-    uint32_t *nhood_buf = (uint32_t *)(node_buf.get() + (ndims_64 * sizeof(T)) + sizeof(uint32_t));
-
     // number of sectors (1 for meta data)
+    uint64_t nsectors_per_node = DIV_ROUND_UP(max_node_len, defaults::SECTOR_LEN);
     uint64_t n_sectors = nnodes_per_sector > 0 ? ROUND_UP(npts_64, nnodes_per_sector) / nnodes_per_sector
-                                               : npts_64 * DIV_ROUND_UP(max_node_len, defaults::SECTOR_LEN);
+                                               : npts_64 * nsectors_per_node;
     uint64_t n_reorder_sectors = 0;
     uint64_t n_data_nodes_per_sector = 0;
+    uint64_t reorder_vec_len = 0;
 
     if (append_reorder_data)
     {
-        n_data_nodes_per_sector = defaults::SECTOR_LEN / (ndims_reorder_file * sizeof(float));
+        reorder_vec_len = ndims_reorder_file * sizeof(float);
+        n_data_nodes_per_sector = defaults::SECTOR_LEN / reorder_vec_len;
         n_reorder_sectors = ROUND_UP(npts_64, n_data_nodes_per_sector) / n_data_nodes_per_sector;
     }
     uint64_t disk_index_file_size = (n_sectors + n_reorder_sectors + 1) * defaults::SECTOR_LEN;
@@ -964,134 +1127,142 @@ void create_disk_layout(const std::string base_file, const std::string mem_index
     }
     output_file_meta.push_back(disk_index_file_size);
 
-    diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
-
-    std::unique_ptr<T[]> cur_node_coords = std::make_unique<T[]>(ndims_64);
     diskann::cout << "# sectors: " << n_sectors << std::endl;
-    uint64_t cur_node_id = 0;
-
-    if (nnodes_per_sector > 0)
-    { // Write multiple nodes per sector
-        for (uint64_t sector = 0; sector < n_sectors; sector++)
-        {
-            if (sector % 100000 == 0)
-            {
-                diskann::cout << "Sector #" << sector << "written" << std::endl;
-            }
-            memset(sector_buf.get(), 0, defaults::SECTOR_LEN);
-            for (uint64_t sector_node_id = 0; sector_node_id < nnodes_per_sector && cur_node_id < npts_64;
-                 sector_node_id++)
-            {
-                memset(node_buf.get(), 0, max_node_len);
-                // read cur node's nnbrs
-                vamana_reader.read((char *)&nnbrs, sizeof(uint32_t));
-
-                // sanity checks on nnbrs
-                assert(nnbrs > 0);
-                assert(nnbrs <= width_u32);
-
-                // read node's nhood
-                vamana_reader.read((char *)nhood_buf, (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
-                if (nnbrs > width_u32)
-                {
-                    vamana_reader.seekg((nnbrs - width_u32) * sizeof(uint32_t), vamana_reader.cur);
-                }
-
-                // write coords of node first
-                //  T *node_coords = data + ((uint64_t) ndims_64 * cur_node_id);
-                base_reader.read((char *)cur_node_coords.get(), sizeof(T) * ndims_64);
-                memcpy(node_buf.get(), cur_node_coords.get(), ndims_64 * sizeof(T));
-
-                // write nnbrs
-                *(uint32_t *)(node_buf.get() + ndims_64 * sizeof(T)) = (std::min)(nnbrs, width_u32);
-
-                // write nhood next
-                memcpy(node_buf.get() + ndims_64 * sizeof(T) + sizeof(uint32_t), nhood_buf,
-                       (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
 
-                // get offset into sector_buf
-                char *sector_node_buf = sector_buf.get() + (sector_node_id * max_node_len);
-
-                // copy node buf into sector_node_buf
-                memcpy(sector_node_buf, node_buf.get(), max_node_len);
-                cur_node_id++;
-            }
-            // flush sector to disk
-            diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
-        }
+    // Batches start on node ids that begin both a graph sector and a reorder
+    // sector, so every batch owns a disjoint, contiguous range of each.
+    uint64_t batch_unit = nnodes_per_sector > 0 ? nnodes_per_sector : 1;
+    if (append_reorder_data)
+        batch_unit = std::lcm(batch_unit, n_data_nodes_per_sector);
+    uint64_t sectors_per_unit =
+        nnodes_per_sector > 0 ? batch_unit / nnodes_per_sector : batch_unit * nsectors_per_node;
+    uint64_t bytes_per_unit = sectors_per_unit * defaults::SECTOR_LEN;
+    uint64_t nodes_per_batch = (std::max)((uint64_t)1, write_blk_size / bytes_per_unit) * batch_unit;
+    nodes_per_batch = (std::min)(nodes_per_batch, ROUND_UP(npts_64, batch_unit));
+    uint64_t num_batches = DIV_ROUND_UP(npts_64, nodes_per_batch);
+
+    auto batch_sectors = [&](uint64_t num_nodes) {
+        return nnodes_per_sector > 0 ? DIV_ROUND_UP(num_nodes, nnodes_per_sector) : num_nodes * nsectors_per_node;
+    };
+    auto batch_reorder_sectors = [&](uint64_t num_nodes) {
+        return append_reorder_data ? DIV_ROUND_UP(num_nodes, n_data_nodes_per_sector) : 0;
+    };
+    uint64_t max_batch_bytes =
+        (batch_sectors(nodes_per_batch) + batch_reorder_sectors(nodes_per_batch)) * defaults::SECTOR_LEN;
+
+    disk_layout_batch<T> batches[2];
+    std::unique_ptr<char, void (*)(void *)> out_bufs[2] = {{nullptr, aligned_free}, {nullptr, aligned_free}};
+    for (uint32_t b = 0; b < 2; b++)
+    {
+        batches[b].coords = std::make_unique<T[]>(nodes_per_batch * ndims_64);
+        batches[b].nnbrs = std::make_unique<uint32_t[]>(nodes_per_batch);
+        batches[b].nbrs = std::make_unique<uint32_t[]>(nodes_per_batch * width_u32);
+        if (append_reorder_data)
+            batches[b].reorder_data = std::make_unique<char[]>(nodes_per_batch * reorder_vec_len);
+        char *out_buf = nullptr;
+        alloc_aligned((void **)&out_buf, max_batch_bytes, defaults::SECTOR_LEN);
+        out_bufs[b].reset(out_buf);
     }
-    else
-    { // Write multi-sector nodes
-        uint64_t nsectors_per_node = DIV_ROUND_UP(max_node_len, defaults::SECTOR_LEN);
-        for (uint64_t i = 0; i < npts_64; i++)
-        {
-            if ((i * nsectors_per_node) % 100000 == 0)
-            {
-                diskann::cout << "Sector #" << i * nsectors_per_node << "written" << std::endl;
-            }
-            memset(multisector_buf.get(), 0, nsectors_per_node * defaults::SECTOR_LEN);
 
-            memset(node_buf.get(), 0, max_node_len);
-            // read cur node's nnbrs
+    // the reader side is inherently sequential: adjacency lists are variable
+    // length, so each list must be parsed to find the next one.
+    std::vector<uint32_t> excess_nbrs;
+    auto load_batch = [&](uint64_t batch, disk_layout_batch<T> &cur) {
+        cur.start_id = batch * nodes_per_batch;
+        cur.num_nodes = (std::min)(nodes_per_batch, npts_64 - cur.start_id);
+        base_reader.read((char *)cur.coords.get(), cur.num_nodes * ndims_64 * sizeof(T));
+        for (uint64_t i = 0; i < cur.num_nodes; i++)
+        {
+            uint32_t nnbrs;
             vamana_reader.read((char *)&nnbrs, sizeof(uint32_t));
 
             // sanity checks on nnbrs
             assert(nnbrs > 0);
             assert(nnbrs <= width_u32);
 
-            // read node's nhood
-            vamana_reader.read((char *)nhood_buf, (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
+            uint32_t nnbrs_kept = (std::min)(nnbrs, width_u32);
+            vamana_reader.read((char *)(cur.nbrs.get() + i * width_u32), nnbrs_kept * sizeof(uint32_t));
             if (nnbrs > width_u32)
             {
-                vamana_reader.seekg((nnbrs - width_u32) * sizeof(uint32_t), vamana_reader.cur);
+                excess_nbrs.resize(nnbrs - width_u32);
+                vamana_reader.read((char *)excess_nbrs.data(), (nnbrs - width_u32) * sizeof(uint32_t));
             }
+            cur.nnbrs[i] = nnbrs_kept;
+        }
+        if (append_reorder_data)
+            reorder_data_reader.read(cur.reorder_data.get(), cur.num_nodes * reorder_vec_len);
+    };
 
-            // write coords of node first
-            //  T *node_coords = data + ((uint64_t) ndims_64 * cur_node_id);
-            base_reader.read((char *)cur_node_coords.get(), sizeof(T) * ndims_64);
-            memcpy(multisector_buf.get(), cur_node_coords.get(), ndims_64 * sizeof(T));
-
-            // write nnbrs
-            *(uint32_t *)(multisector_buf.get() + ndims_64 * sizeof(T)) = (std::min)(nnbrs, width_u32);
-
-            // write nhood next
-            memcpy(multisector_buf.get() + ndims_64 * sizeof(T) + sizeof(uint32_t), nhood_buf,
-                   (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
+    // metadata sector is filled in by save_bin once the layout is complete
+    memset(out_bufs[0].get(), 0, defaults::SECTOR_LEN);
+    diskann_writer.write_at(out_bufs[0].get(), defaults::SECTOR_LEN, 0);
 
-            // flush sector to disk
-            diskann_writer.write(multisector_buf.get(), nsectors_per_node * defaults::SECTOR_LEN);
-        }
-    }
+    std::future<void> load_task = std::async(std::launch::async, load_batch, 0, std::ref(batches[0]));
+    std::future<void> write_task;
 
-    if (append_reorder_data)
+    for (uint64_t batch = 0; batch < num_batches; batch++)
     {
-        diskann::cout << "Index written. Appending reorder data..." << std::endl;
+        load_task.get();
+        disk_layout_batch<T> &cur = batches[batch % 2];
+        if (batch + 1 < num_batches)
+            load_task = std::async(std::launch::async, load_batch, batch + 1, std::ref(batches[(batch + 1) % 2]));
+
+        uint64_t cur_sectors = batch_sectors(cur.num_nodes);
+        uint64_t cur_reorder_sectors = batch_reorder_sectors(cur.num_nodes);
+        uint64_t first_sector = 1 + batch_sectors(cur.start_id);
+        char *out_buf = out_bufs[batch % 2].get();
 
-        auto vec_len = ndims_reorder_file * sizeof(float);
-        std::unique_ptr<char[]> vec_buf = std::make_unique<char[]>(vec_len);
+        if (batch % DIV_ROUND_UP(num_batches, 10) == 0)
+        {
+            diskann::cout << "Sector #" << first_sector - 1 << " of " << n_sectors << " being written" << std::endl;
+        }
 
-        for (uint64_t sector = 0; sector < n_reorder_sectors; sector++)
+        // each node is written straight to its final place in the sector
+        // buffer; sectors are disjoint, so workers need no synchronization.
+        // A batch of high-dimensional points holds few nodes, so the chunks
+        // are sized to give every thread several of them.
+        memset(out_buf, 0, (cur_sectors + cur_reorder_sectors) * defaults::SECTOR_LEN);
+        const int64_t chunk = (std::max)((int64_t)1, (int64_t)cur.num_nodes / (4 * omp_get_max_threads()));
+#pragma omp parallel for schedule(dynamic, chunk)
+        for (int64_t i = 0; i < (int64_t)cur.num_nodes; i++)
         {
-            if (sector % 100000 == 0)
+            char *node_buf = nnodes_per_sector > 0
+                                 ? out_buf + (i / nnodes_per_sector) * defaults::SECTOR_LEN +
+                                       (i % nnodes_per_sector) * max_node_len
+                                 : out_buf + i * nsectors_per_node * defaults::SECTOR_LEN;
+
+            // coords of node first, then nnbrs, then nhood
+            memcpy(node_buf, cur.coords.get() + i * ndims_64, ndims_64 * sizeof(T));
+            *(uint32_t *)(node_buf + ndims_64 * sizeof(T)) = cur.nnbrs[i];
+            memcpy(node_buf + ndims_64 * sizeof(T) + sizeof(uint32_t), cur.nbrs.get() + i * width_u32,
+                   cur.nnbrs[i] * sizeof(uint32_t));
+
+            if (append_reorder_data)
             {
-                diskann::cout << "Reorder data Sector #" << sector << "written" << std::endl;
+                char *reorder_buf = out_buf + (cur_sectors + i / n_data_nodes_per_sector) * defaults::SECTOR_LEN +
+                                    (i % n_data_nodes_per_sector) * reorder_vec_len;
+                memcpy(reorder_buf, cur.reorder_data.get() + i * reorder_vec_len, reorder_vec_len);
             }
+        }
 
-            memset(sector_buf.get(), 0, defaults::SECTOR_LEN);
-
-            for (uint64_t sector_node_id = 0; sector_node_id < n_data_nodes_per_sector && sector_node_id < npts_64;
-                 sector_node_id++)
+        // at most one write is in flight, and it targets the other buffer.
+        if (write_task.valid())
+            write_task.get();
+        write_task = std::async(std::launch::async, [&, out_buf, cur_sectors, cur_reorder_sectors, first_sector,
+                                                     start_id = cur.start_id]() {
+            diskann_writer.write_at(out_buf, cur_sectors * defaults::SECTOR_LEN, first_sector * defaults::SECTOR_LEN);
+            if (cur_reorder_sectors > 0)
             {
-                memset(vec_buf.get(), 0, vec_len);
-                reorder_data_reader.read(vec_buf.get(), vec_len);
-
-                // copy node buf into sector_node_buf
-                memcpy(sector_buf.get() + (sector_node_id * vec_len), vec_buf.get(), vec_len);
+                uint64_t first_reorder_sector = n_sectors + 1 + start_id / n_data_nodes_per_sector;
+                diskann_writer.write_at(out_buf + cur_sectors * defaults::SECTOR_LEN,
+                                        cur_reorder_sectors * defaults::SECTOR_LEN,
+                                        first_reorder_sector * defaults::SECTOR_LEN);
             }
-            // flush sector to disk
-            diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
-        }
+        });
     }
+    if (write_task.valid())
+        write_task.get();
+
     diskann_writer.close();
     diskann::save_bin<uint64_t>(output_file, output_file_meta.data(), output_file_meta.size(), 1, 0);
     diskann::cout << "Output disk index file written to " << output_file << std::endl;
@@ -1101,7 +1272,7 @@ template <typename T, typename LabelT>
 int build_disk_index(const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
                      diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
                      const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
-                     const uint32_t Lf)
+                     const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint)
 {
     std::stringstream parser;
     parser << std::string(indexBuildParameters);
@@ -1201,6 +1372,16 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
         "_prepped_base.bin"; // temp file for storing pre-processed base file for cosine/ mips metrics
     bool created_temp_file_for_processed_data = false;
 
+    // With checkpointing, every stage below records its outputs in the
+    // manifest and is skipped on a rerun if they are still valid. Stage
+    // parameters only cover what affects the stage's own output; changes
+    // upstream invalidate it through the manifest's stage order.
+    BuildManifest manifest(checkpoint ? index_prefix_path + "_build_manifest.txt" : std::string(""),
+                           verify_checkpoint);
+    // No stage tracks the base file as an artifact, so its identity is the
+    // first stage: replacing the file drops the records of every later stage.
+    manifest.run_stage("input", BuildManifest::file_identity(base_file), {}, []() {});
+
     // output a new base file which contains extra dimension with sqrt(1 -
     // ||x||^2/M^2) for every x, M is max norm of all points. Extra space on
     // disk needed!
@@ -1213,9 +1394,11 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
                      "apart from the interim indices created by DiskANN and the final index."
                   << std::endl;
         data_file_to_use = prepped_base;
-        float max_norm_of_base = diskann::prepare_base_for_inner_products<T>(base_file, prepped_base);
         std::string norm_file = disk_index_path + "_max_base_norm.bin";
-        diskann::save_bin<float>(norm_file, &max_norm_of_base, 1, 1);
+        manifest.run_stage("preprocess", "mips", {prepped_base, norm_file}, [&]() {
+            float max_norm_of_base = diskann::prepare_base_for_inner_products<T>(base_file, prepped_base);
+            diskann::save_bin<float>(norm_file, &max_norm_of_base, 1, 1);
+        });
         diskann::cout << timer.elapsed_seconds_for_step("preprocessing data for inner product") << std::endl;
         created_temp_file_for_processed_data = true;
     }
@@ -1227,7 +1410,8 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
                      "apart from the interim indices created by DiskANN and the final index."
                   << std::endl;
         data_file_to_use = prepped_base;
-        diskann::normalize_data_file(base_file, prepped_base);
+        manifest.run_stage("preprocess", "cosine", {prepped_base},
+                           [&]() { diskann::normalize_data_file(base_file, prepped_base); });
         diskann::cout << timer.elapsed_seconds_for_step("preprocessing data for cosine") << std::endl;
         created_temp_file_for_processed_data = true;
     }
@@ -1268,17 +1452,30 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     std::string augmented_data_file, augmented_labels_file;
     if (use_filters)
     {
-        convert_labels_string_to_int(labels_file_original, labels_file_to_use, disk_labels_int_map_file,
-                                     universal_label);
         augmented_data_file = index_prefix_path + "_augmented_data.bin";
         augmented_labels_file = index_prefix_path + "_augmented_labels.txt";
         if (filter_threshold != 0)
-        {
             dummy_remap_file = index_prefix_path + "_dummy_remap.txt";
-            breakup_dense_points<T>(data_file_to_use, labels_file_to_use, filter_threshold, augmented_data_file,
-                                    augmented_labels_file,
-                                    dummy_remap_file); // RKNOTE: This has large memory footprint,
-                                                       // need to make this streaming
+
+        std::string labels_params = BuildManifest::file_identity(labels_file_original) + " " + universal_label + " " +
+                                    std::to_string(filter_threshold);
+        std::vector<std::string> labels_artifacts{labels_file_to_use, disk_labels_int_map_file};
+        if (filter_threshold != 0)
+            labels_artifacts.insert(labels_artifacts.end(),
+                                    {augmented_data_file, augmented_labels_file, dummy_remap_file});
+        manifest.run_stage("labels", labels_params, labels_artifacts, [&]() {
+            convert_labels_string_to_int(labels_file_original, labels_file_to_use, disk_labels_int_map_file,
+                                         universal_label);
+            if (filter_threshold != 0)
+            {
+                breakup_dense_points<T>(data_file_to_use, labels_file_to_use, filter_threshold, augmented_data_file,
+                                        augmented_labels_file,
+                                        dummy_remap_file); // RKNOTE: This has large memory footprint,
+                                                           // need to make this streaming
+            }
+        });
+        if (filter_threshold != 0)
+        {
             data_file_to_use = augmented_data_file;
             labels_file_to_use = augmented_labels_file;
         }
@@ -1292,8 +1489,12 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
 
     if (use_disk_pq)
     {
-        generate_disk_quantized_data<T>(data_file_to_use, disk_pq_pivots_path, disk_pq_compressed_vectors_path,
-                                        compareMetric, p_val, disk_pq_dims);
+        std::string disk_pq_params =
+            data_file_to_use + " " + std::to_string(disk_pq_dims) + " " + std::to_string((int)compareMetric);
+        manifest.run_stage("disk_pq", disk_pq_params, {disk_pq_pivots_path, disk_pq_compressed_vectors_path}, [&]() {
+            generate_disk_quantized_data<T>(data_file_to_use, disk_pq_pivots_path, disk_pq_compressed_vectors_path,
+                                            compareMetric, p_val, disk_pq_dims);
+        });
     }
     size_t num_pq_chunks = (size_t)(std::floor)(uint64_t(final_index_ram_limit / points_num));
 
@@ -1312,8 +1513,13 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     diskann::cout << "Compressing " << dim << "-dimensional data into " << num_pq_chunks << " bytes per vector."
                   << std::endl;
 
-    generate_quantized_data<T>(data_file_to_use, pq_pivots_path, pq_compressed_vectors_path, compareMetric, p_val,
-                               num_pq_chunks, use_opq, codebook_prefix);
+    std::string pq_params = data_file_to_use + " " + std::to_string(num_pq_chunks) + " " +
+                            std::to_string((int)compareMetric) + " " + std::to_string(use_opq) + " " + codebook_prefix;
+    manifest.run_stage("pq", pq_params,
+                       {pq_pivots_path, pq_pivots_path + "_rotation_matrix.bin", pq_compressed_vectors_path}, [&]() {
+                           generate_quantized_data<T>(data_file_to_use, pq_pivots_path, pq_compressed_vectors_path,
+                                                      compareMetric, p_val, num_pq_chunks, use_opq, codebook_prefix);
+                       });
     diskann::cout << timer.elapsed_seconds_for_step("generating quantized data") << std::endl;
 
 // Gopal. Splitting diskann_dll into separate DLLs for search and build.
@@ -1323,50 +1529,76 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
 #endif
     // Whether it is cosine or inner product, we still L2 metric due to the pre-processing.
     timer.reset();
-    diskann::build_merged_vamana_index<T, LabelT>(data_file_to_use.c_str(), diskann::Metric::L2, L, R, p_val,
-                                                  indexing_ram_budget, mem_index_path, medoids_path, centroids_path,
-                                                  build_pq_bytes, use_opq, num_threads, use_filters, labels_file_to_use,
-                                                  labels_to_medoids_path, universal_label, Lf);
+    std::string vamana_params = data_file_to_use + " " + std::to_string(R) + " " + std::to_string(L) + " " +
+                                std::to_string(Lf) + " " + std::to_string(indexing_ram_budget) + " " +
+                                std::to_string(build_pq_bytes) + " " + std::to_string(use_opq) + " " +
+                                std::to_string(use_filters) + " " + universal_label;
+    manifest.run_stage("vamana", vamana_params,
+                       {mem_index_path, medoids_path, centroids_path, labels_to_medoids_path, mem_labels_file,
+                        mem_univ_label_file},
+                       [&]() {
+                           diskann::build_merged_vamana_index<T, LabelT>(
+                               data_file_to_use.c_str(), diskann::Metric::L2, L, R, p_val, indexing_ram_budget,
+                               mem_index_path, medoids_path, centroids_path, build_pq_bytes, use_opq, num_threads,
+                               use_filters, labels_file_to_use, labels_to_medoids_path, universal_label, Lf,
+                               &manifest);
+                       });
     diskann::cout << timer.elapsed_seconds_for_step("building merged vamana index") << std::endl;
 
     timer.reset();
-    if (!use_disk_pq)
-    {
-        diskann::create_disk_layout<T>(data_file_to_use.c_str(), mem_index_path, disk_index_path);
-    }
-    else
-    {
-        if (!reorder_data)
-            diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path);
+    std::string layout_params =
+        data_file_to_use + " " + std::to_string(use_disk_pq) + " " + std::to_string(reorder_data);
+    manifest.run_stage("disk_layout", layout_params, {disk_index_path}, [&]() {
+        if (!use_disk_pq)
+        {
+            diskann::create_disk_layout<T>(data_file_to_use.c_str(), mem_index_path, disk_index_path);
+        }
         else
-            diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path,
-                                                 data_file_to_use.c_str());
-    }
+        {
+            if (!reorder_data)
+                diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path);
+            else
+                diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path,
+                                                     data_file_to_use.c_str());
+        }
+    });
     diskann::cout << timer.elapsed_seconds_for_step("generating disk layout") << std::endl;
 
     double ten_percent_points = std::ceil(points_num * 0.1);
     double num_sample_points =
         ten_percent_points > MAX_SAMPLE_POINTS_FOR_WARMUP ? MAX_SAMPLE_POINTS_FOR_WARMUP : ten_percent_points;
     double sample_sampling_rate = num_sample_points / points_num;
-    gen_random_slice<T>(data_file_to_use.c_str(), sample_base_prefix, sample_sampling_rate);
+    manifest.run_stage("sample", data_file_to_use + " " + std::to_string(sample_sampling_rate),
+                       {sample_base_prefix + "_data.bin", sample_base_prefix + "_ids.bin"}, [&]() {
+                           gen_random_slice<T>(data_file_to_use.c_str(), sample_base_prefix, sample_sampling_rate);
+                       });
+
     if (use_filters)
     {
         copy_file(labels_file_to_use, disk_labels_file);
-        std::remove(mem_labels_file.c_str());
         if (universal_label != "")
-        {
             copy_file(mem_univ_label_file, disk_univ_label_file);
-            std::remove(mem_univ_label_file.c_str());
+    }
+
+    // with checkpointing, intermediates are kept since they are what a rerun
+    // or a parameter sweep reuses
+    if (!checkpoint)
+    {
+        if (use_filters)
+        {
+            std::remove(mem_labels_file.c_str());
+            if (universal_label != "")
+                std::remove(mem_univ_label_file.c_str());
+            std::remove(augmented_data_file.c_str());
+            std::remove(augmented_labels_file.c_str());
+            std::remove(labels_file_to_use.c_str());
         }
-        std::remove(augmented_data_file.c_str());
-        std::remove(augmented_labels_file.c_str());
-        std::remove(labels_file_to_use.c_str());
+        if (created_temp_file_for_processed_data)
+            std::remove(prepped_base.c_str());
+        std::remove(mem_index_path.c_str());
+        if (use_disk_pq)
+            std::remove(disk_pq_compressed_vectors_path.c_str());
     }
-    if (created_temp_file_for_processed_data)
-        std::remove(prepped_base.c_str());
-    std::remove(mem_index_path.c_str());
-    if (use_disk_pq)
-        std::remove(disk_pq_compressed_vectors_path.c_str());
 
     auto e = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = e - s;
@@ -1426,79 +1658,73 @@ template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<float, uint16_t>(
     std::unique_ptr<diskann::PQFlashIndex<float, uint16_t>> &pFlashIndex, float *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
 
-template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint32_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                  const char *indexBuildParameters,
-                                                                  diskann::Metric compareMetric, bool use_opq,
-                                                                  const std::string &codebook_prefix, bool use_filters,
-                                                                  const std::string &label_file,
-                                                                  const std::string &universal_label,
-                                                                  const uint32_t filter_threshold, const uint32_t Lf);
-template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint32_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                   const char *indexBuildParameters,
-                                                                   diskann::Metric compareMetric, bool use_opq,
-                                                                   const std::string &codebook_prefix, bool use_filters,
-                                                                   const std::string &label_file,
-                                                                   const std::string &universal_label,
-                                                                   const uint32_t filter_threshold, const uint32_t Lf);
-template DISKANN_DLLEXPORT int build_disk_index<float, uint32_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                 const char *indexBuildParameters,
-                                                                 diskann::Metric compareMetric, bool use_opq,
-                                                                 const std::string &codebook_prefix, bool use_filters,
-                                                                 const std::string &label_file,
-                                                                 const std::string &universal_label,
-                                                                 const uint32_t filter_threshold, const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint32_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
+template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint32_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
+template DISKANN_DLLEXPORT int build_disk_index<float, uint32_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
 // LabelT = uint16
-template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint16_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                  const char *indexBuildParameters,
-                                                                  diskann::Metric compareMetric, bool use_opq,
-                                                                  const std::string &codebook_prefix, bool use_filters,
-                                                                  const std::string &label_file,
-                                                                  const std::string &universal_label,
-                                                                  const uint32_t filter_threshold, const uint32_t Lf);
-template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint16_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                   const char *indexBuildParameters,
-                                                                   diskann::Metric compareMetric, bool use_opq,
-                                                                   const std::string &codebook_prefix, bool use_filters,
-                                                                   const std::string &label_file,
-                                                                   const std::string &universal_label,
-                                                                   const uint32_t filter_threshold, const uint32_t Lf);
-template DISKANN_DLLEXPORT int build_disk_index<float, uint16_t>(const char *dataFilePath, const char *indexFilePath,
-                                                                 const char *indexBuildParameters,
-                                                                 diskann::Metric compareMetric, bool use_opq,
-                                                                 const std::string &codebook_prefix, bool use_filters,
-                                                                 const std::string &label_file,
-                                                                 const std::string &universal_label,
-                                                                 const uint32_t filter_threshold, const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint16_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
+template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint16_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
+template DISKANN_DLLEXPORT int build_disk_index<float, uint16_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool checkpoint, const bool verify_checkpoint);
 
 template DISKANN_DLLEXPORT int build_merged_vamana_index<int8_t, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<float, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<uint8_t, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 // Label=16_t
 template DISKANN_DLLEXPORT int build_merged_vamana_index<int8_t, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<float, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<uint8_t, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    BuildManifest *manifest);
 }; // namespace diskann
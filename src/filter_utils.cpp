@@ -1,9 +1,11 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <functional>
 #include <random>
 #include <string>
 #include <tuple>
@@ -20,6 +22,11 @@ namespace diskann
  * Using passed in parameters and files generated from step 3,
  * builds a vanilla diskANN index for each label.
  *
+ * Labels are built largest first. A label holding at least 1/num_threads of
+ * all label points is built on its own with every thread; the rest are built
+ * concurrently, one thread each, which keeps all threads busy when there are
+ * many small labels.
+ *
  * Each index is saved under the following path:
  *  final_index_path_prefix + "_" + label
  */
@@ -27,44 +34,73 @@ template <typename T>
 void generate_label_indices(path input_data_path, path final_index_path_prefix, label_set all_labels, uint32_t R,
                             uint32_t L, float alpha, uint32_t num_threads)
 {
-    diskann::IndexWriteParameters label_index_build_parameters = diskann::IndexWriteParametersBuilder(L, R)
-                                                                     .with_saturate_graph(false)
-                                                                     .with_alpha(alpha)
-                                                                     .with_num_threads(num_threads)
-                                                                     .build();
+    if (num_threads == 0)
+        num_threads = omp_get_num_procs();
+    auto build_parameters = [&](uint32_t threads) {
+        return std::make_shared<diskann::IndexWriteParameters>(diskann::IndexWriteParametersBuilder(L, R)
+                                                                   .with_saturate_graph(false)
+                                                                   .with_alpha(alpha)
+                                                                   .with_num_threads(threads)
+                                                                   .build());
+    };
+    const auto parallel_build_parameters = build_parameters(num_threads);
+    const auto single_thread_build_parameters = build_parameters(1);
+
+    std::vector<std::pair<size_t, std::string>> labels_by_size;
+    size_t total_label_points = 0;
+    for (const auto &lbl : all_labels)
+    {
+        size_t number_of_label_points, dimension;
+        diskann::get_bin_metadata(input_data_path + "_" + lbl, number_of_label_points, dimension);
+        labels_by_size.emplace_back(number_of_label_points, lbl);
+        total_label_points += number_of_label_points;
+    }
+    std::sort(labels_by_size.begin(), labels_by_size.end(), std::greater<std::pair<size_t, std::string>>());
 
     std::cout << "Generating indices per label..." << std::endl;
-    // for each label, build an index on resp. points
-    double total_indexing_time = 0.0, indexing_percentage = 0.0;
+    double indexing_percentage = 0.0;
     std::cout.setstate(std::ios_base::failbit);
     diskann::cout.setstate(std::ios_base::failbit);
-    for (const auto &lbl : all_labels)
-    {
+    auto build_label_index = [&](const std::string &lbl,
+                                 const std::shared_ptr<diskann::IndexWriteParameters> &parameters) {
         path curr_label_input_data_path(input_data_path + "_" + lbl);
         path curr_label_index_path(final_index_path_prefix + "_" + lbl);
 
         size_t number_of_label_points, dimension;
         diskann::get_bin_metadata(curr_label_input_data_path, number_of_label_points, dimension);
 
-        diskann::Index<T> index(diskann::Metric::L2, dimension, number_of_label_points,
-                                std::make_shared<diskann::IndexWriteParameters>(label_index_build_parameters), nullptr,
-                                0, false, false, false, false, 0, false);
-
-        auto index_build_timer = std::chrono::high_resolution_clock::now();
+        diskann::Index<T> index(diskann::Metric::L2, dimension, number_of_label_points, parameters, nullptr, 0, false,
+                                false, false, false, 0, false);
         index.build(curr_label_input_data_path.c_str(), number_of_label_points);
-        std::chrono::duration<double> current_indexing_time =
-            std::chrono::high_resolution_clock::now() - index_build_timer;
+        index.save(curr_label_index_path.c_str());
 
-        total_indexing_time += current_indexing_time.count();
-        indexing_percentage += (1 / (double)all_labels.size());
-        print_progress(indexing_percentage);
+#pragma omp critical
+        {
+            indexing_percentage += (1 / (double)labels_by_size.size());
+            print_progress(indexing_percentage);
+        }
+    };
 
-        index.save(curr_label_index_path.c_str());
+    auto indexing_timer = std::chrono::high_resolution_clock::now();
+    size_t num_large_labels = 0;
+    while (num_large_labels < labels_by_size.size() &&
+           labels_by_size[num_large_labels].first * num_threads >= total_label_points)
+    {
+        build_label_index(labels_by_size[num_large_labels].second, parallel_build_parameters);
+        num_large_labels++;
     }
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t i = (int64_t)num_large_labels; i < (int64_t)labels_by_size.size(); i++)
+        build_label_index(labels_by_size[i].second, single_thread_build_parameters);
+
+    std::chrono::duration<double> total_indexing_time = std::chrono::high_resolution_clock::now() - indexing_timer;
     std::cout.clear();
     diskann::cout.clear();
 
-    std::cout << "\nDone. Generated per-label indices in " << total_indexing_time << " seconds\n" << std::endl;
+    std::cout << "\nDone. Generated per-label indices in " << total_indexing_time.count() << " seconds ("
+              << num_large_labels << " large label(s) built with " << num_threads << " threads)\n"
+              << std::endl;
 }
 
 // for use on systems without writev (i.e. Windows)
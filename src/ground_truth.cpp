@@ -0,0 +1,309 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include <mkl.h>
+#include <omp.h>
+
+#include "ground_truth.h"
+#include "logger.h"
+#include "utils.h"
+
+namespace diskann
+{
+namespace
+{
+// Max-heap on (distance, id), so the front is the candidate to evict. Ties go
+// to the smaller id, which makes the output independent of the block size.
+using GroundTruthHeap = std::vector<std::pair<float, uint32_t>>;
+
+inline void heap_insert(GroundTruthHeap &heap, const uint32_t K, const float dist, const uint32_t id)
+{
+    if (heap.size() < K)
+    {
+        heap.emplace_back(dist, id);
+        std::push_heap(heap.begin(), heap.end());
+    }
+    else if (std::make_pair(dist, id) < heap.front())
+    {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = std::make_pair(dist, id);
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+inline bool heap_admits(const GroundTruthHeap &heap, const uint32_t K, const float dist)
+{
+    return heap.size() < K || dist <= heap.front().first;
+}
+
+inline bool labels_match(const std::vector<uint32_t> &point_labels, const uint32_t query_label,
+                         const GroundTruthLabels &labels)
+{
+    for (const auto label : point_labels)
+        if (label == query_label || (labels.use_universal_label && label == labels.universal_label))
+            return true;
+    return false;
+}
+
+// Squared norms of n rows; normalizes the rows first for cosine, which is
+// computed as L2 between unit vectors.
+void prepare_rows(float *rows, float *norms, const size_t n, const size_t dim, const Metric metric)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float *row = rows + i * dim;
+        float norm = 0;
+        for (size_t d = 0; d < dim; d++)
+            norm += row[d] * row[d];
+        if (metric == Metric::COSINE)
+        {
+            float scale = norm == 0 ? 1 / std::numeric_limits<float>::epsilon() : 1 / std::sqrt(norm);
+            for (size_t d = 0; d < dim; d++)
+                row[d] *= scale;
+            norm = norm == 0 ? 0 : 1;
+        }
+        norms[i] = norm;
+    }
+}
+
+// Sorts a heap nearest first and writes it out as K entries, padding with
+// UINT32_MAX / FLT_MAX and mapping locations to tags.
+void write_heap(GroundTruthHeap &heap, const uint32_t K, const Metric metric,
+                const std::vector<uint32_t> *location_to_tag, uint32_t *ids, float *distances)
+{
+    std::sort_heap(heap.begin(), heap.end());
+    for (uint32_t j = 0; j < K; j++)
+    {
+        if (j < heap.size())
+        {
+            ids[j] = location_to_tag != nullptr ? (*location_to_tag)[heap[j].second] : heap[j].second;
+            distances[j] = metric == Metric::INNER_PRODUCT ? -heap[j].first : heap[j].first;
+        }
+        else
+        {
+            ids[j] = std::numeric_limits<uint32_t>::max();
+            distances[j] = FLT_MAX;
+        }
+    }
+}
+} // namespace
+
+template <typename T>
+void compute_ground_truth(const std::string &base_file, const float *queries, const size_t num_queries,
+                          const size_t dim, const GroundTruthParameters &params, GroundTruthResult &result,
+                          const GroundTruthLabels *labels, const std::vector<uint32_t> *location_to_tag)
+{
+    if (params.block_size == 0 || params.query_tile == 0)
+        throw ANNException("Ground truth block_size and query_tile must be positive", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    if (labels != nullptr && labels->query_labels.size() != num_queries)
+        throw ANNException("Ground truth needs one label per query", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    std::ifstream reader(base_file, std::ios::binary);
+    if (reader.fail())
+        throw ANNException(std::string("Failed to open file ") + base_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+    int npts_i32, dim_i32;
+    reader.read((char *)&npts_i32, sizeof(int));
+    reader.read((char *)&dim_i32, sizeof(int));
+    const size_t npts = (size_t)npts_i32;
+    if ((size_t)dim_i32 != dim)
+    {
+        std::stringstream stream;
+        stream << "Base file " << base_file << " has dimension " << dim_i32 << " but queries have " << dim;
+        throw ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (labels != nullptr && labels->point_labels.size() < npts)
+        throw ANNException("Ground truth needs labels for every base point", -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (location_to_tag != nullptr && location_to_tag->size() < npts)
+        throw ANNException("Ground truth needs a tag for every base point", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    const Metric metric = params.metric;
+    const uint32_t K = params.K;
+    const bool unfiltered = params.compute_unfiltered && K > 0;
+    const bool filtered = labels != nullptr && K > 0;
+    const bool l2 = metric != Metric::INNER_PRODUCT;
+    const int num_threads = params.num_threads > 0 ? (int)params.num_threads : omp_get_max_threads();
+    // The radius is an inner product for mips, the blocks hold negated ones.
+    const float range = l2 ? params.range : -params.range;
+
+    std::vector<float> query_data(queries, queries + num_queries * dim);
+    std::vector<float> query_norms(num_queries);
+    prepare_rows(query_data.data(), query_norms.data(), num_queries, dim, metric);
+
+    std::vector<GroundTruthHeap> heaps(params.compute_unfiltered ? num_queries : 0),
+        filtered_heaps(labels != nullptr ? num_queries : 0);
+    std::vector<std::vector<std::pair<float, uint32_t>>> range_hits(params.compute_range ? num_queries : 0);
+
+    // Double buffered: load_block fills one buffer on a background thread
+    // while the GEMM and selection run on the other.
+    const size_t block_size = std::min(params.block_size, std::max(npts, (size_t)1));
+    std::vector<float> blocks[2], block_norms[2];
+    for (int b = 0; b < 2; b++)
+    {
+        blocks[b].resize(block_size * dim);
+        block_norms[b].resize(block_size);
+    }
+    std::vector<T> raw(std::is_same<T, float>::value ? 0 : block_size * dim);
+    auto load_block = [&](const size_t start, const int b) {
+        const size_t n = std::min(block_size, npts - start);
+        if (std::is_same<T, float>::value)
+        {
+            reader.read((char *)blocks[b].data(), n * dim * sizeof(float));
+        }
+        else
+        {
+            reader.read((char *)raw.data(), n * dim * sizeof(T));
+            for (size_t i = 0; i < n * dim; i++)
+                blocks[b][i] = (float)raw[i];
+        }
+        if (!reader)
+            throw ANNException(std::string("Failed to read base points from ") + base_file, -1, __FUNCSIG__,
+                               __FILE__, __LINE__);
+        prepare_rows(blocks[b].data(), block_norms[b].data(), n, dim, metric);
+        return n;
+    };
+
+    const size_t query_tile = std::min(params.query_tile, std::max(num_queries, (size_t)1));
+    std::vector<float> dots(block_size * query_tile);
+
+    diskann::cout << "Computing ground truth for " << num_queries << " queries over " << npts << " points in " << dim
+                  << " dimensions, " << block_size << " points per block" << std::endl;
+
+    size_t n = npts > 0 ? load_block(0, 0) : 0;
+    int cur = 0;
+    for (size_t start = 0; start < npts; cur ^= 1)
+    {
+        std::future<size_t> next;
+        if (start + n < npts)
+            next = std::async(std::launch::async, load_block, start + n, cur ^ 1);
+
+        const float *points = blocks[cur].data();
+        const float *point_norms = block_norms[cur].data();
+        for (size_t q_begin = 0; q_begin < num_queries; q_begin += query_tile)
+        {
+            const size_t q_end = std::min(q_begin + query_tile, num_queries);
+            // Column major: column q holds the n dot products of query q, scaled
+            // so that adding the norms yields squared L2 (or -ip for mips).
+            cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, (MKL_INT)n, (MKL_INT)(q_end - q_begin), (MKL_INT)dim,
+                        l2 ? -2.0f : -1.0f, points, (MKL_INT)dim, query_data.data() + q_begin * dim, (MKL_INT)dim,
+                        0.0f, dots.data(), (MKL_INT)n);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+            for (int64_t q = (int64_t)q_begin; q < (int64_t)q_end; q++)
+            {
+                const float *column = dots.data() + (size_t)(q - q_begin) * n;
+                const float query_norm = l2 ? query_norms[q] : 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    const float dist = l2 ? column[i] + point_norms[i] + query_norm : column[i];
+                    const uint32_t id = (uint32_t)(start + i);
+                    if (location_to_tag != nullptr && (*location_to_tag)[id] == 0)
+                        continue;
+                    if (unfiltered && heap_admits(heaps[q], K, dist))
+                        heap_insert(heaps[q], K, dist, id);
+                    if (filtered && heap_admits(filtered_heaps[q], K, dist) &&
+                        labels_match(labels->point_labels[id], labels->query_labels[q], *labels))
+                        heap_insert(filtered_heaps[q], K, dist, id);
+                    if (params.compute_range && dist <= range)
+                        range_hits[q].emplace_back(dist, id);
+                }
+            }
+        }
+        diskann::cout << "Processed base points [" << start << ", " << start + n << ")" << std::endl;
+
+        start += n;
+        if (next.valid())
+            n = next.get();
+    }
+
+    result.num_queries = num_queries;
+    result.K = K;
+    result.ids.resize(params.compute_unfiltered ? num_queries * K : 0);
+    result.distances.resize(params.compute_unfiltered ? num_queries * K : 0);
+    result.filtered_ids.resize(labels != nullptr ? num_queries * K : 0);
+    result.filtered_distances.resize(labels != nullptr ? num_queries * K : 0);
+    result.range_ids.assign(params.compute_range ? num_queries : 0, std::vector<uint32_t>());
+
+#pragma omp parallel for schedule(dynamic, 64) num_threads(num_threads)
+    for (int64_t q = 0; q < (int64_t)num_queries; q++)
+    {
+        if (params.compute_unfiltered)
+            write_heap(heaps[q], K, metric, location_to_tag, result.ids.data() + q * K,
+                       result.distances.data() + q * K);
+        if (labels != nullptr)
+            write_heap(filtered_heaps[q], K, metric, location_to_tag, result.filtered_ids.data() + q * K,
+                       result.filtered_distances.data() + q * K);
+        if (params.compute_range)
+        {
+            std::sort(range_hits[q].begin(), range_hits[q].end());
+            result.range_ids[q].reserve(range_hits[q].size());
+            for (const auto &hit : range_hits[q])
+                result.range_ids[q].push_back(location_to_tag != nullptr ? (*location_to_tag)[hit.second]
+                                                                         : hit.second);
+        }
+    }
+}
+
+void save_ground_truth(const std::string &gt_file, const size_t num_queries, const uint32_t K,
+                       const std::vector<uint32_t> &ids, const std::vector<float> &distances)
+{
+    std::ofstream writer;
+    writer.exceptions(std::ios::failbit | std::ios::badbit);
+    writer.open(gt_file, std::ios::binary | std::ios::out);
+    int npts_i32 = (int)num_queries, K_i32 = (int)K;
+    writer.write((char *)&npts_i32, sizeof(int));
+    writer.write((char *)&K_i32, sizeof(int));
+    writer.write((char *)ids.data(), num_queries * K * sizeof(uint32_t));
+    writer.write((char *)distances.data(), num_queries * K * sizeof(float));
+    writer.close();
+    diskann::cout << "Saved ground truth for " << num_queries << " queries, K = " << K << " to " << gt_file
+                  << std::endl;
+}
+
+void save_range_ground_truth(const std::string &gt_file, const std::vector<std::vector<uint32_t>> &ids)
+{
+    std::vector<uint32_t> counts(ids.size());
+    size_t total = 0;
+    for (size_t q = 0; q < ids.size(); q++)
+    {
+        counts[q] = (uint32_t)ids[q].size();
+        total += ids[q].size();
+    }
+
+    std::ofstream writer;
+    writer.exceptions(std::ios::failbit | std::ios::badbit);
+    writer.open(gt_file, std::ios::binary | std::ios::out);
+    int npts_i32 = (int)ids.size(), total_i32 = (int)total;
+    writer.write((char *)&npts_i32, sizeof(int));
+    writer.write((char *)&total_i32, sizeof(int));
+    writer.write((char *)counts.data(), counts.size() * sizeof(uint32_t));
+    for (const auto &query_ids : ids)
+        writer.write((char *)query_ids.data(), query_ids.size() * sizeof(uint32_t));
+    writer.close();
+    diskann::cout << "Saved range ground truth for " << ids.size() << " queries, " << total << " ids in total, to "
+                  << gt_file << std::endl;
+}
+
+template DISKANN_DLLEXPORT void compute_ground_truth<float>(const std::string &, const float *, const size_t,
+                                                            const size_t, const GroundTruthParameters &,
+                                                            GroundTruthResult &, const GroundTruthLabels *,
+                                                            const std::vector<uint32_t> *);
+template DISKANN_DLLEXPORT void compute_ground_truth<int8_t>(const std::string &, const float *, const size_t,
+                                                             const size_t, const GroundTruthParameters &,
+                                                             GroundTruthResult &, const GroundTruthLabels *,
+                                                             const std::vector<uint32_t> *);
+template DISKANN_DLLEXPORT void compute_ground_truth<uint8_t>(const std::string &, const float *, const size_t,
+                                                              const size_t, const GroundTruthParameters &,
+                                                              GroundTruthResult &, const GroundTruthLabels *,
+                                                              const std::vector<uint32_t> *);
+} // namespace diskann
@@ -1,13 +1,17 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <mkl.h>
 #include <omp.h>
 
+#include <numeric>
 #include <type_traits>
 
 #include "boost/dynamic_bitset.hpp"
 #include "index_factory.h"
+#include "math_utils.h"
 #include "memory_mapper.h"
+#include "metrics.h"
 #include "timer.h"
 #include "tsl/robin_map.h"
 #include "tsl/robin_set.h"
@@ -27,6 +31,72 @@
 
 namespace diskann
 {
+namespace
+{
+// Both lists sorted; stops at the first common label.
+template <typename LabelT> bool sorted_labels_intersect(const std::vector<LabelT> &a, const std::vector<LabelT> &b)
+{
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end())
+    {
+        if (*i < *j)
+            ++i;
+        else if (*j < *i)
+            ++j;
+        else
+            return true;
+    }
+    return false;
+}
+
+// Splits rows, indices of points of dim floats in data, into pieces of at
+// most max_size rows: by k-means where it separates them, and into chunks
+// where it does not, as with duplicate points.
+std::vector<std::vector<uint32_t>> split_cluster(const float *data, const size_t dim,
+                                                 const std::vector<uint32_t> &rows, const size_t max_size)
+{
+    const size_t m = rows.size();
+    const size_t num_parts = DIV_ROUND_UP(m, defaults::KNN_SEED_CLUSTER_SIZE);
+    std::vector<float> centers(num_parts * dim);
+    {
+        const size_t num_train = (std::min)(m, num_parts * 128);
+        std::vector<float> train(num_train * dim);
+        std::mt19937 gen{(uint32_t)m};
+        std::uniform_int_distribution<size_t> dis(0, m - 1);
+        for (size_t i = 0; i < num_train; i++)
+        {
+            const size_t src = num_train == m ? i : dis(gen);
+            std::memcpy(train.data() + i * dim, data + (size_t)rows[src] * dim, dim * sizeof(float));
+        }
+        kmeans::kmeanspp_selecting_pivots(train.data(), num_train, dim, centers.data(), num_parts);
+        kmeans::run_lloyds(train.data(), num_train, dim, centers.data(), num_parts, 10, NULL, NULL);
+    }
+
+    std::vector<std::vector<uint32_t>> parts(num_parts);
+    const size_t assign_block = 65536;
+    std::vector<float> block((std::min)(assign_block, m) * dim);
+    std::vector<uint32_t> closest((std::min)(assign_block, m));
+    for (size_t start = 0; start < m; start += assign_block)
+    {
+        const size_t n = (std::min)(assign_block, m - start);
+        for (size_t i = 0; i < n; i++)
+            std::memcpy(block.data() + i * dim, data + (size_t)rows[start + i] * dim, dim * sizeof(float));
+        math_utils::compute_closest_centers(block.data(), n, dim, centers.data(), num_parts, 1, closest.data());
+        for (size_t i = 0; i < n; i++)
+            parts[closest[i]].push_back(rows[start + i]);
+    }
+
+    std::vector<std::vector<uint32_t>> pieces;
+    for (const auto &part : parts)
+    {
+        for (size_t begin = 0; begin < part.size(); begin += max_size)
+            pieces.emplace_back(part.begin() + begin, part.begin() + (std::min)(part.size(), begin + max_size));
+    }
+    return pieces;
+}
+} // namespace
+
 // Initialize an index with metric m, load the data of type T with filename
 // (bin), and initialize max_points
 template <typename T, typename TagT, typename LabelT>
@@ -89,6 +159,7 @@ Index<T, TagT, LabelT>::Index(const IndexConfig &index_config, std::shared_ptr<A
         if (_filtered_index)
         {
             _location_to_labels.resize(total_internal_points);
+            _location_to_label_bits.resize(total_internal_points, 0);
         }
     }
 
@@ -101,6 +172,10 @@ Index<T, TagT, LabelT>::Index(const IndexConfig &index_config, std::shared_ptr<A
         _filterIndexingQueueSize = index_config.index_write_params->filter_list_size;
         _indexingThreads = index_config.index_write_params->num_threads;
         _saturate_graph = index_config.index_write_params->saturate_graph;
+        _firstPassQueueSize = index_config.index_write_params->first_pass_list_size;
+        _firstPassAlpha = index_config.index_write_params->first_pass_alpha;
+        _firstPassSampleRate = index_config.index_write_params->first_pass_sample_rate;
+        _knnSeedDegree = index_config.index_write_params->knn_seed_degree;
 
         if (index_config.index_search_params != nullptr)
         {
@@ -558,6 +633,19 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
         std::string tags_file = std::string(filename) + ".tags";
         std::string delete_set_file = std::string(filename) + ".del";
         std::string graph_file = std::string(filename);
+        if (_dynamic_index)
+        {
+            // Dynamic filtered indices add frozen points as labels are inserted.
+            const size_t graph_frozen_pts = get_graph_num_frozen_points(graph_file);
+            if (graph_frozen_pts > _num_frozen_pts)
+            {
+                const size_t old_internal_points = _max_points + _num_frozen_pts;
+                grow_frozen_points(graph_frozen_pts - _num_frozen_pts);
+                // The loaded frozen points are moved here from after the data.
+                for (size_t location = old_internal_points; location < _max_points + _num_frozen_pts; location++)
+                    _graph_store->clear_neighbours((location_t)location);
+            }
+        }
         data_file_num_pts = load_data(data_file);
         if (file_exists(delete_set_file))
         {
@@ -592,7 +680,13 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
     {
         _label_map = load_label_map(labels_map_file);
         parse_label_file(labels_file, label_num_pts);
-        assert(label_num_pts == data_file_num_pts - _num_frozen_pts);
+        // Labels of frozen points are saved with the others.
+        assert(label_num_pts == data_file_num_pts);
+        if (_dynamic_index)
+        {
+            _location_to_labels.resize(_max_points + _num_frozen_pts);
+            _location_to_label_bits.resize(_max_points + _num_frozen_pts, 0);
+        }
         if (file_exists(labels_to_medoids))
         {
             std::ifstream medoid_stream(labels_to_medoids);
@@ -643,6 +737,8 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
     }
 
     reposition_frozen_point_to_end();
+    if (_dynamic_index && _filtered_index)
+        rebuild_label_starts();
     diskann::cout << "Num frozen points:" << _num_frozen_pts << " _nd: " << _nd << " _start: " << _start
                   << " size(_location_to_tag): " << _location_to_tag.size()
                   << " size(_tag_to_location):" << _tag_to_location.size() << " Max points: " << _max_points
@@ -761,37 +857,144 @@ template <typename T, typename TagT, typename LabelT>
 bool Index<T, TagT, LabelT>::detect_common_filters(uint32_t point_id, bool search_invocation,
                                                    const std::vector<LabelT> &incoming_labels)
 {
-    auto &curr_node_labels = _location_to_labels[point_id];
-    std::vector<LabelT> common_filters;
-    std::set_intersection(incoming_labels.begin(), incoming_labels.end(), curr_node_labels.begin(),
-                          curr_node_labels.end(), std::back_inserter(common_filters));
-    if (common_filters.size() > 0)
+    return detect_common_filters(point_id, incoming_labels, prepare_filter_match(incoming_labels, search_invocation));
+}
+
+template <typename T, typename TagT, typename LabelT>
+typename Index<T, TagT, LabelT>::FilterMatch Index<T, TagT, LabelT>::prepare_filter_match(
+    const std::vector<LabelT> &incoming_labels, bool search_invocation) const
+{
+    FilterMatch match;
+    if (_use_universal_label && !search_invocation &&
+        std::find(incoming_labels.begin(), incoming_labels.end(), _universal_label) != incoming_labels.end())
     {
-        // This is to reduce the repetitive calls. If common_filters size is > 0 ,
-        // we dont need to check further for universal label
-        return true;
+        match.match_all = true;
+        return match;
     }
+
+    match.use_bits = true;
+    for (const auto label : incoming_labels)
+        match.use_bits = match.use_bits && (uint64_t)label < LABEL_BITMAP_BITS;
     if (_use_universal_label)
+        match.use_bits = match.use_bits && (uint64_t)_universal_label < LABEL_BITMAP_BITS;
+    if (match.use_bits)
     {
-        if (!search_invocation)
+        // A node carrying the universal label matches any filter.
+        match.bits = label_bitmap(incoming_labels);
+        if (_use_universal_label)
+            match.bits |= (uint64_t)1 << _universal_label;
+    }
+    return match;
+}
+
+template <typename T, typename TagT, typename LabelT>
+bool Index<T, TagT, LabelT>::detect_common_filters(uint32_t point_id, const std::vector<LabelT> &incoming_labels,
+                                                   const FilterMatch &match) const
+{
+    if (match.match_all)
+        return true;
+    if (match.use_bits)
+        return (_location_to_label_bits[point_id] & match.bits) != 0;
+
+    auto &curr_node_labels = _location_to_labels[point_id];
+    if (sorted_labels_intersect(incoming_labels, curr_node_labels))
+        return true;
+    return _use_universal_label &&
+           std::binary_search(curr_node_labels.begin(), curr_node_labels.end(), _universal_label);
+}
+
+template <typename T, typename TagT, typename LabelT>
+bool Index<T, TagT, LabelT>::matches_label_filter(uint32_t location, const LabelFilter<LabelT> &filter) const
+{
+    const uint64_t bits = _location_to_label_bits[location];
+    if (filter.fits_bitmap() && (!_use_universal_label || (uint64_t)_universal_label < LABEL_BITMAP_BITS))
+        return (_use_universal_label && ((bits >> _universal_label) & 1)) || filter.matches(bits);
+
+    const auto &labels = _location_to_labels[location];
+    if (_use_universal_label && std::binary_search(labels.begin(), labels.end(), _universal_label))
+        return true;
+    return filter.matches(labels.data(), labels.size());
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::estimate_filter_matches(const LabelFilter<LabelT> &filter) const
+{
+    auto count = [this](const LabelT label) {
+        auto iter = _label_to_locations.find(label);
+        return iter == _label_to_locations.end() ? (size_t)0 : iter->second.size();
+    };
+    size_t estimate = filter.estimate_matches(count, _nd);
+    if (_use_universal_label)
+        estimate = std::min(estimate + count(_universal_label), (size_t)_nd);
+    return estimate;
+}
+
+template <typename T, typename TagT, typename LabelT>
+uint32_t Index<T, TagT, LabelT>::scan_filtered_points(const LabelFilter<LabelT> &filter, const uint32_t L,
+                                                      InMemQueryScratch<T> *scratch) const
+{
+    // A clause can only match the points of its rarest positive label, and a
+    // clause without one can match any point.
+    std::vector<uint32_t> candidates;
+    bool scan_all = false;
+    for (const auto &clause : filter.clauses())
+    {
+        if (clause.all_of.empty())
         {
-            if (std::find(incoming_labels.begin(), incoming_labels.end(), _universal_label) != incoming_labels.end() ||
-                std::find(curr_node_labels.begin(), curr_node_labels.end(), _universal_label) != curr_node_labels.end())
-                common_filters.push_back(_universal_label);
+            scan_all = true;
+            break;
         }
-        else
+        const std::vector<uint32_t> *rarest = nullptr;
+        size_t rarest_count = std::numeric_limits<size_t>::max();
+        for (const auto label : clause.all_of)
         {
-            if (std::find(curr_node_labels.begin(), curr_node_labels.end(), _universal_label) != curr_node_labels.end())
-                common_filters.push_back(_universal_label);
+            auto iter = _label_to_locations.find(label);
+            const size_t label_count = iter == _label_to_locations.end() ? 0 : iter->second.size();
+            if (label_count < rarest_count)
+            {
+                rarest_count = label_count;
+                rarest = iter == _label_to_locations.end() ? nullptr : &iter->second;
+            }
         }
+        if (rarest != nullptr)
+            candidates.insert(candidates.end(), rarest->begin(), rarest->end());
     }
-    return (common_filters.size() > 0);
+
+    if (scan_all)
+    {
+        candidates.resize(_nd);
+        std::iota(candidates.begin(), candidates.end(), 0);
+    }
+    else
+    {
+        auto iter = _label_to_locations.find(_universal_label);
+        if (_use_universal_label && iter != _label_to_locations.end())
+            candidates.insert(candidates.end(), iter->second.begin(), iter->second.end());
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [this, &filter](const uint32_t location) {
+                                        return !matches_label_filter(location, filter);
+                                    }),
+                     candidates.end());
+
+    std::vector<float> distances(candidates.size());
+    _data_store->get_distance(scratch->aligned_query(), candidates.data(), (uint32_t)candidates.size(),
+                              distances.data(), scratch);
+
+    NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+    best_L_nodes.reserve(L);
+    for (size_t i = 0; i < candidates.size(); i++)
+        best_L_nodes.insert(Neighbor(candidates[i], distances[i]));
+    return (uint32_t)candidates.size();
 }
 
 template <typename T, typename TagT, typename LabelT>
 std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
     InMemQueryScratch<T> *scratch, const uint32_t Lsize, const std::vector<uint32_t> &init_ids, bool use_filter,
-    const std::vector<LabelT> &filter_labels, bool search_invocation)
+    const std::vector<LabelT> &filter_labels, bool search_invocation, QueryTrace *trace, std::vector<Neighbor> *scored)
 {
     std::vector<Neighbor> &expanded_nodes = scratch->pool();
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
@@ -806,7 +1009,14 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
 
     float *pq_dists = nullptr;
 
+    const FilterMatch filter_match =
+        use_filter ? prepare_filter_match(filter_labels, search_invocation) : FilterMatch();
+
+    if (trace != nullptr)
+        trace->pq_table_begin_us = trace->elapsed_us();
     _pq_data_store->preprocess_query(aligned_query, scratch);
+    if (trace != nullptr)
+        trace->pq_table_us = trace->elapsed_us() - trace->pq_table_begin_us;
 
     if (expanded_nodes.size() > 0 || id_scratch.size() > 0)
     {
@@ -851,7 +1061,7 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
 
         if (use_filter)
         {
-            if (!detect_common_filters(id, search_invocation, filter_labels))
+            if (!detect_common_filters(id, filter_labels, filter_match))
                 continue;
         }
 
@@ -874,6 +1084,8 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
 
             Neighbor nn = Neighbor(id, distance);
             best_L_nodes.insert(nn);
+            if (scored != nullptr)
+                scored->push_back(nn);
         }
     }
 
@@ -882,8 +1094,12 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
 
     while (best_L_nodes.has_unexpanded_node())
     {
+        const float hop_begin_us = trace != nullptr ? trace->elapsed_us() : 0;
         auto nbr = best_L_nodes.closest_unexpanded();
         auto n = nbr.id;
+        hops++;
+        if (scored != nullptr)
+            scored->push_back(nbr);
 
         // Add node to expanded nodes to create pool for prune later
         if (!search_invocation)
@@ -916,7 +1132,7 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
                 if (use_filter)
                 {
                     // NOTE: NEED TO CHECK IF THIS CORRECT WITH NEW LOCKS.
-                    if (!detect_common_filters(id, search_invocation, filter_labels))
+                    if (!detect_common_filters(id, filter_labels, filter_match))
                         continue;
                 }
 
@@ -938,7 +1154,7 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
                 if (use_filter)
                 {
                     // NOTE: NEED TO CHECK IF THIS CORRECT WITH NEW LOCKS.
-                    if (!detect_common_filters(id, search_invocation, filter_labels))
+                    if (!detect_common_filters(id, filter_labels, filter_match))
                         continue;
                 }
 
@@ -970,8 +1186,16 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
         for (size_t m = 0; m < id_scratch.size(); ++m)
         {
             best_L_nodes.insert(Neighbor(id_scratch[m], dist_scratch[m]));
+            if (scored != nullptr)
+                scored->emplace_back(id_scratch[m], dist_scratch[m]);
         }
+
+        if (trace != nullptr)
+            trace->add_hop(hop_begin_us);
     }
+
+    if (trace != nullptr)
+        trace->n_cmps = cmps;
     return std::make_pair(hops, cmps);
 }
 
@@ -1268,6 +1492,212 @@ void Index<T, TagT, LabelT>::inter_insert(uint32_t n, std::vector<uint32_t> &pru
     inter_insert(n, pruned_list, _indexingRange, scratch);
 }
 
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::link_pass(const std::vector<uint32_t> &visit_order, const uint32_t Lindex,
+                                       const uint32_t filteredLindex)
+{
+#pragma omp parallel for schedule(dynamic, 2048)
+    for (int64_t node_ctr = 0; node_ctr < (int64_t)(visit_order.size()); node_ctr++)
+    {
+        auto node = visit_order[node_ctr];
+
+        // Find and add appropriate graph edges
+        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+        auto scratch = manager.scratch_space();
+        std::vector<uint32_t> pruned_list;
+        if (_filtered_index)
+        {
+            search_for_point_and_prune(node, Lindex, pruned_list, scratch, true, filteredLindex);
+        }
+        else
+        {
+            search_for_point_and_prune(node, Lindex, pruned_list, scratch);
+        }
+        assert(pruned_list.size() > 0);
+
+        {
+            LockGuard guard(_locks[node]);
+
+            _graph_store->set_neighbours(node, pruned_list);
+            assert(_graph_store->get_neighbours((location_t)node).size() <= _indexingRange);
+        }
+
+        inter_insert(node, pruned_list, scratch);
+
+        if (node_ctr % 100000 == 0)
+        {
+            diskann::cout << "\r" << (100.0 * node_ctr) / (visit_order.size()) << "% of index build completed."
+                          << std::flush;
+        }
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::knn_seed_graph(const std::vector<uint32_t> &points, const uint32_t k)
+{
+    const size_t npts = points.size();
+    const size_t dim = _data_store->get_dims();
+    if (npts <= k)
+        return;
+
+    // Dense float copy of the points, row i holds points[i]
+    std::unique_ptr<float[]> data = std::make_unique<float[]>(npts * dim);
+#pragma omp parallel
+    {
+        std::vector<T> vec(dim);
+#pragma omp for schedule(static, 8192)
+        for (int64_t i = 0; i < (int64_t)npts; i++)
+        {
+            _data_store->get_vector(points[i], vec.data());
+            float *row = data.get() + i * dim;
+            for (size_t d = 0; d < dim; d++)
+                row[d] = (float)vec[d];
+        }
+    }
+
+    // Cluster a sample of the points and assign every point to its nearest
+    // num_probes clusters, so that neighbours across a boundary are found.
+    const size_t num_clusters = (std::max)((size_t)1, npts / defaults::KNN_SEED_CLUSTER_SIZE);
+    const size_t num_probes = (std::min)((size_t)defaults::KNN_SEED_NUM_PROBES, num_clusters);
+    std::unique_ptr<float[]> centers = std::make_unique<float[]>(num_clusters * dim);
+    {
+        const size_t num_train = (std::min)(npts, num_clusters * 128);
+        std::unique_ptr<float[]> train = std::make_unique<float[]>(num_train * dim);
+        std::mt19937 gen{(uint32_t)npts};
+        std::uniform_int_distribution<size_t> dis(0, npts - 1);
+        for (size_t i = 0; i < num_train; i++)
+        {
+            const size_t src = num_train == npts ? i : dis(gen);
+            std::memcpy(train.get() + i * dim, data.get() + src * dim, dim * sizeof(float));
+        }
+        kmeans::kmeanspp_selecting_pivots(train.get(), num_train, dim, centers.get(), num_clusters);
+        kmeans::run_lloyds(train.get(), num_train, dim, centers.get(), num_clusters, 10, NULL, NULL);
+    }
+
+    std::vector<uint32_t> closest(npts * num_probes);
+    const size_t assign_block = 65536;
+    for (size_t start = 0; start < npts; start += assign_block)
+    {
+        math_utils::compute_closest_centers(data.get() + start * dim, (std::min)(assign_block, npts - start), dim,
+                                            centers.get(), num_clusters, num_probes,
+                                            closest.data() + start * num_probes);
+    }
+    centers.reset();
+
+    std::vector<std::vector<uint32_t>> members(num_clusters);
+    for (size_t i = 0; i < npts; i++)
+        for (size_t p = 0; p < num_probes; p++)
+            members[closest[i * num_probes + p]].push_back((uint32_t)i);
+
+    // The kNN of a cluster of m points costs O(m^2 dim) on one thread, so on
+    // skewed data the clusters above KNN_SEED_MAX_CLUSTER_SIZE are split into
+    // pieces; cluster_of maps each piece back to the cluster of its points.
+    std::vector<uint32_t> cluster_of(num_clusters);
+    std::iota(cluster_of.begin(), cluster_of.end(), 0);
+    for (size_t c = 0; c < num_clusters; c++)
+    {
+        if (members[c].size() <= defaults::KNN_SEED_MAX_CLUSTER_SIZE)
+            continue;
+        auto pieces = split_cluster(data.get(), dim, members[c], defaults::KNN_SEED_MAX_CLUSTER_SIZE);
+        members[c] = std::move(pieces.back());
+        pieces.pop_back();
+        for (auto &piece : pieces)
+        {
+            members.push_back(std::move(piece));
+            cluster_of.push_back((uint32_t)c);
+        }
+    }
+
+    // Exact kNN inside each cluster: rows of -2 X X^T + |x_j|^2 come out of
+    // one sgemm per block of rows; |x_i|^2 is constant per row and dropped.
+    const uint32_t none = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> knn(npts * num_probes * k, none);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t piece = 0; piece < (int64_t)members.size(); piece++)
+    {
+        const uint32_t c = cluster_of[piece];
+        const std::vector<uint32_t> &rows = members[piece];
+        const size_t m = rows.size();
+        if (m < 2)
+            continue;
+        const size_t kc = (std::min)((size_t)k, m - 1);
+
+        std::vector<float> cdata(m * dim), norms(m);
+        for (size_t j = 0; j < m; j++)
+        {
+            const float *src = data.get() + (size_t)rows[j] * dim;
+            std::memcpy(cdata.data() + j * dim, src, dim * sizeof(float));
+            float norm = 0;
+            for (size_t d = 0; d < dim; d++)
+                norm += src[d] * src[d];
+            norms[j] = norm;
+        }
+
+        const size_t block_rows = (std::max)((size_t)1, (std::min)(m, ((size_t)1 << 24) / m));
+        std::vector<float> dists(block_rows * m);
+        std::vector<uint32_t> order(m);
+        for (size_t r0 = 0; r0 < m; r0 += block_rows)
+        {
+            const size_t nr = (std::min)(block_rows, m - r0);
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, (MKL_INT)nr, (MKL_INT)m, (MKL_INT)dim, -2.0f,
+                        cdata.data() + r0 * dim, (MKL_INT)dim, cdata.data(), (MKL_INT)dim, 0.0f, dists.data(),
+                        (MKL_INT)m);
+            for (size_t r = 0; r < nr; r++)
+            {
+                float *dist_row = dists.data() + r * m;
+                for (size_t j = 0; j < m; j++)
+                    dist_row[j] += norms[j];
+                dist_row[r0 + r] = std::numeric_limits<float>::max();
+
+                std::iota(order.begin(), order.end(), 0);
+                std::partial_sort(order.begin(), order.begin() + kc, order.end(),
+                                  [dist_row](uint32_t a, uint32_t b) { return dist_row[a] < dist_row[b]; });
+
+                const uint32_t row = rows[r0 + r];
+                size_t slot = 0;
+                while (closest[row * num_probes + slot] != c)
+                    slot++;
+                uint32_t *out = knn.data() + (row * num_probes + slot) * k;
+                for (size_t j = 0; j < kc; j++)
+                    out[j] = rows[order[j]];
+            }
+        }
+    }
+    data.reset();
+
+    // Prune the union of the per-cluster candidates of each point into its
+    // initial out-neighbours and add the reverse edges.
+#pragma omp parallel for schedule(dynamic, 2048)
+    for (int64_t i = 0; i < (int64_t)npts; i++)
+    {
+        const uint32_t node = points[i];
+        std::vector<Neighbor> pool;
+        pool.reserve(num_probes * k);
+        const uint32_t *cand = knn.data() + i * num_probes * k;
+        for (size_t j = 0; j < num_probes * k; j++)
+        {
+            if (cand[j] == none)
+                continue;
+            const uint32_t id = points[cand[j]];
+            if (std::find_if(pool.begin(), pool.end(), [id](const Neighbor &n) { return n.id == id; }) != pool.end())
+                continue;
+            pool.emplace_back(id, _data_store->get_distance(node, id));
+        }
+        if (pool.empty())
+            continue;
+
+        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+        auto scratch = manager.scratch_space();
+        std::vector<uint32_t> pruned_list;
+        prune_neighbors(node, pool, pruned_list, scratch);
+        {
+            LockGuard guard(_locks[node]);
+            _graph_store->set_neighbours(node, pruned_list);
+        }
+        inter_insert(node, pruned_list, scratch);
+    }
+}
+
 template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::link()
 {
     uint32_t num_threads = _indexingThreads;
@@ -1298,39 +1728,66 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
 
     diskann::Timer link_timer;
 
-#pragma omp parallel for schedule(dynamic, 2048)
-    for (int64_t node_ctr = 0; node_ctr < (int64_t)(visit_order.size()); node_ctr++)
+    if (_knnSeedDegree > 0 && _nd > 0)
     {
-        auto node = visit_order[node_ctr];
+        if (_dist_metric != diskann::Metric::L2 || _filtered_index)
+            throw ANNException("kNN seeding is only supported for unfiltered builds with the L2 metric", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        diskann::Timer seed_timer;
+        knn_seed_graph(visit_order, _knnSeedDegree);
+        diskann::cout << "kNN seed time: " << ((double)seed_timer.elapsed() / (double)1000000) << "s" << std::endl;
+    }
 
-        // Find and add appropriate graph edges
-        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-        auto scratch = manager.scratch_space();
-        std::vector<uint32_t> pruned_list;
-        if (_filtered_index)
+    // Coarse first pass: link a sample of the points with a small list size
+    // and (by default) alpha = 1, so that the second pass searches a graph
+    // which already has short paths instead of an empty one.
+    if (_firstPassQueueSize > 0 && _nd > 0)
+    {
+        const uint32_t first_pass_L = (std::min)(_firstPassQueueSize, _indexingQueueSize);
+        const uint32_t first_pass_Lf = (std::min)(_firstPassQueueSize, _filterIndexingQueueSize);
+
+        std::vector<uint32_t> first_pass_order;
+        if (_firstPassSampleRate < 1.0f)
         {
-            search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch, true, _filterIndexingQueueSize);
+            std::mt19937 gen{(uint32_t)_nd};
+            std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+            tsl::robin_set<uint32_t> start_points;
+            start_points.insert(_start);
+            for (auto &label_start : _label_to_start_id)
+                start_points.insert(label_start.second);
+
+            first_pass_order.reserve((size_t)(_firstPassSampleRate * visit_order.size()) + start_points.size());
+            for (auto node : visit_order)
+            {
+                // the start points always take part so the sample stays reachable
+                if (node >= _max_points || start_points.find(node) != start_points.end() ||
+                    dis(gen) < _firstPassSampleRate)
+                    first_pass_order.emplace_back(node);
+            }
         }
         else
         {
-            search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch);
-        }
-        assert(pruned_list.size() > 0);
-
-        {
-            LockGuard guard(_locks[node]);
-
-            _graph_store->set_neighbours(node, pruned_list);
-            assert(_graph_store->get_neighbours((location_t)node).size() <= _indexingRange);
+            first_pass_order = visit_order;
         }
 
-        inter_insert(node, pruned_list, scratch);
+        diskann::cout << "Starting first pass over " << first_pass_order.size() << " points with L: " << first_pass_L
+                      << " alpha: " << _firstPassAlpha << std::endl;
+        diskann::Timer pass_timer;
+        const float target_alpha = _indexingAlpha;
+        _indexingAlpha = _firstPassAlpha;
+        link_pass(first_pass_order, first_pass_L, first_pass_Lf);
+        _indexingAlpha = target_alpha;
+        diskann::cout << "\rFirst pass time: " << ((double)pass_timer.elapsed() / (double)1000000) << "s"
+                      << std::endl;
 
-        if (node_ctr % 100000 == 0)
-        {
-            diskann::cout << "\r" << (100.0 * node_ctr) / (visit_order.size()) << "% of index build completed."
-                          << std::flush;
-        }
+        pass_timer.reset();
+        link_pass(visit_order, _indexingQueueSize, _filterIndexingQueueSize);
+        diskann::cout << "\rSecond pass time: " << ((double)pass_timer.elapsed() / (double)1000000) << "s"
+                      << std::endl;
+    }
+    else
+    {
+        link_pass(visit_order, _indexingQueueSize, _filterIndexingQueueSize);
     }
 
     if (_nd > 0)
@@ -1505,6 +1962,12 @@ void Index<T, TagT, LabelT>::set_start_points_at_random(T radius, uint32_t rando
     set_start_points(points_data.data(), points_data.size());
 }
 
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::set_query_tracer(std::shared_ptr<QueryTracer> tracer)
+{
+    _query_tracer = tracer;
+}
+
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::build_with_data_populated(const std::vector<TagT> &tags)
 {
@@ -1814,6 +2277,8 @@ void Index<T, TagT, LabelT>::parse_label_file(const std::string &label_file, siz
         line_cnt++;
     }
     _location_to_labels.resize(line_cnt, std::vector<LabelT>());
+    _location_to_label_bits.resize(line_cnt, 0);
+    _label_to_locations.clear();
 
     infile.clear();
     infile.seekg(0, std::ios::beg);
@@ -1835,6 +2300,16 @@ void Index<T, TagT, LabelT>::parse_label_file(const std::string &label_file, siz
         }
 
         std::sort(lbls.begin(), lbls.end());
+        if (!_dynamic_index)
+        {
+            for (const auto label : lbls)
+            {
+                auto &locations = _label_to_locations[label];
+                if (locations.empty() || locations.back() != line_cnt)
+                    locations.push_back(line_cnt);
+            }
+        }
+        _location_to_label_bits[line_cnt] = label_bitmap(lbls);
         _location_to_labels[line_cnt] = lbls;
         line_cnt++;
     }
@@ -1921,6 +2396,14 @@ void Index<T, TagT, LabelT>::build_filtered_index(const char *filename, const st
     }
 
     this->build(filename, num_points_to_load, tags);
+
+    if (_dynamic_index)
+    {
+        // Room for the labels of points and frozen points inserted later.
+        _location_to_labels.resize(_max_points + _num_frozen_pts);
+        _location_to_label_bits.resize(_max_points + _num_frozen_pts, 0);
+        rebuild_label_starts();
+    }
 }
 
 template <typename T, typename TagT, typename LabelT>
@@ -1965,8 +2448,15 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, con
         throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
+    auto &metrics = InMemoryIndexMetrics::get();
+    diskann::Timer query_timer;
+    QueryTrace *trace = _query_tracer != nullptr ? _query_tracer->begin_query() : nullptr;
+
     ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
     auto scratch = manager.scratch_space();
+    metrics.scratch_wait.record(query_timer.elapsed());
+    if (trace != nullptr)
+        trace->scratch_wait_us = trace->elapsed_us();
 
     if (L > scratch->get_L())
     {
@@ -1983,7 +2473,7 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, con
 
     _data_store->preprocess_query(query, scratch);
 
-    auto retval = iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true);
+    auto retval = iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true, trace);
 
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
 
@@ -2015,6 +2505,10 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, con
         diskann::cerr << "Found pos: " << pos << "fewer than K elements " << K << " for query" << std::endl;
     }
 
+    metrics.queries.add();
+    metrics.query_latency.record(query_timer.elapsed());
+    if (trace != nullptr)
+        _query_tracer->end_query(trace);
     return retval;
 }
 
@@ -2046,24 +2540,41 @@ template <typename IdType>
 std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const T *query, const LabelT &filter_label,
                                                                           const size_t K, const uint32_t L,
                                                                           IdType *indices, float *distances)
+{
+    return search_with_filters(query, LabelFilter<LabelT>(filter_label), K, L, indices, distances);
+}
+
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const T *query,
+                                                                          const LabelFilter<LabelT> &filter,
+                                                                          const size_t K, const uint32_t L,
+                                                                          IdType *indices, float *distances,
+                                                                          QueryStats *stats)
 {
     if (K > (uint64_t)L)
     {
         throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-
-    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-    auto scratch = manager.scratch_space();
-
-    if (L > scratch->get_L())
+    if (filter.empty())
     {
-        diskann::cout << "Attempting to expand query scratch_space. Was created "
-                      << "with Lsize: " << scratch->get_L() << " but search L is: " << L << std::endl;
-        scratch->resize_for_new_L(L);
-        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+        throw ANNException("Label filter has no clauses", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
-    std::vector<LabelT> filter_vec;
+    auto &metrics = InMemoryIndexMetrics::get();
+    diskann::Timer query_timer;
+    QueryTrace *trace = _query_tracer != nullptr ? _query_tracer->begin_query() : nullptr;
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    metrics.scratch_wait.record(query_timer.elapsed());
+    if (trace != nullptr)
+        trace->scratch_wait_us = trace->elapsed_us();
+
+    // The graph walk is restricted to the anchor labels and seeded with their
+    // start points; clauses whose anchor has no start point cannot match
+    // anything but universal points, which the other anchors reach.
+    const std::vector<LabelT> anchors = filter.anchor_labels();
     std::vector<uint32_t> init_ids = get_init_ids();
 
     std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
@@ -2071,30 +2582,60 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const
     if (_dynamic_index)
         tl.lock();
 
-    if (_label_to_start_id.find(filter_label) != _label_to_start_id.end())
+    bool found_start = false;
+    for (const auto label : anchors)
+    {
+        if (_label_to_start_id.find(label) != _label_to_start_id.end())
+        {
+            init_ids.emplace_back(_label_to_start_id[label]);
+            found_start = true;
+        }
+    }
+    if (_dynamic_index)
+        tl.unlock();
+
+    // Label cardinalities are not tracked under updates, so a dynamic index
+    // walks the graph whenever it can.
+    FilterPlan plan;
+    uint32_t search_L = L;
+    if (_dynamic_index)
     {
-        init_ids.emplace_back(_label_to_start_id[filter_label]);
+        plan = found_start ? FilterPlan::Graph : FilterPlan::PostFilter;
+        if (!found_start)
+            search_L = L * defaults::FILTER_POST_FILTER_MAX_EXPANSION;
     }
     else
     {
-        diskann::cout << "No filtered medoid found. exitting "
-                      << std::endl; // RKNOTE: If universal label found start there
-        throw diskann::ANNException("No filtered medoid found. exitting ", -1);
+        const size_t estimated_matches = estimate_filter_matches(filter);
+        plan = plan_filtered_search(estimated_matches, _nd, L, _graph_store->get_max_observed_degree(), found_start);
+        if (plan == FilterPlan::PostFilter)
+            search_L = post_filter_list_size(estimated_matches, _nd, L);
     }
-    if (_dynamic_index)
-        tl.unlock();
 
-    filter_vec.emplace_back(filter_label);
+    if (search_L > scratch->get_L())
+    {
+        diskann::cout << "Attempting to expand query scratch_space. Was created "
+                      << "with Lsize: " << scratch->get_L() << " but search L is: " << search_L << std::endl;
+        scratch->resize_for_new_L(search_L);
+        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+    }
 
     _data_store->preprocess_query(query, scratch);
-    auto retval = iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true);
+    std::pair<uint32_t, uint32_t> retval;
+    if (plan == FilterPlan::Exact)
+        retval = std::make_pair(0, scan_filtered_points(filter, L, scratch));
+    else
+        retval = iterate_to_fixed_point(scratch, search_L, init_ids, plan == FilterPlan::Graph, anchors, true, trace);
 
     auto best_L_nodes = scratch->best_l_nodes();
 
+    // Nodes reached over the anchors match an OR of single labels already.
+    const bool check_filter =
+        plan == FilterPlan::PostFilter || (plan == FilterPlan::Graph && !filter.is_label_disjunction());
     size_t pos = 0;
     for (size_t i = 0; i < best_L_nodes.size(); ++i)
     {
-        if (best_L_nodes[i].id < _max_points)
+        if (best_L_nodes[i].id < _max_points && (!check_filter || matches_label_filter(best_L_nodes[i].id, filter)))
         {
             indices[pos] = (IdType)best_L_nodes[i].id;
 
@@ -2118,18 +2659,331 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const
         diskann::cerr << "Found fewer than K elements for query" << std::endl;
     }
 
+    if (stats != nullptr)
+    {
+        stats->filter_plan = plan;
+        stats->n_hops = retval.first;
+        stats->n_cmps = retval.second;
+        stats->total_us = (float)query_timer.elapsed();
+    }
+    metrics.queries.add();
+    metrics.query_latency.record(query_timer.elapsed());
+    if (trace != nullptr)
+        _query_tracer->end_query(trace);
     return retval;
 }
 
 template <typename T, typename TagT, typename LabelT>
-size_t Index<T, TagT, LabelT>::_search_with_tags(const DataType &query, const uint64_t K, const uint32_t L,
-                                                 const TagType &tags, float *distances, DataVector &res_vectors,
-                                                 bool use_filters, const std::string filter_label)
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::range_iterate(InMemQueryScratch<T> *scratch, const float radius,
+                                                                    const uint32_t L, const uint32_t max_L,
+                                                                    const std::vector<uint32_t> &init_ids,
+                                                                    bool use_filter,
+                                                                    const std::vector<LabelT> &filter_labels,
+                                                                    const LabelFilter<LabelT> *check_filter,
+                                                                    std::vector<Neighbor> &results)
 {
-    try
-    {
-        return this->search_with_tags(std::any_cast<const T *>(query), K, L, std::any_cast<TagT *>(tags), distances,
-                                      res_vectors.get<std::vector<T *>>(), use_filters, filter_label);
+    // The queue holds negated inner products, which search flips back.
+#ifdef EXEC_ENV_OLS
+    const float range = radius;
+#else
+    const float range = _dist_metric == diskann::Metric::INNER_PRODUCT ? -radius : radius;
+#endif
+    auto within_range = [range](const Neighbor &nbr) { return nbr.distance <= range; };
+
+    // The buffers prune_neighbors uses during build are idle during search.
+    NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+    std::vector<Neighbor> &scored = scratch->expanded_nodes_vec();
+    tsl::robin_set<uint32_t> &expanded = scratch->expanded_nodes_set();
+    const std::vector<uint32_t> no_init_ids;
+    auto retval = iterate_to_fixed_point(scratch, L, init_ids, use_filter, filter_labels, true, nullptr, &scored);
+
+    // A walk finds most points in range only with a list several times longer
+    // than their number, so the list keeps growing while a quarter of it is
+    // in range. This depends only on distances: points in range that fail the
+    // filter still show that the ball extends past the list.
+    size_t found = 0;
+    std::vector<Neighbor> candidates;
+    for (uint32_t cur_L = L; 2 * (uint64_t)cur_L <= max_L;)
+    {
+        size_t in_list = 0;
+        for (size_t i = 0; i < best_L_nodes.size(); i++)
+            in_list += within_range(best_L_nodes[i]) ? 1 : 0;
+        const size_t prev_found = found;
+        found = std::count_if(scored.begin(), scored.end(),
+                              [&within_range](const Neighbor &nbr) { return !nbr.expanded && within_range(nbr); });
+        if (4 * in_list < cur_L || found == prev_found)
+            break;
+
+        cur_L *= 2;
+        scratch->resize_for_new_L(cur_L);
+        best_L_nodes.reserve(cur_L);
+
+        // Candidates that fell off the list go back on it, nearest first,
+        // unless they were expanded before they fell off.
+        for (const auto &nbr : scored)
+            if (nbr.expanded)
+                expanded.insert(nbr.id);
+        candidates.clear();
+        for (const auto &nbr : scored)
+            if (!nbr.expanded && expanded.find(nbr.id) == expanded.end())
+                candidates.push_back(nbr);
+        if (candidates.size() > cur_L)
+        {
+            std::nth_element(candidates.begin(), candidates.begin() + cur_L, candidates.end());
+            candidates.resize(cur_L);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (const auto &nbr : candidates)
+            best_L_nodes.insert(nbr);
+
+        scratch->id_scratch().clear();
+        const auto round =
+            iterate_to_fixed_point(scratch, cur_L, no_init_ids, use_filter, filter_labels, true, nullptr, &scored);
+        retval.first += round.first;
+        retval.second += round.second;
+    }
+
+    // Every point scored has exactly one entry not marked expanded.
+    auto keep = [this, &within_range, check_filter](const Neighbor &nbr) {
+        return within_range(nbr) && (check_filter == nullptr || matches_label_filter(nbr.id, *check_filter));
+    };
+    if (!_pq_dist)
+    {
+        for (const auto &nbr : scored)
+            if (!nbr.expanded && nbr.id < _max_points && keep(nbr))
+                results.push_back(nbr);
+    }
+    else
+    {
+        // The walk ran on compressed vectors; the range is checked on full ones.
+        std::vector<uint32_t> &ids = scratch->id_scratch();
+        ids.clear();
+        for (const auto &nbr : scored)
+            if (!nbr.expanded && nbr.id < _max_points)
+                ids.push_back(nbr.id);
+        std::vector<float> dists(ids.size());
+        _data_store->get_distance(scratch->aligned_query(), ids.data(), (uint32_t)ids.size(), dists.data(), scratch);
+        retval.second += (uint32_t)ids.size();
+        for (size_t i = 0; i < ids.size(); i++)
+            if (keep(Neighbor(ids[i], dists[i])))
+                results.emplace_back(ids[i], dists[i]);
+    }
+    return retval;
+}
+
+template <typename T, typename TagT, typename LabelT>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::range_search_points(InMemQueryScratch<T> *scratch,
+                                                                          const T *query, const float radius,
+                                                                          const LabelFilter<LabelT> *filter,
+                                                                          const uint32_t min_l_search,
+                                                                          const uint32_t max_l_search,
+                                                                          QueryStats *stats)
+{
+    if (min_l_search == 0 || min_l_search > max_l_search)
+    {
+        throw ANNException("Range search needs 0 < min_l_search <= max_l_search", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+    if (filter != nullptr && filter->empty())
+    {
+        throw ANNException("Label filter has no clauses", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    const std::vector<LabelT> anchors = filter != nullptr ? filter->anchor_labels() : std::vector<LabelT>();
+    std::vector<uint32_t> init_ids = get_init_ids();
+
+    bool found_start = false;
+    if (filter != nullptr)
+    {
+        std::shared_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
+        if (_dynamic_index)
+            tl.lock();
+        for (const auto label : anchors)
+        {
+            if (_label_to_start_id.find(label) != _label_to_start_id.end())
+            {
+                init_ids.emplace_back(_label_to_start_id[label]);
+                found_start = true;
+            }
+        }
+    }
+
+    // Planned as search_with_filters plans a search with L = max_l_search,
+    // since the walk may grow to that list size; an unrestricted walk scales
+    // both list sizes.
+    FilterPlan plan = FilterPlan::None;
+    uint32_t search_L = min_l_search;
+    uint32_t max_L = max_l_search;
+    if (filter != nullptr && _dynamic_index)
+    {
+        plan = found_start ? FilterPlan::Graph : FilterPlan::PostFilter;
+        if (!found_start)
+        {
+            search_L = min_l_search * defaults::FILTER_POST_FILTER_MAX_EXPANSION;
+            max_L = max_l_search * defaults::FILTER_POST_FILTER_MAX_EXPANSION;
+        }
+    }
+    else if (filter != nullptr)
+    {
+        const size_t estimated_matches = estimate_filter_matches(*filter);
+        plan = plan_filtered_search(estimated_matches, _nd, max_l_search, _graph_store->get_max_observed_degree(),
+                                    found_start);
+        if (plan == FilterPlan::PostFilter)
+        {
+            search_L = post_filter_list_size(estimated_matches, _nd, min_l_search);
+            max_L = post_filter_list_size(estimated_matches, _nd, max_l_search);
+        }
+    }
+
+    if (search_L > scratch->get_L())
+    {
+        diskann::cout << "Attempting to expand query scratch_space. Was created "
+                      << "with Lsize: " << scratch->get_L() << " but search L is: " << search_L << std::endl;
+        scratch->resize_for_new_L(search_L);
+        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+    }
+
+    _data_store->preprocess_query(query, scratch);
+    std::vector<Neighbor> &results = scratch->pool();
+    std::pair<uint32_t, uint32_t> retval;
+    if (plan == FilterPlan::Exact)
+    {
+        // The scan keeps the nearest max_l_search matching points.
+        retval = std::make_pair(0, scan_filtered_points(*filter, max_l_search, scratch));
+#ifdef EXEC_ENV_OLS
+        const float range = radius;
+#else
+        const float range = _dist_metric == diskann::Metric::INNER_PRODUCT ? -radius : radius;
+#endif
+        NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+        for (size_t i = 0; i < best_L_nodes.size() && best_L_nodes[i].distance <= range; i++)
+        {
+            if (best_L_nodes[i].id < _max_points)
+                results.push_back(best_L_nodes[i]);
+        }
+    }
+    else
+    {
+        // Nodes reached over the anchors match an OR of single labels already.
+        const bool check_filter =
+            plan == FilterPlan::PostFilter || (plan == FilterPlan::Graph && !filter->is_label_disjunction());
+        retval = range_iterate(scratch, radius, search_L, max_L, init_ids, plan == FilterPlan::Graph, anchors,
+                               check_filter ? filter : nullptr, results);
+    }
+    std::sort(results.begin(), results.end());
+
+    if (stats != nullptr)
+    {
+        stats->filter_plan = plan;
+        stats->n_hops = retval.first;
+        stats->n_cmps = retval.second;
+    }
+    return retval;
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::range_search(const T *query, const float radius, const uint32_t min_l_search,
+                                            const uint32_t max_l_search, std::vector<uint32_t> &indices,
+                                            std::vector<float> &distances, QueryStats *stats)
+{
+    return range_search_locations(query, radius, nullptr, min_l_search, max_l_search, indices, distances, stats);
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::range_search(const T *query, const float radius, const LabelFilter<LabelT> &filter,
+                                            const uint32_t min_l_search, const uint32_t max_l_search,
+                                            std::vector<uint32_t> &indices, std::vector<float> &distances,
+                                            QueryStats *stats)
+{
+    return range_search_locations(query, radius, &filter, min_l_search, max_l_search, indices, distances, stats);
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::range_search_locations(const T *query, const float radius,
+                                                      const LabelFilter<LabelT> *filter, const uint32_t min_l_search,
+                                                      const uint32_t max_l_search, std::vector<uint32_t> &indices,
+                                                      std::vector<float> &distances, QueryStats *stats)
+{
+    auto &metrics = InMemoryIndexMetrics::get();
+    diskann::Timer query_timer;
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    metrics.scratch_wait.record(query_timer.elapsed());
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    range_search_points(scratch, query, radius, filter, min_l_search, max_l_search, stats);
+
+    indices.clear();
+    distances.clear();
+    for (const auto &nbr : scratch->pool())
+    {
+        indices.push_back(nbr.id);
+#ifdef EXEC_ENV_OLS
+        // DLVS expects negative distances
+        distances.push_back(nbr.distance);
+#else
+        distances.push_back(_dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * nbr.distance : nbr.distance);
+#endif
+    }
+
+    if (stats != nullptr)
+        stats->total_us = (float)query_timer.elapsed();
+    metrics.queries.add();
+    metrics.query_latency.record(query_timer.elapsed());
+    return indices.size();
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::range_search_with_tags(const T *query, const float radius,
+                                                      const uint32_t min_l_search, const uint32_t max_l_search,
+                                                      std::vector<TagT> &tags, std::vector<float> &distances,
+                                                      QueryStats *stats)
+{
+    auto &metrics = InMemoryIndexMetrics::get();
+    diskann::Timer query_timer;
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    metrics.scratch_wait.record(query_timer.elapsed());
+
+    std::shared_lock<std::shared_timed_mutex> ul(_update_lock);
+    range_search_points(scratch, query, radius, nullptr, min_l_search, max_l_search, stats);
+
+    std::shared_lock<std::shared_timed_mutex> tl(_tag_lock);
+
+    tags.clear();
+    distances.clear();
+    for (const auto &nbr : scratch->pool())
+    {
+        TagT tag;
+        if (_location_to_tag.try_get(nbr.id, tag))
+        {
+            tags.push_back(tag);
+#ifdef EXEC_ENV_OLS
+            distances.push_back(nbr.distance); // DLVS expects negative distances
+#else
+            distances.push_back(_dist_metric == INNER_PRODUCT ? -1 * nbr.distance : nbr.distance);
+#endif
+        }
+    }
+
+    if (stats != nullptr)
+        stats->total_us = (float)query_timer.elapsed();
+    metrics.queries.add();
+    metrics.query_latency.record(query_timer.elapsed());
+    return tags.size();
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::_search_with_tags(const DataType &query, const uint64_t K, const uint32_t L,
+                                                 const TagType &tags, float *distances, DataVector &res_vectors,
+                                                 bool use_filters, const std::string filter_label)
+{
+    try
+    {
+        return this->search_with_tags(std::any_cast<const T *>(query), K, L, std::any_cast<TagT *>(tags), distances,
+                                      res_vectors.get<std::vector<T *>>(), use_filters, filter_label);
     }
     catch (const std::bad_any_cast &e)
     {
@@ -2150,8 +3004,15 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
     {
         throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
+    auto &metrics = InMemoryIndexMetrics::get();
+    diskann::Timer query_timer;
+    QueryTrace *trace = _query_tracer != nullptr ? _query_tracer->begin_query() : nullptr;
+
     ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
     auto scratch = manager.scratch_space();
+    metrics.scratch_wait.record(query_timer.elapsed());
+    if (trace != nullptr)
+        trace->scratch_wait_us = trace->elapsed_us();
 
     if (L > scratch->get_L())
     {
@@ -2171,14 +3032,14 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
     if (!use_filters)
     {
         const std::vector<LabelT> unused_filter_label;
-        iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true);
+        iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true, trace);
     }
     else
     {
         std::vector<LabelT> filter_vec;
         auto converted_label = this->get_converted_label(filter_label);
         filter_vec.push_back(converted_label);
-        iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true);
+        iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true, trace);
     }
 
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
@@ -2216,6 +3077,10 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
         }
     }
 
+    metrics.queries.add();
+    metrics.query_latency.record(query_timer.elapsed());
+    if (trace != nullptr)
+        _query_tracer->end_query(trace);
     return pos;
 }
 
@@ -2396,8 +3261,13 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
     }
 
     std::unique_lock<std::shared_timed_mutex> update_lock(_update_lock, std::defer_lock);
+    // Inserts go on during a concurrent consolidation, but do not add frozen
+    // points while it walks the graph.
+    std::shared_lock<std::shared_timed_mutex> shared_update_lock(_update_lock, std::defer_lock);
     if (!_conc_consolidate)
         update_lock.lock();
+    else if (_filtered_index)
+        shared_update_lock.lock();
 
     std::unique_lock<std::shared_timed_mutex> cl(_consolidate_lock, std::defer_lock);
     if (!cl.try_lock())
@@ -2419,6 +3289,19 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
         throw diskann::ANNException("ERROR: start node has been deleted", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
+    // Label starts replaced since the last consolidation are unlinked with the
+    // deleted points and then returned to the free frozen points.
+    std::vector<uint32_t> retired_frozen_pts;
+    {
+        std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+        std::swap(_retired_frozen_pts, retired_frozen_pts);
+    }
+    for (auto &location : retired_frozen_pts)
+    {
+        location += (uint32_t)_max_points;
+        old_delete_set->insert(location);
+    }
+
     const uint32_t range = params.max_degree;
     const uint32_t maxc = params.max_occlusion_size;
     const float alpha = params.alpha;
@@ -2439,6 +3322,8 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
     }
     for (int64_t loc = _max_points; loc < (int64_t)(_max_points + _num_frozen_pts); loc++)
     {
+        if (old_delete_set->find((uint32_t)loc) != old_delete_set->end())
+            continue;
         ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
         auto scratch = manager.scratch_space();
         process_delete(*old_delete_set, loc, range, maxc, alpha, scratch);
@@ -2446,6 +3331,13 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
     }
 
     std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+    for (const auto location : retired_frozen_pts)
+    {
+        old_delete_set->erase(location);
+        release_frozen_point(location);
+    }
+    if (_filtered_index)
+        consolidate_label_starts(*old_delete_set);
     size_t ret_nd = release_locations(*old_delete_set);
     size_t max_points = _max_points;
     size_t empty_slots_size = _empty_slots.size();
@@ -2458,8 +3350,16 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
     {
         update_lock.unlock();
     }
+    else if (_filtered_index)
+    {
+        shared_update_lock.unlock();
+    }
+
+    const long long duration_us = timer.elapsed();
+    InMemoryIndexMetrics::get().consolidations.add();
+    InMemoryIndexMetrics::get().consolidation_duration.record(duration_us);
 
-    double duration = timer.elapsed() / 1000000.0;
+    double duration = duration_us / 1000000.0;
     diskann::cout << " done in " << duration << " seconds." << std::endl;
     return consolidation_report(diskann::consolidation_report::status_code::SUCCESS, ret_nd, max_points,
                                 empty_slots_size, old_delete_set_size, delete_set_size, num_calls_to_process_delete,
@@ -2475,12 +3375,11 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
 
         if (_filtered_index && _dynamic_index)
         {
-            //  update medoid id's as frozen points are treated as medoid
+            //  update medoid id's of labels starting at frozen points
             for (auto &[label, medoid_id] : _label_to_start_id)
             {
-                /*  if (label == _universal_label)
-                      continue;*/
-                _label_to_start_id[label] = (uint32_t)_nd + (medoid_id - (uint32_t)_max_points);
+                if (medoid_id >= _max_points)
+                    medoid_id = (uint32_t)_nd + (medoid_id - (uint32_t)_max_points);
             }
         }
     }
@@ -2535,6 +3434,15 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         throw diskann::ANNException("ERROR: Start node deleted.", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
+    if (_filtered_index)
+    {
+        for (auto &[label, medoid_id] : _label_to_start_id)
+        {
+            if (new_location[medoid_id] != UINT32_MAX)
+                medoid_id = new_location[medoid_id];
+        }
+    }
+
     size_t num_dangling = 0;
     for (uint32_t old = 0; old < _max_points + _num_frozen_pts; ++old)
     {
@@ -2570,6 +3478,7 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
                 if (_filtered_index)
                 {
                     _location_to_labels[new_location[old]].swap(_location_to_labels[old]);
+                    std::swap(_location_to_label_bits[new_location[old]], _location_to_label_bits[old]);
                 }
 
                 _data_store->copy_vectors(old, new_location[old], 1);
@@ -2603,6 +3512,7 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         for (size_t old = _nd; old < _max_points; old++)
         {
             _location_to_labels[old].clear();
+            _location_to_label_bits[old] = 0;
         }
     }
 
@@ -2677,6 +3587,325 @@ size_t Index<T, TagT, LabelT>::release_locations(const tsl::robin_set<uint32_t>
     return _nd;
 }
 
+template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, LabelT>::available_frozen_pts() const
+{
+    return _free_frozen_pts.size() + (_num_frozen_pts - _frozen_pts_used);
+}
+
+template <typename T, typename TagT, typename LabelT> uint32_t Index<T, TagT, LabelT>::claim_frozen_point()
+{
+    if (!_free_frozen_pts.empty())
+    {
+        const uint32_t offset = _free_frozen_pts.back();
+        _free_frozen_pts.pop_back();
+        return (uint32_t)_max_points + offset;
+    }
+    if (_frozen_pts_used >= _num_frozen_pts)
+        throw ANNException("No frozen point left to claim", -1, __FUNCSIG__, __FILE__, __LINE__);
+    return (uint32_t)(_max_points + _frozen_pts_used++);
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::grow_frozen_points(size_t num_new_pts)
+{
+    const size_t old_internal_points = _max_points + _num_frozen_pts;
+    const size_t new_internal_points = old_internal_points + num_new_pts;
+
+    _data_store->resize((location_t)new_internal_points);
+    _graph_store->resize_graph(new_internal_points);
+    _locks = std::vector<non_recursive_mutex>(new_internal_points);
+    if (_filtered_index)
+    {
+        _location_to_labels.resize(new_internal_points);
+        _location_to_label_bits.resize(new_internal_points, 0);
+    }
+    _num_frozen_pts += num_new_pts;
+    // Spare points copy _start and link to it, so a search reaching one before
+    // it is claimed does not stall.
+    std::vector<location_t> bridge = {(location_t)_start};
+    for (size_t location = old_internal_points; location < new_internal_points; location++)
+    {
+        _data_store->copy_vectors((location_t)_start, (location_t)location, 1);
+        _graph_store->set_neighbours((location_t)location, bridge);
+    }
+
+    diskann::cout << "Grew frozen points to " << _num_frozen_pts << std::endl;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::reserve_frozen_points(const std::function<size_t()> &needed,
+                                                   std::shared_lock<std::shared_timed_mutex> &shared_ul)
+{
+    for (;;)
+    {
+        {
+            std::shared_lock<std::shared_timed_mutex> tl(_tag_lock);
+            if (needed() <= available_frozen_pts())
+                return;
+        }
+
+        shared_ul.unlock();
+        {
+            std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+            std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+            std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+            const size_t num_needed = needed(), num_available = available_frozen_pts();
+            if (num_needed > num_available)
+            {
+                const size_t growth = (size_t)(_num_frozen_pts * (INDEX_GROWTH_FACTOR - 1));
+                grow_frozen_points((std::max)(num_needed - num_available, growth));
+            }
+        }
+        shared_ul.lock();
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::count_new_labels(const std::vector<LabelT> &labels) const
+{
+    size_t num_new_labels = 0;
+    for (size_t i = 0; i < labels.size(); i++)
+        if (_labels.find(labels[i]) == _labels.end() &&
+            std::find(labels.begin(), labels.begin() + i, labels[i]) == labels.begin() + i)
+            num_new_labels++;
+    return num_new_labels;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::add_label_start(const LabelT label, const T *point)
+{
+    // The first point is the only one known; refresh_label_start moves the
+    // start to the mean as the label grows.
+    const uint32_t location = claim_frozen_point();
+    _labels.insert(label);
+    _label_to_start_id[label] = location;
+    _label_means[label] = LabelMean();
+    _location_to_labels[location] = {label};
+    _location_to_label_bits[location] = label_bitmap(_location_to_labels[location]);
+    _data_store->set_vector((location_t)location, point);
+    std::vector<location_t> bridge = {(location_t)_start};
+    _graph_store->set_neighbours((location_t)location, bridge);
+}
+
+template <typename T, typename TagT, typename LabelT>
+std::vector<LabelT> Index<T, TagT, LabelT>::update_label_means(const uint32_t location, const float sign,
+                                                               const T *point)
+{
+    std::vector<LabelT> due;
+    std::vector<T> stored;
+    if (point == nullptr)
+    {
+        stored.resize(_data_store->get_aligned_dim());
+        _data_store->get_vector((location_t)location, stored.data());
+        point = stored.data();
+    }
+    for (const auto label : _location_to_labels[location])
+    {
+        auto mean = _label_means.find(label);
+        if (mean == _label_means.end())
+            continue;
+        auto &sum = mean->second.sum;
+        sum.resize(_dim, 0.0f);
+        for (size_t d = 0; d < _dim; d++)
+            sum[d] += sign * (float)point[d];
+        mean->second.num_points += sign > 0 ? 1 : -1;
+        if (sign > 0 && mean->second.num_points >= mean->second.next_refresh)
+        {
+            mean->second.next_refresh *= 2;
+            due.push_back(label);
+        }
+    }
+    return due;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::label_mean_point(const LabelT label, T *point) const
+{
+    const auto &mean = _label_means.at(label);
+    for (size_t d = 0; d < _dim; d++)
+    {
+        const float value = mean.sum[d] / (float)mean.num_points;
+        point[d] = std::is_floating_point<T>::value ? (T)value : (T)std::round(value);
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::refresh_label_start(const LabelT label, InMemQueryScratch<T> *scratch)
+{
+    std::vector<T> mean_point(_dim);
+    std::vector<uint32_t> init_ids;
+    {
+        std::shared_lock<std::shared_timed_mutex> tl(_tag_lock);
+        auto mean = _label_means.find(label);
+        if (mean == _label_means.end() || mean->second.num_points <= 0)
+            return;
+        label_mean_point(label, mean_point.data());
+        init_ids.push_back(_label_to_start_id[label]);
+    }
+
+    // The start moves to the point of label nearest to the mean, found by a
+    // filtered search from the current start.
+    const std::vector<LabelT> filter_labels = {label};
+    scratch->clear();
+    _data_store->preprocess_query(mean_point.data(), scratch);
+    iterate_to_fixed_point(scratch, _filterIndexingQueueSize, init_ids, true, filter_labels, true);
+
+    std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+    std::shared_lock<std::shared_timed_mutex> dl(_delete_lock);
+    auto start = _label_to_start_id.find(label);
+    if (start == _label_to_start_id.end())
+        return;
+    auto &best_L_nodes = scratch->best_l_nodes();
+    for (size_t i = 0; i < best_L_nodes.size(); i++)
+    {
+        const uint32_t id = best_L_nodes[i].id;
+        if (id < _max_points && _delete_set->find(id) == _delete_set->end())
+        {
+            if (id != start->second)
+            {
+                retire_label_start(start->second);
+                start->second = id;
+            }
+            return;
+        }
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::retire_label_start(const uint32_t location)
+{
+    // Starts on data points come from a build; _start stays in use as the
+    // start of unfiltered searches.
+    if (location >= _max_points && location != _start)
+        _retired_frozen_pts.push_back(location - (uint32_t)_max_points);
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::release_frozen_point(const uint32_t location)
+{
+    std::vector<location_t> bridge = {(location_t)_start};
+    _data_store->copy_vectors((location_t)_start, (location_t)location, 1);
+    _graph_store->set_neighbours((location_t)location, bridge);
+    if (_filtered_index)
+    {
+        _location_to_labels[location].clear();
+        _location_to_label_bits[location] = 0;
+    }
+    _free_frozen_pts.push_back(location - (uint32_t)_max_points);
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::consolidate_label_starts(const tsl::robin_set<uint32_t> &deleted)
+{
+    for (const auto location : deleted)
+        if (location < _max_points)
+            update_label_means(location, -1.0f);
+
+    std::vector<LabelT> removed, moved;
+    for (const auto &[label, mean] : _label_means)
+    {
+        const uint32_t start = _label_to_start_id[label];
+        if (mean.num_points <= 0)
+            removed.push_back(label);
+        else if (start < _max_points && deleted.find(start) != deleted.end())
+            moved.push_back(label);
+    }
+
+    for (const auto label : removed)
+    {
+        retire_label_start(_label_to_start_id[label]);
+        _label_to_start_id.erase(label);
+        _label_means.erase(label);
+        _labels.erase(label);
+    }
+
+    // A start on a deleted data point moves to the remaining point of its
+    // label closest to the label's mean, found as in refresh_label_start by a
+    // filtered search from the old start, whose edges are still in place. The
+    // points of the label are scanned only if the search finds none of them.
+    std::vector<T> point(_dim);
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    for (const auto label : moved)
+    {
+        label_mean_point(label, point.data());
+        const uint32_t old_start = _label_to_start_id[label];
+        const std::vector<LabelT> filter_labels = {label};
+        scratch->clear();
+        _data_store->preprocess_query(point.data(), scratch);
+        iterate_to_fixed_point(scratch, _filterIndexingQueueSize, {old_start}, true, filter_labels, true);
+
+        uint32_t best = old_start;
+        auto &best_L_nodes = scratch->best_l_nodes();
+        for (size_t i = 0; i < best_L_nodes.size(); i++)
+        {
+            const uint32_t id = best_L_nodes[i].id;
+            if (id < _max_points && deleted.find(id) == deleted.end())
+            {
+                best = id;
+                break;
+            }
+        }
+
+        if (best == old_start)
+        {
+            float best_dist = std::numeric_limits<float>::max();
+            for (uint32_t location = 0; location < _max_points; location++)
+            {
+                if (_empty_slots.is_in_set(location) || deleted.find(location) != deleted.end() ||
+                    !std::binary_search(_location_to_labels[location].begin(), _location_to_labels[location].end(),
+                                        label))
+                    continue;
+                const float dist = _data_store->get_distance(scratch->aligned_query(), (location_t)location);
+                if (dist < best_dist)
+                {
+                    best = location;
+                    best_dist = dist;
+                }
+            }
+        }
+        _label_to_start_id[label] = best;
+    }
+
+    if (!removed.empty() || !moved.empty())
+        diskann::cout << "Removed " << removed.size() << " label(s) without points, moved the start of "
+                      << moved.size() << " label(s) off deleted points" << std::endl;
+}
+
+template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::rebuild_label_starts()
+{
+    _label_means.clear();
+    _free_frozen_pts.clear();
+    _retired_frozen_pts.clear();
+    if (_num_frozen_pts == 0)
+        return;
+
+    std::vector<bool> used(_num_frozen_pts, false);
+    used[_start - _max_points] = true;
+    _frozen_pts_used = 0;
+    for (const auto &[label, start] : _label_to_start_id)
+    {
+        _label_means[label] = LabelMean();
+        if (start >= _max_points)
+        {
+            used[start - _max_points] = true;
+            _frozen_pts_used = (std::max)(_frozen_pts_used, (size_t)(start - _max_points) + 1);
+        }
+    }
+    // Claimed points that are no longer starts may still be linked from the
+    // graph, so they are unlinked by the next consolidation before reuse.
+    for (uint32_t offset = 0; offset < _frozen_pts_used; offset++)
+        if (!used[offset])
+            _retired_frozen_pts.push_back(offset);
+
+    for (uint32_t location = 0; location < _max_points; location++)
+        if (!_empty_slots.is_in_set(location) && _delete_set->find(location) == _delete_set->end())
+            update_label_means(location, 1.0f);
+    for (auto &label_mean : _label_means)
+        while (label_mean.second.next_refresh <= label_mean.second.num_points)
+            label_mean.second.next_refresh *= 2;
+}
+
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::reposition_points(uint32_t old_location_start, uint32_t new_location_start,
                                                uint32_t num_locations)
@@ -2723,6 +3952,8 @@ void Index<T, TagT, LabelT>::reposition_points(uint32_t old_location_start, uint
             {
                 _location_to_labels[new_location_start + loc_offset].swap(
                     _location_to_labels[old_location_start + loc_offset]);
+                std::swap(_location_to_label_bits[new_location_start + loc_offset],
+                          _location_to_label_bits[old_location_start + loc_offset]);
             }
         }
         // If ranges are overlapping, make sure not to clear the newly copied
@@ -2745,6 +3976,8 @@ void Index<T, TagT, LabelT>::reposition_points(uint32_t old_location_start, uint
             {
                 _location_to_labels[new_location_start + loc_offset - 1u].swap(
                     _location_to_labels[old_location_start + loc_offset - 1u]);
+                std::swap(_location_to_label_bits[new_location_start + loc_offset - 1u],
+                          _location_to_label_bits[old_location_start + loc_offset - 1u]);
             }
         }
 
@@ -2778,9 +4011,8 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     {
         for (auto &[label, medoid_id] : _label_to_start_id)
         {
-            /*if (label == _universal_label)
-                continue;*/
-            _label_to_start_id[label] = (uint32_t)_max_points + (medoid_id - (uint32_t)_nd);
+            if (medoid_id >= _nd)
+                medoid_id = (uint32_t)_max_points + (medoid_id - (uint32_t)_nd);
         }
     }
 }
@@ -2794,11 +4026,25 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     _data_store->resize((location_t)new_internal_points);
     _graph_store->resize_graph(new_internal_points);
     _locks = std::vector<non_recursive_mutex>(new_internal_points);
+    if (_dynamic_index && _filtered_index)
+    {
+        _location_to_labels.resize((std::max)(new_internal_points, _location_to_labels.size()));
+        _location_to_label_bits.resize((std::max)(new_internal_points, _location_to_label_bits.size()), 0);
+    }
 
     if (_num_frozen_pts != 0)
     {
         reposition_points((uint32_t)_max_points, (uint32_t)new_max_points, (uint32_t)_num_frozen_pts);
         _start = (uint32_t)new_max_points;
+
+        if (_dynamic_index && _filtered_index)
+        {
+            for (auto &[label, medoid_id] : _label_to_start_id)
+            {
+                if (medoid_id >= _max_points)
+                    medoid_id = (uint32_t)new_max_points + (medoid_id - (uint32_t)_max_points);
+            }
+        }
     }
 
     _max_points = new_max_points;
@@ -2857,6 +4103,7 @@ int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag)
 template <typename T, typename TagT, typename LabelT>
 int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag, const std::vector<LabelT> &labels)
 {
+    diskann::Timer insert_timer;
 
     assert(_has_built);
     if (tag == 0)
@@ -2867,85 +4114,87 @@ int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag, const s
                                     -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
-    std::shared_lock<std::shared_timed_mutex> shared_ul(_update_lock);
-    std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
-    std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
-
-    auto location = reserve_location();
-    if (_filtered_index)
+    if (_filtered_index && labels.empty())
     {
-        if (labels.empty())
-        {
-            release_location(location);
-            std::cerr << "Error: Can't insert point with tag " + get_tag_string(tag) +
-                             " . there are no labels for the point."
-                      << std::endl;
-            return -1;
-        }
+        std::cerr << "Error: Can't insert point with tag " + get_tag_string(tag) +
+                         " . there are no labels for the point."
+                  << std::endl;
+        return -1;
+    }
 
-        _location_to_labels[location] = labels;
+    std::shared_lock<std::shared_timed_mutex> shared_ul(_update_lock, std::defer_lock);
+    std::unique_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
+    std::unique_lock<std::shared_timed_mutex> dl(_delete_lock, std::defer_lock);
 
-        for (LabelT label : labels)
+    int location;
+    for (;;)
+    {
+        shared_ul.lock();
+        if (_filtered_index)
+            reserve_frozen_points([&]() { return count_new_labels(labels); }, shared_ul);
+        tl.lock();
+        dl.lock();
+
+        location = reserve_location();
+        if (location == -1)
         {
-            if (_labels.find(label) == _labels.end())
+#if EXPAND_IF_FULL
+            dl.unlock();
+            tl.unlock();
+            shared_ul.unlock();
+
             {
-                if (_frozen_pts_used >= _num_frozen_pts)
+                std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+                tl.lock();
+                dl.lock();
+
+                if (_nd >= _max_points)
                 {
-                    throw ANNException(
-                        "Error: For dynamic filtered index, the number of frozen points should be atleast equal "
-                        "to number of unique labels.",
-                        -1);
+                    auto new_max_points = (size_t)(_max_points * INDEX_GROWTH_FACTOR);
+                    resize(new_max_points);
                 }
 
-                auto fz_location = (int)(_max_points) + _frozen_pts_used; // as first _fz_point
-                _labels.insert(label);
-                _label_to_start_id[label] = (uint32_t)fz_location;
-                _location_to_labels[fz_location] = {label};
-                _data_store->set_vector((location_t)fz_location, point);
-                _frozen_pts_used++;
+                dl.unlock();
+                tl.unlock();
+                ul.unlock();
             }
-        }
-    }
-
-    if (location == -1)
-    {
-#if EXPAND_IF_FULL
-        dl.unlock();
-        tl.unlock();
-        shared_ul.unlock();
 
-        {
-            std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+            shared_ul.lock();
             tl.lock();
             dl.lock();
 
-            if (_nd >= _max_points)
+            location = reserve_location();
+            if (location == -1)
             {
-                auto new_max_points = (size_t)(_max_points * INDEX_GROWTH_FACTOR);
-                resize(new_max_points);
+                throw diskann::ANNException("Cannot reserve location even after "
+                                            "expanding graph. Terminating.",
+                                            -1, __FUNCSIG__, __FILE__, __LINE__);
             }
+#else
+            return -1;
+#endif
+        } // cant insert as active pts >= max_pts
+        dl.unlock();
 
-            dl.unlock();
-            tl.unlock();
-            ul.unlock();
-        }
+        // Another insert may have claimed the frozen points reserved above.
+        if (!_filtered_index || count_new_labels(labels) <= available_frozen_pts())
+            break;
+        release_location(location);
+        tl.unlock();
+        shared_ul.unlock();
+    }
 
-        shared_ul.lock();
-        tl.lock();
-        dl.lock();
+    if (_filtered_index)
+    {
+        // Matching walks sorted label lists.
+        _location_to_labels[location] = labels;
+        std::sort(_location_to_labels[location].begin(), _location_to_labels[location].end());
+        _location_to_label_bits[location] = label_bitmap(labels);
 
-        location = reserve_location();
-        if (location == -1)
-        {
-            throw diskann::ANNException("Cannot reserve location even after "
-                                        "expanding graph. Terminating.",
-                                        -1, __FUNCSIG__, __FILE__, __LINE__);
-        }
-#else
-        return -1;
-#endif
-    } // cant insert as active pts >= max_pts
-    dl.unlock();
+        for (LabelT label : labels)
+            if (_labels.find(label) == _labels.end())
+                add_label_start(label, point);
+    }
 
     // Insert tag and mapping to location
     if (_enable_tags)
@@ -2960,6 +4209,12 @@ int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag, const s
         _tag_to_location[tag] = location;
         _location_to_tag.set(location, tag);
     }
+
+    // Counted now rather than after linking so that a concurrent consolidation
+    // never drops the label of a point that is still being inserted.
+    std::vector<LabelT> due_labels;
+    if (_filtered_index)
+        due_labels = update_label_means(location, 1.0f, point);
     tl.unlock();
 
     _data_store->set_vector(location, point); // update datastore
@@ -3004,6 +4259,11 @@ int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag, const s
 
     inter_insert(location, pruned_list, scratch);
 
+    for (const auto label : due_labels)
+        refresh_label_start(label, scratch);
+
+    InMemoryIndexMetrics::get().inserts.add();
+    InMemoryIndexMetrics::get().insert_latency.record(insert_timer.elapsed());
     return 0;
 }
 
@@ -3054,6 +4314,7 @@ template <typename T, typename TagT, typename LabelT> int Index<T, TagT, LabelT>
     _delete_set->insert(location);
     _location_to_tag.erase(location);
     _tag_to_location.erase(tag);
+    InMemoryIndexMetrics::get().deletes.add();
     return 0;
 }
 
@@ -3083,6 +4344,7 @@ void Index<T, TagT, LabelT>::lazy_delete(const std::vector<TagT> &tags, std::vec
             _tag_to_location.erase(tag);
         }
     }
+    InMemoryIndexMetrics::get().deletes.add(tags.size() - failed_tags.size());
 }
 
 template <typename T, typename TagT, typename LabelT> bool Index<T, TagT, LabelT>::is_index_saved()
@@ -3418,6 +4680,44 @@ template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t,
     uint32_t>(const int8_t *query, const uint32_t &filter_label, const size_t K, const uint32_t L, uint32_t *indices,
               float *distances);
 
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+// TagT==uint32_t
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances, QueryStats *stats);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances, QueryStats *stats);
+
 template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint16_t>::search<uint64_t>(
     const float *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances);
 template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint16_t>::search<uint32_t>(
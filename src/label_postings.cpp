@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+
+#include "ann_exception.h"
+#include "label_postings.h"
+
+namespace diskann
+{
+namespace
+{
+void encode_varint(uint32_t value, std::vector<uint8_t> &out)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+uint32_t decode_varint(const uint8_t *&pos)
+{
+    uint32_t value = 0;
+    for (uint32_t shift = 0;; shift += 7)
+    {
+        const uint8_t byte = *pos++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return value;
+    }
+}
+} // namespace
+
+template <typename LabelT> void LabelPostings<LabelT>::add(const uint32_t point_id, const LabelT label)
+{
+    List &list = _lists[label];
+    if (list.count > 0 && point_id <= list.last)
+    {
+        if (point_id == list.last)
+            return;
+        throw ANNException("Label postings must be built in increasing point order", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+    encode_varint(list.count == 0 ? point_id : point_id - list.last, _pending[label]);
+    list.last = point_id;
+    list.count++;
+}
+
+template <typename LabelT> void LabelPostings<LabelT>::finalize()
+{
+    size_t total_bytes = _buffer.size();
+    for (const auto &pending : _pending)
+        total_bytes += pending.second.size();
+    _buffer.reserve(total_bytes);
+    for (auto &pending : _pending)
+    {
+        _lists[pending.first].offset = _buffer.size();
+        _buffer.insert(_buffer.end(), pending.second.begin(), pending.second.end());
+    }
+    _pending.clear();
+}
+
+template <typename LabelT> void LabelPostings<LabelT>::clear()
+{
+    _lists.clear();
+    _pending.clear();
+    _buffer.clear();
+}
+
+template <typename LabelT> uint32_t LabelPostings<LabelT>::count(const LabelT label) const
+{
+    auto iter = _lists.find(label);
+    return iter == _lists.end() ? 0 : iter->second.count;
+}
+
+template <typename LabelT>
+void LabelPostings<LabelT>::decode(const LabelT label, std::vector<uint32_t> &out, const size_t max_points) const
+{
+    auto iter = _lists.find(label);
+    if (iter == _lists.end())
+        return;
+    const size_t n = std::min<size_t>(iter->second.count, max_points);
+    const uint8_t *pos = _buffer.data() + iter->second.offset;
+    uint32_t point_id = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        point_id += decode_varint(pos);
+        out.push_back(point_id);
+    }
+}
+
+template <typename LabelT> size_t LabelPostings<LabelT>::num_labels() const
+{
+    return _lists.size();
+}
+
+template <typename LabelT> std::vector<LabelT> LabelPostings<LabelT>::labels() const
+{
+    std::vector<LabelT> out;
+    out.reserve(_lists.size());
+    for (const auto &list : _lists)
+        out.push_back(list.first);
+    return out;
+}
+
+template <typename LabelT> size_t LabelPostings<LabelT>::encoded_bytes() const
+{
+    return _buffer.size();
+}
+
+template class LabelPostings<uint16_t>;
+template class LabelPostings<uint32_t>;
+} // namespace diskann
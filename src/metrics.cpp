@@ -0,0 +1,234 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+#include "metrics.h"
+
+namespace diskann
+{
+namespace
+{
+uint32_t current_shard()
+{
+    static std::atomic<uint32_t> next_shard{0};
+    thread_local uint32_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % METRICS_NUM_SHARDS;
+    return shard;
+}
+
+uint32_t floor_log2(uint64_t value)
+{
+    uint32_t log = 0;
+    while (value >>= 1)
+        log++;
+    return log;
+}
+
+// Exact decimal, so that bucket boundaries keep their microsecond values.
+void write_seconds(std::ostream &out, const uint64_t micros)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%06llu", (unsigned long long)(micros / 1000000),
+             (unsigned long long)(micros % 1000000));
+    out << buf;
+}
+} // namespace
+
+void Counter::add(const uint64_t n)
+{
+    _shards[current_shard()].count.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t total = 0;
+    for (const auto &shard : _shards)
+        total += shard.count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint32_t Histogram::bucket_index(const uint64_t value)
+{
+    if (value < 16)
+        return (uint32_t)value;
+    const uint32_t log = floor_log2(value);
+    const uint32_t sub = (uint32_t)(value >> (log - 3)) & 7;
+    return 16 + (log - 4) * 8 + sub;
+}
+
+uint64_t Histogram::bucket_limit(const uint32_t index)
+{
+    if (index < 16)
+        return index + 1;
+    const uint32_t log = 4 + (index - 16) / 8;
+    const uint64_t sub = (index - 16) % 8;
+    if (log == 63 && sub == 7)
+        return std::numeric_limits<uint64_t>::max();
+    return ((8 + sub) << (log - 3)) + ((uint64_t)1 << (log - 3));
+}
+
+void Histogram::record(const uint64_t value)
+{
+    Shard &shard = _shards[current_shard()];
+    shard.buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const
+{
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < METRICS_NUM_SHARDS; s++)
+        total += _shards[s].count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t Histogram::sum() const
+{
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < METRICS_NUM_SHARDS; s++)
+        total += _shards[s].sum.load(std::memory_order_relaxed);
+    return total;
+}
+
+void Histogram::bucket_counts(uint64_t *counts) const
+{
+    std::fill(counts, counts + NUM_BUCKETS, 0);
+    for (uint32_t s = 0; s < METRICS_NUM_SHARDS; s++)
+        for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+            counts[b] += _shards[s].buckets[b].load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::quantile(const double q) const
+{
+    std::unique_ptr<uint64_t[]> counts(new uint64_t[NUM_BUCKETS]);
+    bucket_counts(counts.get());
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+        total += counts[b];
+    if (total == 0)
+        return 0;
+
+    const uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+            return bucket_limit(b) - 1;
+    }
+    return bucket_limit(NUM_BUCKETS - 1);
+}
+
+MetricsRegistry &MetricsRegistry::global()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &entry = _counters[name];
+    if (entry.metric == nullptr)
+    {
+        entry.help = help;
+        entry.metric.reset(new Counter());
+    }
+    return *entry.metric;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &entry = _histograms[name];
+    if (entry.metric == nullptr)
+    {
+        entry.help = help;
+        entry.metric.reset(new Histogram());
+    }
+    return *entry.metric;
+}
+
+void MetricsRegistry::write_prometheus(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &kv : _counters)
+    {
+        out << "# HELP " << kv.first << " " << kv.second.help << "\n";
+        out << "# TYPE " << kv.first << " counter\n";
+        out << kv.first << " " << kv.second.metric->value() << "\n";
+    }
+
+    std::unique_ptr<uint64_t[]> counts(new uint64_t[Histogram::NUM_BUCKETS]);
+    for (const auto &kv : _histograms)
+    {
+        const auto &name = kv.first;
+        kv.second.metric->bucket_counts(counts.get());
+        uint64_t total = 0;
+        for (uint32_t b = 0; b < Histogram::NUM_BUCKETS; b++)
+            total += counts[b];
+
+        out << "# HELP " << name << " " << kv.second.help << "\n";
+        out << "# TYPE " << name << " histogram\n";
+        // Cumulative counts at the power of two bucket limits. A limit is
+        // exclusive and values are whole microseconds, so the inclusive bound
+        // Prometheus expects is one less.
+        uint64_t cumulative = 0;
+        for (uint32_t b = 0; b < Histogram::NUM_BUCKETS; b++)
+        {
+            cumulative += counts[b];
+            const uint64_t limit = Histogram::bucket_limit(b);
+            if ((limit & (limit - 1)) != 0)
+                continue;
+            out << name << "_bucket{le=\"";
+            write_seconds(out, limit - 1);
+            out << "\"} " << cumulative << "\n";
+            if (limit >= ((uint64_t)1 << METRICS_EXPORT_MAX_LOG2))
+                break;
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << total << "\n";
+        out << name << "_sum ";
+        write_seconds(out, kv.second.metric->sum());
+        out << "\n" << name << "_count " << total << "\n";
+    }
+}
+
+std::string MetricsRegistry::prometheus_text() const
+{
+    std::stringstream ss;
+    write_prometheus(ss);
+    return ss.str();
+}
+
+InMemoryIndexMetrics &InMemoryIndexMetrics::get()
+{
+    auto &registry = MetricsRegistry::global();
+    static InMemoryIndexMetrics metrics{
+        registry.counter("diskann_memory_queries_total", "Searches served by in-memory indices"),
+        registry.counter("diskann_memory_inserts_total", "Points inserted into in-memory indices"),
+        registry.counter("diskann_memory_deletes_total", "Points lazily deleted from in-memory indices"),
+        registry.counter("diskann_memory_consolidations_total", "Completed consolidate_deletes calls"),
+        registry.histogram("diskann_memory_query_latency_seconds", "In-memory search latency"),
+        registry.histogram("diskann_memory_scratch_wait_seconds", "Time searches waited for a query scratch space"),
+        registry.histogram("diskann_memory_insert_latency_seconds", "In-memory insert_point latency"),
+        registry.histogram("diskann_memory_consolidation_duration_seconds", "Duration of consolidate_deletes")};
+    return metrics;
+}
+
+DiskIndexMetrics &DiskIndexMetrics::get()
+{
+    auto &registry = MetricsRegistry::global();
+    static DiskIndexMetrics metrics{
+        registry.counter("diskann_disk_queries_total", "Searches served by SSD indices"),
+        registry.counter("diskann_disk_ios_total", "Sector reads issued by SSD index searches"),
+        registry.counter("diskann_disk_cache_hits_total", "Node cache hits during SSD index searches"),
+        registry.histogram("diskann_disk_query_latency_seconds", "SSD index search latency"),
+        registry.histogram("diskann_disk_scratch_wait_seconds", "Time searches waited for a thread data scratch"),
+        registry.histogram("diskann_disk_io_latency_seconds", "Latency of each batch of sector reads")};
+    return metrics;
+}
+} // namespace diskann
@@ -10,6 +10,8 @@
 #include "math_utils.h"
 #include "tsl/robin_map.h"
 
+#include <future>
+
 // block size for reading/processing large files and matrices in blocks
 #define BLOCK_SIZE 5000000
 
@@ -845,6 +847,8 @@ int generate_pq_data_from_pivots_simplified(const float *data, const size_t num,
 // pq_compressed_vectors_path.
 // If the numbber of centers is < 256, it stores as byte vector, else as
 // 4-byte vector in binary format.
+// Reading the next block and writing the previous one overlap with encoding
+// of the current block.
 template <typename T>
 int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks,
                                  const std::string &pq_pivots_path, const std::string &pq_compressed_vectors_path,
@@ -948,40 +952,75 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
     std::memset(block_inflated_base.get(), 0, block_size * dim * sizeof(float));
 #endif
 
-    std::unique_ptr<uint32_t[]> block_compressed_base =
-        std::make_unique<uint32_t[]>(block_size * (size_t)num_pq_chunks);
-    std::memset(block_compressed_base.get(), 0, block_size * (size_t)num_pq_chunks * sizeof(uint32_t));
+    // codes are written in their on-disk width directly, one byte per chunk
+    // when num_centers <= 256 and four bytes otherwise.
+    const size_t code_size = num_centers > 256 ? sizeof(uint32_t) : sizeof(uint8_t);
 
-    std::unique_ptr<T[]> block_data_T = std::make_unique<T[]>(block_size * dim);
+    // the pivots of each chunk do not depend on the block, so slice them once.
+    std::vector<std::unique_ptr<float[]>> chunk_pivot_data(num_pq_chunks);
+    size_t max_chunk_size = 0;
+    for (size_t i = 0; i < num_pq_chunks; i++)
+    {
+        size_t cur_chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
+        max_chunk_size = (std::max)(max_chunk_size, cur_chunk_size);
+        if (cur_chunk_size == 0)
+            continue;
+        chunk_pivot_data[i] = std::make_unique<float[]>(num_centers * cur_chunk_size);
+        for (size_t j = 0; j < num_centers; j++)
+        {
+            std::memcpy(chunk_pivot_data[i].get() + j * cur_chunk_size,
+                        full_pivot_data.get() + j * dim + chunk_offsets[i], cur_chunk_size * sizeof(float));
+        }
+    }
+
+    // Three stage pipeline: block b+1 is read from disk and block b-1 is
+    // written out while block b is being encoded. Raw and compressed blocks
+    // are double buffered so the stages never touch the same memory.
+    std::unique_ptr<T[]> block_data_T[2] = {std::make_unique<T[]>(block_size * dim),
+                                            std::make_unique<T[]>(block_size * dim)};
+    std::unique_ptr<uint8_t[]> block_compressed_base[2] = {
+        std::make_unique<uint8_t[]>(block_size * (size_t)num_pq_chunks * code_size),
+        std::make_unique<uint8_t[]>(block_size * (size_t)num_pq_chunks * code_size)};
     std::unique_ptr<float[]> block_data_float = std::make_unique<float[]>(block_size * dim);
-    std::unique_ptr<float[]> block_data_tmp = std::make_unique<float[]>(block_size * dim);
+    std::unique_ptr<float[]> block_data_tmp = use_opq ? std::make_unique<float[]>(block_size * dim) : nullptr;
+    std::unique_ptr<float[]> cur_data = std::make_unique<float[]>(block_size * max_chunk_size);
+    std::unique_ptr<uint32_t[]> closest_center = std::make_unique<uint32_t[]>(block_size);
 
     size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
 
+    auto block_points = [&](size_t block) {
+        return (std::min)((block + 1) * block_size, num_points) - block * block_size;
+    };
+
+    std::future<void> read_task = std::async(std::launch::async, [&]() {
+        base_reader.read((char *)(block_data_T[0].get()), sizeof(T) * (block_points(0) * dim));
+    });
+    std::future<void> write_task;
+
     for (size_t block = 0; block < num_blocks; block++)
     {
         size_t start_id = block * block_size;
         size_t end_id = (std::min)((block + 1) * block_size, num_points);
         size_t cur_blk_size = end_id - start_id;
 
-        base_reader.read((char *)(block_data_T.get()), sizeof(T) * (cur_blk_size * dim));
-        diskann::convert_types<T, float>(block_data_T.get(), block_data_tmp.get(), cur_blk_size, dim);
-
-        diskann::cout << "Processing points  [" << start_id << ", " << end_id << ").." << std::flush;
-
-        for (size_t p = 0; p < cur_blk_size; p++)
+        read_task.get();
+        const T *cur_block_T = block_data_T[block % 2].get();
+        if (block + 1 < num_blocks)
         {
-            for (uint64_t d = 0; d < dim; d++)
-            {
-                block_data_tmp[p * dim + d] -= centroid[d];
-            }
+            read_task = std::async(std::launch::async, [&, block]() {
+                base_reader.read((char *)(block_data_T[(block + 1) % 2].get()),
+                                 sizeof(T) * (block_points(block + 1) * dim));
+            });
         }
 
-        for (size_t p = 0; p < cur_blk_size; p++)
+        diskann::cout << "Processing points  [" << start_id << ", " << end_id << ").." << std::flush;
+
+#pragma omp parallel for schedule(static, 8192)
+        for (int64_t p = 0; p < (int64_t)cur_blk_size; p++)
         {
             for (uint64_t d = 0; d < dim; d++)
             {
-                block_data_float[p * dim + d] = block_data_tmp[p * dim + d];
+                block_data_float[p * dim + d] = (float)cur_block_T[p * dim + d] - centroid[d];
             }
         }
 
@@ -995,62 +1034,53 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
             std::memcpy(block_data_float.get(), block_data_tmp.get(), cur_blk_size * dim * sizeof(float));
         }
 
+        uint8_t *cur_compressed = block_compressed_base[block % 2].get();
+
         for (size_t i = 0; i < num_pq_chunks; i++)
         {
             size_t cur_chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
             if (cur_chunk_size == 0)
                 continue;
 
-            std::unique_ptr<float[]> cur_pivot_data = std::make_unique<float[]>(num_centers * cur_chunk_size);
-            std::unique_ptr<float[]> cur_data = std::make_unique<float[]>(cur_blk_size * cur_chunk_size);
-            std::unique_ptr<uint32_t[]> closest_center = std::make_unique<uint32_t[]>(cur_blk_size);
-
 #pragma omp parallel for schedule(static, 8192)
             for (int64_t j = 0; j < (int64_t)cur_blk_size; j++)
             {
-                for (size_t k = 0; k < cur_chunk_size; k++)
-                    cur_data[j * cur_chunk_size + k] = block_data_float[j * dim + chunk_offsets[i] + k];
-            }
-
-#pragma omp parallel for schedule(static, 1)
-            for (int64_t j = 0; j < (int64_t)num_centers; j++)
-            {
-                std::memcpy(cur_pivot_data.get() + j * cur_chunk_size,
-                            full_pivot_data.get() + j * dim + chunk_offsets[i], cur_chunk_size * sizeof(float));
+                std::memcpy(cur_data.get() + j * cur_chunk_size, block_data_float.get() + j * dim + chunk_offsets[i],
+                            cur_chunk_size * sizeof(float));
             }
 
-            math_utils::compute_closest_centers(cur_data.get(), cur_blk_size, cur_chunk_size, cur_pivot_data.get(),
-                                                num_centers, 1, closest_center.get());
+            math_utils::compute_closest_centers(cur_data.get(), cur_blk_size, cur_chunk_size,
+                                                chunk_pivot_data[i].get(), num_centers, 1, closest_center.get());
 
 #pragma omp parallel for schedule(static, 8192)
             for (int64_t j = 0; j < (int64_t)cur_blk_size; j++)
             {
-                block_compressed_base[j * num_pq_chunks + i] = closest_center[j];
+                if (code_size == sizeof(uint8_t))
+                    cur_compressed[j * num_pq_chunks + i] = (uint8_t)closest_center[j];
+                else
+                    ((uint32_t *)cur_compressed)[j * num_pq_chunks + i] = closest_center[j];
 #ifdef SAVE_INFLATED_PQ
                 for (size_t k = 0; k < cur_chunk_size; k++)
                     block_inflated_base[j * dim + chunk_offsets[i] + k] =
-                        cur_pivot_data[closest_center[j] * cur_chunk_size + k] + centroid[chunk_offsets[i] + k];
+                        chunk_pivot_data[i][closest_center[j] * cur_chunk_size + k] + centroid[chunk_offsets[i] + k];
 #endif
             }
         }
 
-        if (num_centers > 256)
-        {
-            compressed_file_writer.write((char *)(block_compressed_base.get()),
-                                         cur_blk_size * num_pq_chunks * sizeof(uint32_t));
-        }
-        else
-        {
-            std::unique_ptr<uint8_t[]> pVec = std::make_unique<uint8_t[]>(cur_blk_size * num_pq_chunks);
-            diskann::convert_types<uint32_t, uint8_t>(block_compressed_base.get(), pVec.get(), cur_blk_size,
-                                                      num_pq_chunks);
-            compressed_file_writer.write((char *)(pVec.get()), cur_blk_size * num_pq_chunks * sizeof(uint8_t));
-        }
+        // at most one write is in flight, and it targets the other buffer.
+        if (write_task.valid())
+            write_task.get();
+        write_task = std::async(std::launch::async, [&compressed_file_writer, cur_compressed, cur_blk_size,
+                                                     num_pq_chunks, code_size]() {
+            compressed_file_writer.write((char *)cur_compressed, cur_blk_size * num_pq_chunks * code_size);
+        });
 #ifdef SAVE_INFLATED_PQ
         inflated_file_writer.write((char *)(block_inflated_base.get()), cur_blk_size * dim * sizeof(float));
 #endif
         diskann::cout << ".done." << std::endl;
     }
+    if (write_task.valid())
+        write_task.get();
 // Gopal. Splitting diskann_dll into separate DLLs for search and build.
 // This code should only be available in the "build" DLL.
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
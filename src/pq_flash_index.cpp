@@ -2,11 +2,13 @@
 // Licensed under the MIT license.
 
 #include "common_includes.h"
+#include <numeric>
 
 #include "timer.h"
 #include "pq.h"
 #include "pq_scratch.h"
 #include "pq_flash_index.h"
+#include "metrics.h"
 #include "cosine_similarity.h"
 
 #ifdef _WINDOWS
@@ -262,14 +264,16 @@ template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(MemoryMappedFiles &files, std::string sample_bin,
                                                                       uint64_t l_search, uint64_t beamwidth,
                                                                       uint64_t num_nodes_to_cache, uint32_t nthreads,
-                                                                      std::vector<uint32_t> &node_list)
+                                                                      std::vector<uint32_t> &node_list,
+                                                                      const std::vector<LabelT> &sample_labels)
 {
 #else
 template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(std::string sample_bin, uint64_t l_search,
                                                                       uint64_t beamwidth, uint64_t num_nodes_to_cache,
                                                                       uint32_t nthreads,
-                                                                      std::vector<uint32_t> &node_list)
+                                                                      std::vector<uint32_t> &node_list,
+                                                                      const std::vector<LabelT> &sample_labels)
 {
 #endif
     if (num_nodes_to_cache >= this->_num_points)
@@ -316,22 +320,40 @@ void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(std::strin
     std::vector<float> tmp_result_dists(sample_num, 0);
 
     bool filtered_search = false;
-    std::vector<LabelT> random_query_filters(sample_num);
-    if (_filter_to_medoid_ids.size() != 0)
+    std::vector<LabelT> query_filters(sample_num);
+    if (!sample_labels.empty())
     {
+        if (sample_labels.size() != 1 && sample_labels.size() != sample_num)
+        {
+            diskann::aligned_free(samples);
+            std::stringstream stream;
+            stream << "Got " << sample_labels.size() << " sample labels for " << sample_num
+                   << " sample queries; expected one or one per query.";
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
         filtered_search = true;
-        generate_random_labels(random_query_filters, (uint32_t)sample_num, nthreads);
+        for (uint64_t i = 0; i < sample_num; i++)
+            query_filters[i] = sample_labels[sample_labels.size() == 1 ? 0 : i];
+    }
+    else if (_filter_to_medoid_ids.size() != 0)
+    {
+        filtered_search = true;
+        generate_random_labels(query_filters, (uint32_t)sample_num, nthreads);
     }
 
 #pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads)
     for (int64_t i = 0; i < (int64_t)sample_num; i++)
     {
-        auto &label_for_search = random_query_filters[i];
+        auto &label_for_search = query_filters[i];
         // run a search on the sample query with a random label (sampled from base label distribution), and it will
         // concurrently update the node_visit_counter to track most visited nodes. The last false is to not use the
         // "use_reorder_data" option which enables a final reranking if the disk index itself contains only PQ data.
-        cached_beam_search(samples + (i * sample_aligned_dim), 1, l_search, tmp_result_ids_64.data() + i,
-                           tmp_result_dists.data() + i, beamwidth, filtered_search, label_for_search, false);
+        // The impl is called directly so that sample queries do not count as served queries.
+        const LabelFilter<LabelT> filter =
+            filtered_search ? LabelFilter<LabelT>(label_for_search) : LabelFilter<LabelT>();
+        cached_beam_search_impl(samples + (i * sample_aligned_dim), 1, l_search, tmp_result_ids_64.data() + i,
+                                tmp_result_dists.data() + i, beamwidth, filtered_search ? &filter : nullptr,
+                                std::numeric_limits<uint32_t>::max(), false, nullptr);
     }
 
     std::sort(this->_node_visit_counter.begin(), _node_visit_counter.end(),
@@ -348,6 +370,16 @@ void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(std::strin
     }
     this->_count_visited_nodes = false;
 
+    if (filtered_search)
+    {
+        std::unordered_map<LabelT, uint64_t> frequency;
+        for (const auto label : query_filters)
+            frequency[label]++;
+        diskann::cout << "Cache list of " << node_list.size() << " nodes from " << sample_num
+                      << " sample queries over " << frequency.size() << " labels ("
+                      << (sample_labels.empty() ? "drawn from the base labels" : "given") << ")" << std::endl;
+    }
+
     diskann::aligned_free(samples);
 }
 
@@ -499,6 +531,205 @@ void PQFlashIndex<T, LabelT>::cache_bfs_levels(uint64_t num_nodes_to_cache, std:
     diskann::cout << "done" << std::endl;
 }
 
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::cache_neighbourhood(const std::vector<uint32_t> &seeds, const uint64_t budget,
+                                                      const std::function<bool(uint32_t)> &admit,
+                                                      tsl::robin_set<uint32_t> &node_set)
+{
+    uint64_t added = 0;
+    tsl::robin_set<uint32_t> seen;
+    std::vector<uint32_t> level, next_level;
+    for (const uint32_t id : seeds)
+    {
+        if (added == budget)
+            break;
+        if (!seen.insert(id).second)
+            continue;
+        added += node_set.insert(id).second ? 1 : 0;
+        level.push_back(id);
+    }
+
+    const size_t BLOCK_SIZE = 1024;
+    std::vector<uint32_t> nbr_buf(BLOCK_SIZE * (_max_degree + 1));
+    while (added < budget && !level.empty())
+    {
+        next_level.clear();
+        for (size_t start = 0; start < level.size() && added < budget; start += BLOCK_SIZE)
+        {
+            const size_t end = (std::min)(start + BLOCK_SIZE, level.size());
+            std::vector<uint32_t> nodes_to_read(level.begin() + start, level.begin() + end);
+            std::vector<T *> coord_buffers(end - start, nullptr);
+            std::vector<std::pair<uint32_t, uint32_t *>> nbr_buffers;
+            for (size_t i = 0; i < end - start; i++)
+                nbr_buffers.emplace_back(0, nbr_buf.data() + i * (_max_degree + 1));
+
+            auto read_status = read_nodes(nodes_to_read, coord_buffers, nbr_buffers);
+            for (size_t i = 0; i < read_status.size() && added < budget; i++)
+            {
+                if (!read_status[i])
+                    continue;
+                for (uint32_t j = 0; j < nbr_buffers[i].first && added < budget; j++)
+                {
+                    const uint32_t id = nbr_buffers[i].second[j];
+                    if (!admit(id) || !seen.insert(id).second)
+                        continue;
+                    added += node_set.insert(id).second ? 1 : 0;
+                    next_level.push_back(id);
+                }
+            }
+        }
+        level.swap(next_level);
+    }
+    return added;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cache_label_bfs_levels(uint64_t num_nodes_to_cache, std::vector<uint32_t> &node_list,
+                                                     const std::vector<LabelT> &query_labels,
+                                                     const uint64_t num_unfiltered_queries)
+{
+    if (_label_postings.num_labels() == 0)
+    {
+        cache_bfs_levels(num_nodes_to_cache, node_list);
+        return;
+    }
+
+    node_list.clear();
+    // Do not cache more than 10% of the nodes in the index
+    uint64_t tenp_nodes = (uint64_t)(std::round(this->_num_points * 0.1));
+    if (num_nodes_to_cache > tenp_nodes)
+    {
+        diskann::cout << "Reducing nodes to cache from: " << num_nodes_to_cache << " to: " << tenp_nodes
+                      << "(10 percent of total nodes:" << this->_num_points << ")" << std::endl;
+        num_nodes_to_cache = tenp_nodes == 0 ? 1 : tenp_nodes;
+    }
+    if (num_nodes_to_cache == 0)
+        return;
+
+    // One entry for the medoids, which unfiltered searches start from, then
+    // one per label, heaviest first.
+    struct CacheEntry
+    {
+        bool is_medoid;
+        LabelT label;
+        double weight;
+        uint64_t planned;
+        uint64_t cached;
+    };
+    std::vector<CacheEntry> entries;
+    entries.push_back({true, LabelT(0), (double)num_unfiltered_queries, 0, 0});
+    if (!query_labels.empty() || num_unfiltered_queries > 0)
+    {
+        std::unordered_map<LabelT, uint64_t> frequency;
+        for (const auto label : query_labels)
+            frequency[label]++;
+        for (const auto &label_frequency : frequency)
+            entries.push_back({false, label_frequency.first, (double)label_frequency.second, 0, 0});
+    }
+    else
+    {
+        for (const auto label : _label_postings.labels())
+            if (!_use_universal_label || label != _universal_filter_label)
+                entries.push_back({false, label, (double)_label_postings.count(label), 0, 0});
+    }
+    std::sort(entries.begin() + 1, entries.end(), [](const CacheEntry &a, const CacheEntry &b) {
+        return a.weight > b.weight || (a.weight == b.weight && a.label < b.label);
+    });
+
+    double label_weight = 0;
+    for (size_t i = 1; i < entries.size(); i++)
+        label_weight += entries[i].weight;
+    const double total_weight = entries[0].weight + label_weight;
+
+    // The medoids are always cached; the rest of the budget is split across
+    // labels by largest remainder.
+    uint64_t medoid_budget = num_nodes_to_cache;
+    if (label_weight > 0)
+    {
+        medoid_budget = (uint64_t)std::llround((double)num_nodes_to_cache * entries[0].weight / total_weight);
+        medoid_budget = (std::max)(medoid_budget, (std::min)(_num_medoids, num_nodes_to_cache));
+    }
+    entries[0].planned = medoid_budget;
+    const uint64_t label_budget = num_nodes_to_cache - medoid_budget;
+    uint64_t assigned = 0;
+    std::vector<std::pair<double, size_t>> remainders;
+    for (size_t i = 1; i < entries.size() && label_budget > 0; i++)
+    {
+        const double share = (double)label_budget * entries[i].weight / label_weight;
+        entries[i].planned = (uint64_t)share;
+        assigned += entries[i].planned;
+        remainders.emplace_back(share - (double)entries[i].planned, i);
+    }
+    std::sort(remainders.begin(), remainders.end(), std::greater<std::pair<double, size_t>>());
+    for (size_t k = 0; assigned < label_budget && k < remainders.size(); k++, assigned++)
+        entries[remainders[k].second].planned++;
+
+    std::vector<uint32_t> medoid_seeds(_medoids, _medoids + _num_medoids);
+    auto medoid_admits = [this](const uint32_t id) { return _dummy_pts.find(id) == _dummy_pts.end(); };
+
+    // Budget a neighbourhood cannot use, because it is small or overlaps the
+    // ones before it, passes on to the next entry.
+    tsl::robin_set<uint32_t> node_set;
+    uint64_t carry = 0;
+    for (auto &entry : entries)
+    {
+        const uint64_t budget = entry.planned + carry;
+        if (budget == 0)
+            continue;
+        if (entry.is_medoid)
+        {
+            entry.cached = cache_neighbourhood(medoid_seeds, budget, medoid_admits, node_set);
+        }
+        else
+        {
+            std::vector<uint32_t> seeds;
+            auto medoids = _filter_to_medoid_ids.find(entry.label);
+            if (medoids != _filter_to_medoid_ids.end())
+                seeds = medoids->second;
+            else
+                _label_postings.decode(entry.label, seeds, defaults::FILTER_START_CANDIDATES);
+            const LabelT label = entry.label;
+            auto label_admits = [this, label](const uint32_t id) {
+                return point_has_label(id, label) ||
+                       (_use_universal_label && point_has_label(id, _universal_filter_label));
+            };
+            entry.cached = cache_neighbourhood(seeds, budget, label_admits, node_set);
+        }
+        carry = budget - entry.cached;
+    }
+    if (carry > 0)
+        entries[0].cached += cache_neighbourhood(medoid_seeds, carry, medoid_admits, node_set);
+
+    node_list.assign(node_set.begin(), node_set.end());
+
+    const size_t REPORTED_LABELS = 10;
+    diskann::cout << "Cache plan for " << num_nodes_to_cache << " nodes over " << entries.size() - 1 << " labels ("
+                  << (query_labels.empty() && num_unfiltered_queries == 0 ? "weighted by label size"
+                                                                          : "weighted by sample queries")
+                  << "), " << node_list.size() << " nodes cached" << std::endl;
+    uint64_t rest_planned = 0, rest_cached = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const auto &entry = entries[i];
+        if (i > REPORTED_LABELS)
+        {
+            rest_planned += entry.planned;
+            rest_cached += entry.cached;
+            continue;
+        }
+        if (entry.is_medoid)
+            diskann::cout << "  medoids";
+        else
+            diskann::cout << "  label " << entry.label;
+        const double percent = total_weight > 0 ? std::round(1000.0 * entry.weight / total_weight) / 10 : 0.0;
+        diskann::cout << ": weight " << percent << "%, planned " << entry.planned << ", cached " << entry.cached
+                      << std::endl;
+    }
+    if (entries.size() > REPORTED_LABELS + 1)
+        diskann::cout << "  " << entries.size() - REPORTED_LABELS - 1 << " more labels: planned " << rest_planned
+                      << ", cached " << rest_cached << std::endl;
+}
+
 template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::use_medoids_data_as_centroids()
 {
     if (_centroid_data != nullptr)
@@ -678,6 +909,81 @@ inline bool PQFlashIndex<T, LabelT>::point_has_label(uint32_t point_id, LabelT l
     return ret_val;
 }
 
+template <typename T, typename LabelT>
+bool PQFlashIndex<T, LabelT>::matches_label_filter(uint32_t point_id, const LabelFilter<LabelT> &filter)
+{
+    const uint64_t bits = _pts_to_label_bits[point_id];
+    if (filter.fits_bitmap() && (!_use_universal_label || (uint64_t)_universal_filter_label < LABEL_BITMAP_BITS))
+        return (_use_universal_label && ((bits >> _universal_filter_label) & 1)) || filter.matches(bits);
+
+    if (_use_universal_label && point_has_label(point_id, _universal_filter_label))
+        return true;
+    return filter.matches(_pts_to_labels + _pts_to_label_offsets[point_id], _pts_to_label_counts[point_id]);
+}
+
+template <typename T, typename LabelT>
+size_t PQFlashIndex<T, LabelT>::estimate_filter_matches(const LabelFilter<LabelT> &filter) const
+{
+    auto count = [this](const LabelT label) { return _label_postings.count(label); };
+    size_t estimate = filter.estimate_matches(count, _num_points);
+    if (_use_universal_label)
+        estimate = std::min(estimate + count(_universal_filter_label), (size_t)_num_points);
+    return estimate;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::get_filter_candidates(const LabelFilter<LabelT> &filter,
+                                                    std::vector<uint32_t> &candidates) const
+{
+    // A clause can only match the points of its rarest positive label, and a
+    // clause without one can match any point.
+    for (const auto &clause : filter.clauses())
+    {
+        if (clause.all_of.empty())
+        {
+            candidates.resize(_num_points);
+            std::iota(candidates.begin(), candidates.end(), 0);
+            return;
+        }
+        LabelT rarest = clause.all_of[0];
+        for (const auto label : clause.all_of)
+        {
+            if (_label_postings.count(label) < _label_postings.count(rarest))
+                rarest = label;
+        }
+        _label_postings.decode(rarest, candidates);
+    }
+    if (_use_universal_label)
+        _label_postings.decode(_universal_filter_label, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+template <typename T, typename LabelT> uint32_t PQFlashIndex<T, LabelT>::get_label_count(const LabelT &label) const
+{
+    return _label_postings.count(label);
+}
+
+template <typename T, typename LabelT>
+std::vector<uint32_t> PQFlashIndex<T, LabelT>::get_label_points(const LabelT &label) const
+{
+    std::vector<uint32_t> points;
+    _label_postings.decode(label, points);
+    if (_dummy_pts.empty())
+        return points;
+
+    // A point with many labels is split into dummy points holding disjoint
+    // parts of its labels; report the point itself.
+    for (auto &point : points)
+    {
+        auto iter = _dummy_to_real_map.find(point);
+        if (iter != _dummy_to_real_map.end())
+            point = iter->second;
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
 template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile, size_t &num_points_labels)
 {
@@ -699,6 +1005,8 @@ void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile,
     _pts_to_label_offsets = new uint32_t[num_pts_in_label_file];
     _pts_to_label_counts = new uint32_t[num_pts_in_label_file];
     _pts_to_labels = new LabelT[num_total_labels];
+    _pts_to_label_bits.assign(num_pts_in_label_file, 0);
+    _label_postings.clear();
     uint32_t labels_seen_so_far = 0;
 
     std::string label_str;
@@ -739,6 +1047,7 @@ void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile,
 
             LabelT token_as_num = (LabelT)std::stoul(label_str);
             _pts_to_labels[labels_seen_so_far++] = (LabelT)token_as_num;
+            _label_postings.add(line_cnt, token_as_num);
             num_lbls_in_cur_pt++;
 
             // move to next label
@@ -753,10 +1062,16 @@ void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile,
             diskann::cout << "No label found for point " << line_cnt << std::endl;
             exit(-1);
         }
+        _pts_to_label_bits[line_cnt] =
+            label_bitmap(_pts_to_labels + _pts_to_label_offsets[line_cnt], num_lbls_in_cur_pt);
 
         line_cnt++;
     }
 
+    _label_postings.finalize();
+    diskann::cout << "Built posting lists of " << _label_postings.num_labels() << " labels in "
+                  << _label_postings.encoded_bytes() << " bytes" << std::endl;
+
     num_points_labels = line_cnt;
     reset_stream_for_reading(infile);
 }
@@ -1273,9 +1588,9 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                                  const uint32_t io_limit, const bool use_reorder_data,
                                                  QueryStats *stats)
 {
-    LabelT dummy_filter = 0;
-    cached_beam_search(query1, k_search, l_search, indices, distances, beam_width, false, dummy_filter, io_limit,
-                       use_reorder_data, stats);
+    DiskIndexMetrics::get().queries.add();
+    cached_beam_search_impl(query1, k_search, l_search, indices, distances, beam_width, nullptr, io_limit,
+                            use_reorder_data, stats);
 }
 
 template <typename T, typename LabelT>
@@ -1285,17 +1600,60 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                                  const uint32_t io_limit, const bool use_reorder_data,
                                                  QueryStats *stats)
 {
+    DiskIndexMetrics::get().queries.add();
+    if (!use_filter)
+    {
+        cached_beam_search_impl(query1, k_search, l_search, indices, distances, beam_width, nullptr, io_limit,
+                                use_reorder_data, stats);
+        return;
+    }
+    const LabelFilter<LabelT> filter(filter_label);
+    cached_beam_search_impl(query1, k_search, l_search, indices, distances, beam_width, &filter, io_limit,
+                            use_reorder_data, stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                                 uint64_t *indices, float *distances, const uint64_t beam_width,
+                                                 const LabelFilter<LabelT> &filter, const uint32_t io_limit,
+                                                 const bool use_reorder_data, QueryStats *stats)
+{
+    if (filter.empty())
+        throw ANNException("Label filter has no clauses", -1, __FUNCSIG__, __FILE__, __LINE__);
+    DiskIndexMetrics::get().queries.add();
+    cached_beam_search_impl(query1, k_search, l_search, indices, distances, beam_width, &filter, io_limit,
+                            use_reorder_data, stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cached_beam_search_impl(const T *query1, const uint64_t k_search,
+                                                      const uint64_t l_search, uint64_t *indices, float *distances,
+                                                      const uint64_t beam_width, const LabelFilter<LabelT> *filter,
+                                                      const uint32_t io_limit, const bool use_reorder_data,
+                                                      QueryStats *stats, RangeQuery *range)
+{
+    const bool use_filter = filter != nullptr;
 
     uint64_t num_sector_per_nodes = DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN);
     if (beam_width > num_sector_per_nodes * defaults::MAX_N_SECTOR_READS)
         throw ANNException("Beamwidth can not be higher than defaults::MAX_N_SECTOR_READS", -1, __FUNCSIG__, __FILE__,
                            __LINE__);
 
+    auto &metrics = DiskIndexMetrics::get();
+    Timer search_timer;
+    QueryTrace *trace = _query_tracer != nullptr ? _query_tracer->begin_query() : nullptr;
+
     ScratchStoreManager<SSDThreadData<T>> manager(this->_thread_data);
     auto data = manager.scratch_space();
     IOContext &ctx = data->ctx;
     auto query_scratch = &(data->scratch);
     auto pq_query_scratch = query_scratch->pq_scratch();
+    metrics.scratch_wait.record(search_timer.elapsed());
+    if (trace != nullptr)
+    {
+        trace->scratch_wait_us = trace->elapsed_us();
+        trace->pq_table_begin_us = trace->scratch_wait_us;
+    }
 
     // reset query scratch
     query_scratch->reset();
@@ -1353,6 +1711,8 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                                // we have a rotation matrix
     float *pq_dists = pq_query_scratch->aligned_pqtable_dist_scratch;
     _pq_table.populate_chunk_distances(query_rotated, pq_dists);
+    if (trace != nullptr)
+        trace->pq_table_us = trace->elapsed_us() - trace->pq_table_begin_us;
 
     // query <-> neighbor list
     float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
@@ -1368,13 +1728,73 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
 
     tsl::robin_set<uint64_t> &visited = query_scratch->visited;
     NeighborPriorityQueue &retset = query_scratch->retset;
-    retset.reserve(l_search);
     std::vector<Neighbor> &full_retset = query_scratch->full_retset;
 
-    uint32_t best_medoid = 0;
-    float best_dist = (std::numeric_limits<float>::max)();
+    // A filtered search is planned from label cardinalities, see
+    // plan_filtered_search. The Graph plan walks over the anchor labels of the
+    // filter, starting from the closest medoid of each, and keeps the nodes
+    // carrying one of them; see LabelFilter. PostFilter walks the whole graph
+    // with a longer list. Exact puts every point the filter may match on the
+    // list by PQ distance and only reads the best of them from disk.
+    std::vector<LabelT> anchors;
+    FilterPlan plan = FilterPlan::None;
+    uint64_t search_l = l_search;
+    if (use_filter)
+    {
+        anchors = filter->anchor_labels();
+        bool found_start = false;
+        for (const auto label : anchors)
+        {
+            found_start = found_start || _label_postings.count(label) > 0;
+        }
+        const size_t estimated_matches = estimate_filter_matches(*filter);
+        plan = plan_filtered_search(estimated_matches, _num_points, (uint32_t)l_search, _max_degree, found_start);
+        if (plan == FilterPlan::PostFilter)
+            search_l = post_filter_list_size(estimated_matches, _num_points, (uint32_t)l_search);
+        if (stats != nullptr)
+            stats->filter_plan = plan;
+    }
+    retset.reserve(search_l);
+    const bool restrict_walk = plan == FilterPlan::Graph;
+    const bool expand_neighbors = plan != FilterPlan::Exact;
+    bool walk_use_bits =
+        restrict_walk && (!_use_universal_label || (uint64_t)_universal_filter_label < LABEL_BITMAP_BITS);
+    for (const auto label : anchors)
+        walk_use_bits = walk_use_bits && (uint64_t)label < LABEL_BITMAP_BITS;
+    uint64_t walk_bits = label_bitmap(anchors);
+    if (walk_use_bits && _use_universal_label)
+        walk_bits |= (uint64_t)1 << _universal_filter_label;
+    auto walk_admits = [this, &anchors, walk_use_bits, walk_bits](const uint32_t id) {
+        if (walk_use_bits)
+            return (_pts_to_label_bits[id] & walk_bits) != 0;
+        for (const auto label : anchors)
+            if (point_has_label(id, label))
+                return true;
+        return _use_universal_label && point_has_label(id, _universal_filter_label);
+    };
+
+    // for filtered index, we dont store global centroid data as for unfiltered index, so we use PQ distance
+    // as approximation to decide closest medoid matching the query filter.
+    auto closest_by_pq = [&compute_dists, dist_scratch](const uint32_t *ids, const uint64_t n_ids) {
+        uint32_t best_id = ids[0];
+        float best_dist = (std::numeric_limits<float>::max)();
+        for (uint64_t i = 0; i < n_ids; i++)
+        {
+            compute_dists(ids + i, 1, dist_scratch);
+            if (dist_scratch[0] < best_dist)
+            {
+                best_id = ids[i];
+                best_dist = dist_scratch[0];
+            }
+        }
+        return best_id;
+    };
+
+    std::vector<uint32_t> start_ids;
     if (!use_filter)
     {
+        uint32_t best_medoid = 0;
+        float best_dist = (std::numeric_limits<float>::max)();
         for (uint64_t cur_m = 0; cur_m < _num_medoids; cur_m++)
         {
             float cur_expanded_dist =
@@ -1385,38 +1805,64 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                 best_dist = cur_expanded_dist;
             }
         }
+        start_ids.push_back(best_medoid);
     }
-    else
+    else if (plan == FilterPlan::PostFilter)
     {
-        if (_filter_to_medoid_ids.find(filter_label) != _filter_to_medoid_ids.end())
+        start_ids.push_back(closest_by_pq(_medoids, _num_medoids));
+    }
+    else if (plan == FilterPlan::Graph)
+    {
+        for (const auto label : anchors)
         {
-            const auto &medoid_ids = _filter_to_medoid_ids[filter_label];
-            for (uint64_t cur_m = 0; cur_m < medoid_ids.size(); cur_m++)
+            auto iter = _filter_to_medoid_ids.find(label);
+            if (iter != _filter_to_medoid_ids.end() && !iter->second.empty())
             {
-                // for filtered index, we dont store global centroid data as for unfiltered index, so we use PQ distance
-                // as approximation to decide closest medoid matching the query filter.
-                compute_dists(&medoid_ids[cur_m], 1, dist_scratch);
-                float cur_expanded_dist = dist_scratch[0];
-                if (cur_expanded_dist < best_dist)
-                {
-                    best_medoid = medoid_ids[cur_m];
-                    best_dist = cur_expanded_dist;
-                }
+                start_ids.push_back(closest_by_pq(iter->second.data(), iter->second.size()));
+                continue;
             }
+            // No medoid was built for this label; start from the closest of
+            // its first few points.
+            std::vector<uint32_t> label_points;
+            _label_postings.decode(label, label_points, defaults::FILTER_START_CANDIDATES);
+            if (!label_points.empty())
+                start_ids.push_back(closest_by_pq(label_points.data(), label_points.size()));
         }
-        else
+    }
+    else
+    {
+        std::vector<uint32_t> candidates;
+        get_filter_candidates(*filter, candidates);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [this, filter](const uint32_t id) {
+                                            return !matches_label_filter(id, *filter);
+                                        }),
+                         candidates.end());
+
+        // PQ distances are batched up to the size of the scratch.
+        for (size_t begin = 0; begin < candidates.size(); begin += defaults::MAX_GRAPH_DEGREE)
         {
-            throw ANNException("Cannot find medoid for specified filter.", -1, __FUNCSIG__, __FILE__, __LINE__);
+            const size_t n = std::min<size_t>(defaults::MAX_GRAPH_DEGREE, candidates.size() - begin);
+            compute_dists(candidates.data() + begin, n, dist_scratch);
+            for (size_t i = 0; i < n; i++)
+                retset.insert(Neighbor(candidates[begin + i], dist_scratch[i]));
         }
+        if (stats != nullptr)
+            stats->n_cmps += (uint32_t)candidates.size();
     }
 
-    compute_dists(&best_medoid, 1, dist_scratch);
-    retset.insert(Neighbor(best_medoid, dist_scratch[0]));
-    visited.insert(best_medoid);
+    for (const auto start_id : start_ids)
+    {
+        if (!visited.insert(start_id).second)
+            continue;
+        compute_dists(&start_id, 1, dist_scratch);
+        retset.insert(Neighbor(start_id, dist_scratch[0]));
+    }
 
     uint32_t cmps = 0;
     uint32_t hops = 0;
     uint32_t num_ios = 0;
+    uint32_t num_cache_hits = 0;
 
     // cleared every iteration
     std::vector<uint32_t> frontier;
@@ -1428,205 +1874,253 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
     std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t *>>> cached_nhoods;
     cached_nhoods.reserve(2 * beam_width);
 
-    while (retset.has_unexpanded_node() && num_ios < io_limit)
-    {
-        // clear iteration state
-        frontier.clear();
-        frontier_nhoods.clear();
-        frontier_read_reqs.clear();
-        cached_nhoods.clear();
-        sector_scratch_idx = 0;
-        // find new beam
-        uint32_t num_seen = 0;
-        while (retset.has_unexpanded_node() && frontier.size() < beam_width && num_seen < beam_width)
+    // Every node put on the list of a range query, to refill the list from
+    // when it grows.
+    std::vector<Neighbor> scored;
+    if (range != nullptr)
+        for (size_t i = 0; i < retset.size(); i++)
+            scored.push_back(retset[i]);
+
+    // Neighbours of an expanded node that are unvisited and pass the filter.
+    // Only these reach aggregate_coords and pq_dist_lookup, so at low filter
+    // selectivity most of the PQ work of an expansion is skipped.
+    std::vector<uint32_t> fresh_nbrs;
+    fresh_nbrs.reserve(_max_degree);
+    auto expand_nbrs = [&](const uint32_t *node_nbrs, const uint64_t nnbrs) {
+        fresh_nbrs.clear();
+        for (uint64_t m = 0; m < nnbrs; ++m)
+        {
+            const uint32_t id = node_nbrs[m];
+            if (!visited.insert(id).second)
+                continue;
+            if (!use_filter && _dummy_pts.find(id) != _dummy_pts.end())
+                continue;
+            if (restrict_walk && !walk_admits(id))
+                continue;
+            fresh_nbrs.push_back(id);
+        }
+
+        // compute fresh_nbrs <-> query dists in PQ space
+        cpu_timer.reset();
+        compute_dists(fresh_nbrs.data(), fresh_nbrs.size(), dist_scratch);
+        for (size_t m = 0; m < fresh_nbrs.size(); ++m)
+        {
+            retset.insert(Neighbor(fresh_nbrs[m], dist_scratch[m]));
+            if (range != nullptr)
+                scored.emplace_back(fresh_nbrs[m], dist_scratch[m]);
+        }
+        cmps += (uint32_t)fresh_nbrs.size();
+        if (stats != nullptr)
+        {
+            stats->n_cmps += (uint32_t)fresh_nbrs.size();
+            stats->cpu_us += (float)cpu_timer.elapsed();
+        }
+    };
+
+    // Distances of a range query in the space of its range, where they are
+    // also reported. For mips that is the inner product: the walk ranks by the
+    // squared L2 between the unit vectors the base and query were converted
+    // to, 2 - 2 * ip / ip_scale, or by the negated inner product of disk PQ.
+    const float ip_scale = _max_base_norm != 0 ? _max_base_norm * query_norm : 1.0f;
+    auto range_distance = [this, ip_scale](const float distance) {
+        if (metric != diskann::Metric::INNER_PRODUCT)
+            return distance;
+        return (_use_disk_index_pq ? -distance : 1.0f - distance / 2) * ip_scale;
+    };
+    auto within_range = [this, &range_distance, range](const float distance) {
+        return metric == diskann::Metric::INNER_PRODUCT ? range_distance(distance) >= range->range
+                                                        : distance <= range->range;
+    };
+
+    uint64_t cur_beam_width = beam_width;
+    uint64_t cur_l = search_l;
+    size_t num_in_range = 0;
+    // Grows the list of a range query once the walk has converged; see
+    // RangeQuery. Returns false when the search is done.
+    auto grow_range_list = [&]() {
+        if (range == nullptr || num_ios >= io_limit || 2 * cur_l > range->max_l_search)
+            return false;
+        size_t in_range = 0;
+        for (const auto &nbr : full_retset)
+            in_range += within_range(nbr.distance);
+        const bool found_more = in_range > num_in_range;
+        num_in_range = in_range;
+        // As in Index::range_search, a walk finds most points in range only
+        // with a list several times longer than their number.
+        if (!found_more || 4 * in_range < cur_l)
+            return false;
+
+        cur_l *= 2;
+        cur_beam_width = std::min<uint64_t>({std::max<uint64_t>(range->min_beam_width, cur_l / 5), 100,
+                                             defaults::MAX_N_SECTOR_READS / num_sectors_per_node});
+        tsl::robin_set<uint32_t> expanded;
+        for (const auto &nbr : full_retset)
+            expanded.insert(nbr.id);
+        retset.reserve(cur_l);
+        for (const auto &nbr : scored)
+            if (expanded.find(nbr.id) == expanded.end())
+                retset.insert(nbr);
+        return retset.has_unexpanded_node();
+    };
+
+    do
+    {
+        while (retset.has_unexpanded_node() && num_ios < io_limit)
         {
-            auto nbr = retset.closest_unexpanded();
-            num_seen++;
-            auto iter = _nhood_cache.find(nbr.id);
-            if (iter != _nhood_cache.end())
+            const float hop_begin_us = trace != nullptr ? trace->elapsed_us() : 0;
+            // clear iteration state
+            frontier.clear();
+            frontier_nhoods.clear();
+            frontier_read_reqs.clear();
+            cached_nhoods.clear();
+            sector_scratch_idx = 0;
+            // find new beam
+            uint32_t num_seen = 0;
+            while (retset.has_unexpanded_node() && frontier.size() < cur_beam_width && num_seen < cur_beam_width)
             {
-                cached_nhoods.push_back(std::make_pair(nbr.id, iter->second));
-                if (stats != nullptr)
+                auto nbr = retset.closest_unexpanded();
+                num_seen++;
+                auto iter = _nhood_cache.find(nbr.id);
+                if (trace != nullptr)
+                    trace->add_cache_lookup(hops, iter != _nhood_cache.end());
+                if (iter != _nhood_cache.end())
                 {
-                    stats->n_cache_hits++;
+                    cached_nhoods.push_back(std::make_pair(nbr.id, iter->second));
+                    num_cache_hits++;
+                    if (stats != nullptr)
+                    {
+                        stats->n_cache_hits++;
+                    }
+                }
+                else
+                {
+                    frontier.push_back(nbr.id);
+                }
+                if (this->_count_visited_nodes)
+                {
+                    reinterpret_cast<std::atomic<uint32_t> &>(this->_node_visit_counter[nbr.id].second).fetch_add(1);
                 }
             }
-            else
-            {
-                frontier.push_back(nbr.id);
-            }
-            if (this->_count_visited_nodes)
-            {
-                reinterpret_cast<std::atomic<uint32_t> &>(this->_node_visit_counter[nbr.id].second).fetch_add(1);
-            }
-        }
 
-        // read nhoods of frontier ids
-        if (!frontier.empty())
-        {
-            if (stats != nullptr)
-                stats->n_hops++;
-            for (uint64_t i = 0; i < frontier.size(); i++)
+            // read nhoods of frontier ids
+            if (!frontier.empty())
             {
-                auto id = frontier[i];
-                std::pair<uint32_t, char *> fnhood;
-                fnhood.first = id;
-                fnhood.second = sector_scratch + num_sectors_per_node * sector_scratch_idx * defaults::SECTOR_LEN;
-                sector_scratch_idx++;
-                frontier_nhoods.push_back(fnhood);
-                frontier_read_reqs.emplace_back(get_node_sector((size_t)id) * defaults::SECTOR_LEN,
-                                                num_sectors_per_node * defaults::SECTOR_LEN, fnhood.second);
                 if (stats != nullptr)
+                    stats->n_hops++;
+                for (uint64_t i = 0; i < frontier.size(); i++)
                 {
-                    stats->n_4k++;
-                    stats->n_ios++;
+                    auto id = frontier[i];
+                    std::pair<uint32_t, char *> fnhood;
+                    fnhood.first = id;
+                    fnhood.second = sector_scratch + num_sectors_per_node * sector_scratch_idx * defaults::SECTOR_LEN;
+                    sector_scratch_idx++;
+                    frontier_nhoods.push_back(fnhood);
+                    frontier_read_reqs.emplace_back(get_node_sector((size_t)id) * defaults::SECTOR_LEN,
+                                                    num_sectors_per_node * defaults::SECTOR_LEN, fnhood.second);
+                    if (stats != nullptr)
+                    {
+                        stats->n_4k++;
+                        stats->n_ios++;
+                    }
+                    num_ios++;
                 }
-                num_ios++;
-            }
-            io_timer.reset();
+                io_timer.reset();
 #ifdef USE_BING_INFRA
-            reader->read(frontier_read_reqs, ctx,
-                         true); // asynhronous reader for Bing.
+                reader->read(frontier_read_reqs, ctx,
+                             true); // asynhronous reader for Bing.
 #else
-            reader->read(frontier_read_reqs, ctx); // synchronous IO linux
+                reader->read(frontier_read_reqs, ctx); // synchronous IO linux
 #endif
-            if (stats != nullptr)
-            {
-                stats->io_us += (float)io_timer.elapsed();
+                metrics.io_latency.record(io_timer.elapsed());
+                if (stats != nullptr)
+                {
+                    stats->io_us += (float)io_timer.elapsed();
+                }
+                if (trace != nullptr)
+                {
+                    trace->io_us += (float)io_timer.elapsed();
+                    trace->n_ios += (uint32_t)frontier.size();
+                }
             }
-        }
 
-        // process cached nhoods
-        for (auto &cached_nhood : cached_nhoods)
-        {
-            auto global_cache_iter = _coord_cache.find(cached_nhood.first);
-            T *node_fp_coords_copy = global_cache_iter->second;
-            float cur_expanded_dist;
-            if (!_use_disk_index_pq)
+            // process cached nhoods
+            for (auto &cached_nhood : cached_nhoods)
             {
-                cur_expanded_dist = _dist_cmp->compare(aligned_query_T, node_fp_coords_copy, (uint32_t)_aligned_dim);
-            }
-            else
-            {
-                if (metric == diskann::Metric::INNER_PRODUCT)
-                    cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)node_fp_coords_copy);
+                auto global_cache_iter = _coord_cache.find(cached_nhood.first);
+                T *node_fp_coords_copy = global_cache_iter->second;
+                float cur_expanded_dist;
+                if (!_use_disk_index_pq)
+                {
+                    cur_expanded_dist = _dist_cmp->compare(aligned_query_T, node_fp_coords_copy, (uint32_t)_aligned_dim);
+                }
                 else
-                    cur_expanded_dist = _disk_pq_table.l2_distance( // disk_pq does not support OPQ yet
-                        query_float, (uint8_t *)node_fp_coords_copy);
-            }
-            full_retset.push_back(Neighbor((uint32_t)cached_nhood.first, cur_expanded_dist));
-
-            uint64_t nnbrs = cached_nhood.second.first;
-            uint32_t *node_nbrs = cached_nhood.second.second;
-
-            // compute node_nbrs <-> query dists in PQ space
-            cpu_timer.reset();
-            compute_dists(node_nbrs, nnbrs, dist_scratch);
-            if (stats != nullptr)
-            {
-                stats->n_cmps += (uint32_t)nnbrs;
-                stats->cpu_us += (float)cpu_timer.elapsed();
-            }
-
-            // process prefetched nhood
-            for (uint64_t m = 0; m < nnbrs; ++m)
-            {
-                uint32_t id = node_nbrs[m];
-                if (visited.insert(id).second)
                 {
-                    if (!use_filter && _dummy_pts.find(id) != _dummy_pts.end())
-                        continue;
-
-                    if (use_filter && !(point_has_label(id, filter_label)) &&
-                        (!_use_universal_label || !point_has_label(id, _universal_filter_label)))
-                        continue;
-                    cmps++;
-                    float dist = dist_scratch[m];
-                    Neighbor nn(id, dist);
-                    retset.insert(nn);
+                    if (metric == diskann::Metric::INNER_PRODUCT)
+                        cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)node_fp_coords_copy);
+                    else
+                        cur_expanded_dist = _disk_pq_table.l2_distance( // disk_pq does not support OPQ yet
+                            query_float, (uint8_t *)node_fp_coords_copy);
                 }
+                full_retset.push_back(Neighbor((uint32_t)cached_nhood.first, cur_expanded_dist));
+
+                uint64_t nnbrs = expand_neighbors ? cached_nhood.second.first : 0;
+                expand_nbrs(cached_nhood.second.second, nnbrs);
             }
-        }
 #ifdef USE_BING_INFRA
-        // process each frontier nhood - compute distances to unvisited nodes
-        int completedIndex = -1;
-        long requestCount = static_cast<long>(frontier_read_reqs.size());
-        // If we issued read requests and if a read is complete or there are
-        // reads in wait state, then enter the while loop.
-        while (requestCount > 0 && getNextCompletedRequest(reader, ctx, requestCount, completedIndex))
-        {
-            assert(completedIndex >= 0);
-            auto &frontier_nhood = frontier_nhoods[completedIndex];
-            (*ctx.m_pRequestsStatus)[completedIndex] = IOContext::PROCESS_COMPLETE;
-#else
-        for (auto &frontier_nhood : frontier_nhoods)
-        {
-#endif
-            char *node_disk_buf = offset_to_node(frontier_nhood.second, frontier_nhood.first);
-            uint32_t *node_buf = offset_to_node_nhood(node_disk_buf);
-            uint64_t nnbrs = (uint64_t)(*node_buf);
-            T *node_fp_coords = offset_to_node_coords(node_disk_buf);
-            memcpy(data_buf, node_fp_coords, _disk_bytes_per_point);
-            float cur_expanded_dist;
-            if (!_use_disk_index_pq)
+            // process each frontier nhood - compute distances to unvisited nodes
+            int completedIndex = -1;
+            long requestCount = static_cast<long>(frontier_read_reqs.size());
+            // If we issued read requests and if a read is complete or there are
+            // reads in wait state, then enter the while loop.
+            while (requestCount > 0 && getNextCompletedRequest(reader, ctx, requestCount, completedIndex))
             {
-                cur_expanded_dist = _dist_cmp->compare(aligned_query_T, data_buf, (uint32_t)_aligned_dim);
-            }
-            else
+                assert(completedIndex >= 0);
+                auto &frontier_nhood = frontier_nhoods[completedIndex];
+                (*ctx.m_pRequestsStatus)[completedIndex] = IOContext::PROCESS_COMPLETE;
+#else
+            for (auto &frontier_nhood : frontier_nhoods)
             {
-                if (metric == diskann::Metric::INNER_PRODUCT)
-                    cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)data_buf);
+#endif
+                char *node_disk_buf = offset_to_node(frontier_nhood.second, frontier_nhood.first);
+                uint32_t *node_buf = offset_to_node_nhood(node_disk_buf);
+                uint64_t nnbrs = expand_neighbors ? (uint64_t)(*node_buf) : 0;
+                T *node_fp_coords = offset_to_node_coords(node_disk_buf);
+                memcpy(data_buf, node_fp_coords, _disk_bytes_per_point);
+                float cur_expanded_dist;
+                if (!_use_disk_index_pq)
+                {
+                    cur_expanded_dist = _dist_cmp->compare(aligned_query_T, data_buf, (uint32_t)_aligned_dim);
+                }
                 else
-                    cur_expanded_dist = _disk_pq_table.l2_distance(query_float, (uint8_t *)data_buf);
-            }
-            full_retset.push_back(Neighbor(frontier_nhood.first, cur_expanded_dist));
-            uint32_t *node_nbrs = (node_buf + 1);
-            // compute node_nbrs <-> query dist in PQ space
-            cpu_timer.reset();
-            compute_dists(node_nbrs, nnbrs, dist_scratch);
-            if (stats != nullptr)
-            {
-                stats->n_cmps += (uint32_t)nnbrs;
-                stats->cpu_us += (float)cpu_timer.elapsed();
-            }
-
-            cpu_timer.reset();
-            // process prefetch-ed nhood
-            for (uint64_t m = 0; m < nnbrs; ++m)
-            {
-                uint32_t id = node_nbrs[m];
-                if (visited.insert(id).second)
                 {
-                    if (!use_filter && _dummy_pts.find(id) != _dummy_pts.end())
-                        continue;
-
-                    if (use_filter && !(point_has_label(id, filter_label)) &&
-                        (!_use_universal_label || !point_has_label(id, _universal_filter_label)))
-                        continue;
-                    cmps++;
-                    float dist = dist_scratch[m];
-                    if (stats != nullptr)
-                    {
-                        stats->n_cmps++;
-                    }
-
-                    Neighbor nn(id, dist);
-                    retset.insert(nn);
+                    if (metric == diskann::Metric::INNER_PRODUCT)
+                        cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)data_buf);
+                    else
+                        cur_expanded_dist = _disk_pq_table.l2_distance(query_float, (uint8_t *)data_buf);
                 }
+                full_retset.push_back(Neighbor(frontier_nhood.first, cur_expanded_dist));
+                expand_nbrs(node_buf + 1, nnbrs);
             }
 
-            if (stats != nullptr)
-            {
-                stats->cpu_us += (float)cpu_timer.elapsed();
-            }
+            if (trace != nullptr)
+                trace->add_hop(hop_begin_us);
+            hops++;
         }
-
-        hops++;
-    }
+    } while (grow_range_list());
 
     // re-sort by distance
     std::sort(full_retset.begin(), full_retset.end());
 
+    // Nodes reached over the anchors match an OR of single labels already.
+    if (plan == FilterPlan::PostFilter || (plan == FilterPlan::Graph && !filter->is_label_disjunction()))
+    {
+        full_retset.erase(std::remove_if(full_retset.begin(), full_retset.end(),
+                                         [this, filter](const Neighbor &nbr) {
+                                             return !matches_label_filter(nbr.id, *filter);
+                                         }),
+                          full_retset.end());
+    }
+
     if (use_reorder_data)
     {
         if (!(this->_reorder_data_exists))
@@ -1637,6 +2131,8 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                -1, __FUNCSIG__, __FILE__, __LINE__);
         }
 
+        if (trace != nullptr)
+            trace->rerank_begin_us = trace->elapsed_us();
         std::vector<AlignedRead> vec_read_reqs;
 
         if (full_retset.size() > k_search * FULL_PRECISION_REORDER_MULTIPLIER)
@@ -1661,10 +2157,17 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
 #else
         reader->read(vec_read_reqs, ctx); // synchronous IO linux
 #endif
+        metrics.io_latency.record(io_timer.elapsed());
+        metrics.ios.add(vec_read_reqs.size());
         if (stats != nullptr)
         {
             stats->io_us += io_timer.elapsed();
         }
+        if (trace != nullptr)
+        {
+            trace->io_us += (float)io_timer.elapsed();
+            trace->n_ios += (uint32_t)vec_read_reqs.size();
+        }
 
         for (size_t i = 0; i < full_retset.size(); ++i)
         {
@@ -1675,10 +2178,23 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
         }
 
         std::sort(full_retset.begin(), full_retset.end());
+        if (trace != nullptr)
+            trace->rerank_us = trace->elapsed_us() - trace->rerank_begin_us;
     }
 
-    // copy k_search values
-    for (uint64_t i = 0; i < k_search; i++)
+    // copy k_search values, or all values in range of a range query
+    uint64_t num_results = k_search;
+    if (range != nullptr)
+    {
+        num_results = 0;
+        while (num_results < full_retset.size() && within_range(full_retset[num_results].distance))
+            num_results++;
+        range->indices->resize(num_results);
+        range->distances->resize(num_results);
+        indices = range->indices->data();
+        distances = range->distances->data();
+    }
+    for (uint64_t i = 0; i < num_results && i < full_retset.size(); i++)
     {
         indices[i] = full_retset[i].id;
         auto key = (uint32_t)indices[i];
@@ -1687,7 +2203,11 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
             indices[i] = _dummy_to_real_map[key];
         }
 
-        if (distances != nullptr)
+        if (range != nullptr)
+        {
+            distances[i] = range_distance(full_retset[i].distance);
+        }
+        else if (distances != nullptr)
         {
             distances[i] = full_retset[i].distance;
             if (metric == diskann::Metric::INNER_PRODUCT)
@@ -1710,50 +2230,40 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
     {
         stats->total_us = (float)query_timer.elapsed();
     }
+    metrics.ios.add(num_ios);
+    metrics.cache_hits.add(num_cache_hits);
+    metrics.query_latency.record(search_timer.elapsed());
+    if (trace != nullptr)
+    {
+        trace->n_cmps = cmps;
+        _query_tracer->end_query(trace);
+    }
 }
 
 // range search returns results of all neighbors within distance of range.
-// indices and distances need to be pre-allocated of size l_search and the
-// return value is the number of matching hits.
+// indices and distances are resized to the number of matching hits, which is
+// returned.
 template <typename T, typename LabelT>
 uint32_t PQFlashIndex<T, LabelT>::range_search(const T *query1, const double range, const uint64_t min_l_search,
                                                const uint64_t max_l_search, std::vector<uint64_t> &indices,
                                                std::vector<float> &distances, const uint64_t min_beam_width,
                                                QueryStats *stats)
 {
-    uint32_t res_count = 0;
-
-    bool stop_flag = false;
-
-    uint32_t l_search = (uint32_t)min_l_search; // starting size of the candidate list
-    while (!stop_flag)
-    {
-        indices.resize(l_search);
-        distances.resize(l_search);
-        uint64_t cur_bw = min_beam_width > (l_search / 5) ? min_beam_width : l_search / 5;
-        cur_bw = (cur_bw > 100) ? 100 : cur_bw;
-        for (auto &x : distances)
-            x = std::numeric_limits<float>::max();
-        this->cached_beam_search(query1, l_search, l_search, indices.data(), distances.data(), cur_bw, false, stats);
-        for (uint32_t i = 0; i < l_search; i++)
-        {
-            if (distances[i] > (float)range)
-            {
-                res_count = i;
-                break;
-            }
-            else if (i == l_search - 1)
-                res_count = l_search;
-        }
-        if (res_count < (uint32_t)(l_search / 2.0))
-            stop_flag = true;
-        l_search = l_search * 2;
-        if (l_search > max_l_search)
-            stop_flag = true;
-    }
-    indices.resize(res_count);
-    distances.resize(res_count);
-    return res_count;
+    const uint64_t num_sectors_per_node =
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN);
+    const uint64_t beam_width = std::min<uint64_t>({std::max<uint64_t>(min_beam_width, min_l_search / 5), 100,
+                                                    defaults::MAX_N_SECTOR_READS / num_sectors_per_node});
+
+    RangeQuery range_query;
+    range_query.range = (float)range;
+    range_query.max_l_search = max_l_search;
+    range_query.min_beam_width = min_beam_width;
+    range_query.indices = &indices;
+    range_query.distances = &distances;
+    DiskIndexMetrics::get().queries.add();
+    cached_beam_search_impl(query1, 0, min_l_search, nullptr, nullptr, beam_width, nullptr,
+                            std::numeric_limits<uint32_t>::max(), false, stats, &range_query);
+    return (uint32_t)indices.size();
 }
 
 template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::get_data_dim()
@@ -1796,6 +2306,12 @@ template <typename T, typename LabelT> std::uint64_t PQFlashIndex<T, LabelT>::ge
     return _num_points;
 }
 
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_query_tracer(std::shared_ptr<QueryTracer> tracer)
+{
+    _query_tracer = tracer;
+}
+
 // instantiations
 template class PQFlashIndex<uint8_t>;
 template class PQFlashIndex<int8_t>;
@@ -0,0 +1,180 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <fstream>
+
+#include "ann_exception.h"
+#include "query_trace.h"
+
+namespace diskann
+{
+namespace
+{
+// Small, stable ids for the threads that run queries, so that Chrome trace
+// rows are readable.
+uint64_t current_thread_trace_id()
+{
+    static std::atomic<uint64_t> next_id{0};
+    thread_local uint64_t id = next_id.fetch_add(1);
+    return id;
+}
+
+void write_array(std::ostream &out, const float *vals, const uint32_t n)
+{
+    out << "[";
+    for (uint32_t i = 0; i < n; i++)
+        out << (i == 0 ? "" : ",") << vals[i];
+    out << "]";
+}
+
+void write_array(std::ostream &out, const uint32_t *vals, const uint32_t n)
+{
+    out << "[";
+    for (uint32_t i = 0; i < n; i++)
+        out << (i == 0 ? "" : ",") << vals[i];
+    out << "]";
+}
+
+void write_event(std::ostream &out, bool &first, const char *name, const QueryTrace &trace, const double begin_us,
+                 const double dur_us)
+{
+    out << (first ? "" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << trace.thread_id
+        << ",\"ts\":" << (double)trace.start_us + begin_us << ",\"dur\":" << dur_us
+        << ",\"args\":{\"query_id\":" << trace.query_id << "}}";
+    first = false;
+}
+} // namespace
+
+QueryTracer::QueryTracer(const size_t capacity, const float sample_rate)
+    : _capacity(capacity), _sample_rate(sample_rate), _epoch(std::chrono::steady_clock::now())
+{
+    if (capacity == 0)
+        throw ANNException("Query trace capacity must be positive.", -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (sample_rate < 0 || sample_rate > 1)
+        throw ANNException("Query trace sample rate must be in [0, 1].", -1, __FUNCSIG__, __FILE__, __LINE__);
+    _slots.reset(new Slot[capacity]);
+}
+
+QueryTracer::~QueryTracer() = default;
+
+QueryTrace *QueryTracer::begin_query()
+{
+    // Deterministic sampling: query n is traced when floor(n * rate) steps,
+    // which spreads the sampled queries evenly over the stream.
+    const uint64_t n = _num_queries.fetch_add(1, std::memory_order_relaxed);
+    if ((uint64_t)((n + 1) * _sample_rate) == (uint64_t)(n * _sample_rate))
+        return nullptr;
+
+    thread_local QueryTrace trace;
+    trace.reset();
+    trace.query_id = n;
+    trace.thread_id = current_thread_trace_id();
+    trace.start_us = std::chrono::duration_cast<std::chrono::microseconds>(trace.started - _epoch).count();
+    return &trace;
+}
+
+void QueryTracer::end_query(QueryTrace *trace)
+{
+    trace->total_us = trace->elapsed_us();
+
+    const uint64_t ticket = _next_ticket.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = _slots[ticket % _capacity];
+    slot.seq.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.trace = *trace;
+    slot.seq.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<QueryTrace> QueryTracer::snapshot() const
+{
+    const uint64_t end = _next_ticket.load(std::memory_order_acquire);
+    const uint64_t begin = end > _capacity ? end - _capacity : 0;
+
+    std::vector<QueryTrace> traces;
+    traces.reserve(end - begin);
+    QueryTrace copy;
+    for (uint64_t ticket = begin; ticket < end; ticket++)
+    {
+        const Slot &slot = _slots[ticket % _capacity];
+        const uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before != 2 * ticket + 2)
+            continue; // still being written, or already overwritten by a newer query
+        copy = slot.trace;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == before)
+            traces.push_back(copy);
+    }
+    return traces;
+}
+
+uint64_t QueryTracer::num_queries() const
+{
+    return _num_queries.load(std::memory_order_relaxed);
+}
+
+uint64_t QueryTracer::num_traced() const
+{
+    return _next_ticket.load(std::memory_order_relaxed);
+}
+
+void QueryTracer::dump_json(std::ostream &out) const
+{
+    const auto traces = snapshot();
+    out << "[";
+    for (size_t i = 0; i < traces.size(); i++)
+    {
+        const auto &t = traces[i];
+        const uint32_t recorded_hops = std::min(t.n_hops, QueryTrace::MAX_HOPS);
+        out << (i == 0 ? "\n" : ",\n") << "{\"query_id\":" << t.query_id << ",\"thread_id\":" << t.thread_id
+            << ",\"start_us\":" << t.start_us << ",\"total_us\":" << t.total_us
+            << ",\"scratch_wait_us\":" << t.scratch_wait_us << ",\"pq_table_us\":" << t.pq_table_us
+            << ",\"rerank_us\":" << t.rerank_us << ",\"io_us\":" << t.io_us << ",\"n_hops\":" << t.n_hops
+            << ",\"n_cmps\":" << t.n_cmps << ",\"n_ios\":" << t.n_ios << ",\"hop_begin_us\":";
+        write_array(out, t.hop_begin_us, recorded_hops);
+        out << ",\"hop_us\":";
+        write_array(out, t.hop_us, recorded_hops);
+        out << ",\"cache_hits\":";
+        write_array(out, t.cache_hits, QueryTrace::MAX_LEVELS);
+        out << ",\"cache_misses\":";
+        write_array(out, t.cache_misses, QueryTrace::MAX_LEVELS);
+        out << "}";
+    }
+    out << "\n]\n";
+}
+
+void QueryTracer::dump_chrome_trace(std::ostream &out) const
+{
+    const auto traces = snapshot();
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const auto &t : traces)
+    {
+        write_event(out, first, "query", t, 0, t.total_us);
+        if (t.scratch_wait_us > 0)
+            write_event(out, first, "scratch_wait", t, 0, t.scratch_wait_us);
+        if (t.pq_table_us > 0)
+            write_event(out, first, "pq_table", t, t.pq_table_begin_us, t.pq_table_us);
+        const uint32_t recorded_hops = std::min(t.n_hops, QueryTrace::MAX_HOPS);
+        for (uint32_t h = 0; h < recorded_hops; h++)
+            write_event(out, first, "hop", t, t.hop_begin_us[h], t.hop_us[h]);
+        if (t.rerank_us > 0)
+            write_event(out, first, "rerank", t, t.rerank_begin_us, t.rerank_us);
+    }
+    out << "\n]}\n";
+}
+
+void QueryTracer::save(const std::string &path, const std::string &format) const
+{
+    std::ofstream out(path);
+    if (!out)
+        throw ANNException("Could not open query trace file " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (format == "chrome")
+        dump_chrome_trace(out);
+    else if (format == "json")
+        dump_json(out);
+    else
+        throw ANNException("Unknown query trace format " + format + ", expected json or chrome", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+}
+} // namespace diskann
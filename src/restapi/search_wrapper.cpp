@@ -23,8 +23,6 @@
 
 namespace diskann
 {
-const unsigned int DEFAULT_W = 1;
-
 SearchResult::SearchResult(unsigned int K, unsigned int elapsed_time_in_ms, const unsigned *const indices,
                            const float *const distances, const std::string *const tags,
                            const unsigned *const partitions)
@@ -93,6 +91,79 @@ void BaseSearch::lookup_tags(const unsigned K, const unsigned *indices, std::str
     }
 }
 
+AdmissionController::AdmissionController(const AdmissionParams &params) : _params(params)
+{
+}
+
+bool AdmissionController::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_stats.in_flight >= _params.max_in_flight)
+    {
+        if (_stats.queue_depth >= _params.max_queue_depth)
+        {
+            _stats.rejected++;
+            throw SearchRejectedException("Search queue is full");
+        }
+
+        _stats.queue_depth++;
+        auto slot_free = [this] { return _stats.in_flight < _params.max_in_flight; };
+        bool admitted = true;
+        if (_params.max_queue_wait_ms > 0)
+            admitted = _cv.wait_for(lock, std::chrono::milliseconds(_params.max_queue_wait_ms), slot_free);
+        else
+            _cv.wait(lock, slot_free);
+        _stats.queue_depth--;
+
+        if (!admitted)
+        {
+            _stats.timed_out++;
+            throw SearchRejectedException("Search waited too long in the queue");
+        }
+    }
+
+    _stats.in_flight++;
+    _stats.admitted++;
+    const bool degraded = _params.degrade_queue_depth > 0 && _stats.queue_depth >= _params.degrade_queue_depth;
+    if (degraded)
+        _stats.degraded++;
+    return degraded;
+}
+
+void AdmissionController::release()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stats.in_flight--;
+    }
+    _cv.notify_one();
+}
+
+AdmissionStats AdmissionController::stats() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void BaseSearch::set_admission_params(const AdmissionParams &params)
+{
+    _admission_params = params;
+    if (params.max_in_flight > 0)
+        _admission.reset(new AdmissionController(params));
+    else
+        _admission.reset();
+}
+
+AdmissionStats BaseSearch::admission_stats() const
+{
+    return _admission != nullptr ? _admission->stats() : AdmissionStats();
+}
+
+unsigned BaseSearch::degraded_l(const unsigned K, const unsigned Ls) const
+{
+    return (std::max)(K, (unsigned)(Ls * _admission_params.degraded_l_factor));
+}
+
 template <typename T>
 InMemorySearch<T>::InMemorySearch(const std::string &baseFile, const std::string &indexFile,
                                   const std::string &tagsFile, Metric m, uint32_t num_threads, uint32_t search_l)
@@ -100,7 +171,7 @@ InMemorySearch<T>::InMemorySearch(const std::string &baseFile, const std::string
 {
     size_t dimensions, total_points = 0;
     diskann::get_bin_metadata(baseFile, total_points, dimensions);
-    auto search_params = diskann::IndexSearchParams(search_l, num_threads);
+    auto search_params = std::make_shared<diskann::IndexSearchParams>(search_l, num_threads);
     _index = std::unique_ptr<diskann::Index<T>>(
         new diskann::Index<T>(m, dimensions, total_points, nullptr, search_params, 0, false));
 
@@ -111,11 +182,14 @@ template <typename T>
 SearchResult InMemorySearch<T>::search(const T *query, const unsigned int dimensions, const unsigned int K,
                                        const unsigned int Ls)
 {
+    AdmissionTicket ticket(_admission.get());
+    const unsigned L = ticket.degraded() ? degraded_l(K, Ls) : Ls;
+
     unsigned int *indices = new unsigned int[K];
     float *distances = new float[K];
 
     auto startTime = std::chrono::high_resolution_clock::now();
-    _index->search(query, K, Ls, indices, distances);
+    _index->search(query, K, L, indices, distances);
     auto duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime)
             .count();
@@ -140,8 +214,9 @@ template <typename T> InMemorySearch<T>::~InMemorySearch()
 
 template <typename T>
 PQFlashSearch<T>::PQFlashSearch(const std::string &indexPrefix, const unsigned num_nodes_to_cache,
-                                const unsigned num_threads, const std::string &tagsFile, Metric m)
-    : BaseSearch(tagsFile)
+                                const unsigned num_threads, const std::string &tagsFile, Metric m,
+                                const unsigned beamwidth)
+    : BaseSearch(tagsFile), _beamwidth(beamwidth)
 {
 #ifdef _WINDOWS
 #ifndef USE_BING_INFRA
@@ -178,12 +253,18 @@ template <typename T>
 SearchResult PQFlashSearch<T>::search(const T *query, const unsigned int dimensions, const unsigned int K,
                                       const unsigned int Ls)
 {
+    // Admission keeps the searches in flight within the index's scratch pool
+    // instead of letting them block inside cached_beam_search.
+    AdmissionTicket ticket(_admission.get());
+    const unsigned L = ticket.degraded() ? degraded_l(K, Ls) : Ls;
+    const unsigned beamwidth = ticket.degraded() ? 1 : _beamwidth;
+
     uint64_t *indices_u64 = new uint64_t[K];
     unsigned *indices = new unsigned[K];
     float *distances = new float[K];
 
     auto startTime = std::chrono::high_resolution_clock::now();
-    _index->cached_beam_search(query, K, Ls, indices_u64, distances, DEFAULT_W);
+    _index->cached_beam_search(query, K, L, indices_u64, distances, beamwidth);
     auto duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime)
             .count();
@@ -1,26 +1,91 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <ctime>
 #include <functional>
 #include <iomanip>
 #include <string>
 #include <cstdlib>
 #include <codecvt>
+#include <future>
 #include <limits>
+#include <queue>
+#include <omp.h>
 
 #include <restapi/server.h>
 
+#include "metrics.h"
+#include "timer.h"
+
 namespace diskann
 {
+namespace
+{
+// Request level metrics of the REST server, exported on GET /metrics along
+// with the metrics of the indices it serves.
+struct ServerMetrics
+{
+    Counter &requests;
+    Counter &queries;
+    Counter &rejected;
+    Counter &failed;
+    Histogram &request_latency;
+
+    static ServerMetrics &get()
+    {
+        auto &registry = MetricsRegistry::global();
+        static ServerMetrics metrics{
+            registry.counter("diskann_server_requests_total", "Search requests answered successfully"),
+            registry.counter("diskann_server_queries_total", "Query vectors in successful search requests"),
+            registry.counter("diskann_server_rejected_total", "Search requests shed by admission control"),
+            registry.counter("diskann_server_failed_total", "Search requests that failed"),
+            registry.histogram("diskann_server_request_latency_seconds", "Search request latency, including parsing")};
+        return metrics;
+    }
+
+    void record(const unsigned short status, const size_t num_queries, const Timer &timer)
+    {
+        if (status == web::http::status_codes::OK)
+        {
+            requests.add();
+            queries.add(num_queries);
+            request_latency.record(timer.elapsed());
+        }
+        else if (status == web::http::status_codes::ServiceUnavailable)
+            rejected.add();
+        else
+            failed.add();
+    }
+};
+
+const std::string PROMETHEUS_CONTENT_TYPE = "text/plain; version=0.0.4";
+} // namespace
 
 Server::Server(web::uri &uri, std::vector<std::unique_ptr<diskann::BaseSearch>> &multi_searcher,
-               const std::string &typestring)
-    : _multi_search(multi_searcher.size() > 1 ? true : false)
+               const std::string &typestring, const unsigned shard_threads, const unsigned shard_timeout_ms,
+               const bool partial_results, const bool is_debug)
+    : _isDebug(is_debug), _multi_search(multi_searcher.size() > 1 ? true : false), _shard_timeout_ms(shard_timeout_ms),
+      _partial_results(partial_results)
 {
     for (auto &searcher : multi_searcher)
         _multi_searcher.push_back(std::move(searcher));
 
+    if (_multi_search)
+    {
+        // The pool is shared by all requests, so by default it has a thread
+        // per core (and at least one per shard) rather than one per shard,
+        // which would serialize concurrent requests on their shards.
+        size_t num_threads = shard_threads;
+        if (num_threads == 0)
+            num_threads = (std::max)((size_t)std::thread::hardware_concurrency(), _multi_searcher.size());
+        _shard_pool = std::unique_ptr<ThreadPool>(new ThreadPool(num_threads));
+    }
+    // A batch query keeps this many queries in flight: enough to occupy the
+    // shard pool, or one per core on a single searcher.
+    _batch_threads = (std::max)(1u, _multi_search ? (unsigned)(_shard_pool->num_threads() / _multi_searcher.size())
+                                                  : std::thread::hardware_concurrency());
+
     _listener = std::unique_ptr<web::http::experimental::listener::http_listener>(
         new web::http::experimental::listener::http_listener(uri));
     if (typestring == std::string("float"))
@@ -41,6 +106,7 @@ Server::Server(web::uri &uri, std::vector<std::unique_ptr<diskann::BaseSearch>>
     {
         throw "Unsupported type in server constuctor";
     }
+    _listener->support(web::http::methods::GET, std::bind(&Server::handle_get, this, std::placeholders::_1));
 }
 
 Server::~Server()
@@ -56,7 +122,74 @@ pplx::task<void> Server::close()
     return _listener->close();
 }
 
-diskann::SearchResult Server::aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results)
+template <class T>
+std::vector<diskann::SearchResult> Server::search_shards(const std::shared_ptr<T> &queryVector,
+                                                         const unsigned int dimensions, const unsigned int K,
+                                                         const unsigned int Ls, std::vector<unsigned> &partitions,
+                                                         std::vector<unsigned> &missing_partitions)
+{
+    std::vector<diskann::SearchResult> results;
+    if (!_multi_search)
+    {
+        results.push_back(_multi_searcher[0]->search(queryVector.get(), dimensions, K, Ls));
+        partitions.push_back(0);
+        return results;
+    }
+
+    // Scatter: the tasks hold their own reference to the query so that a
+    // shard which misses the deadline can finish after we have replied. A task
+    // only dequeued after the deadline has no one waiting for it and is
+    // dropped without searching.
+    const bool has_deadline = _shard_timeout_ms > 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_shard_timeout_ms);
+    std::vector<std::future<diskann::SearchResult>> futures;
+    futures.reserve(_multi_searcher.size());
+    for (size_t i = 0; i < _multi_searcher.size(); ++i)
+    {
+        BaseSearch *searcher = _multi_searcher[i].get();
+        auto task = std::make_shared<std::packaged_task<diskann::SearchResult()>>(
+            [searcher, queryVector, dimensions, K, Ls, has_deadline, deadline, i]() {
+                if (has_deadline && std::chrono::steady_clock::now() >= deadline)
+                    throw std::runtime_error("Search on partition " + std::to_string(i) +
+                                             " started after the deadline");
+                return searcher->search(queryVector.get(), dimensions, K, Ls);
+            });
+        futures.push_back(task->get_future());
+        _shard_pool->submit([task]() { (*task)(); });
+    }
+
+    // Gather against a single deadline for the whole query.
+    for (unsigned i = 0; i < (unsigned)futures.size(); ++i)
+    {
+        if (has_deadline && futures[i].wait_until(deadline) != std::future_status::ready)
+        {
+            if (!_partial_results)
+                throw std::runtime_error("Search timed out on partition " + std::to_string(i));
+            missing_partitions.push_back(i);
+            continue;
+        }
+
+        try
+        {
+            results.push_back(futures[i].get());
+            partitions.push_back(i);
+        }
+        catch (const std::exception &ex)
+        {
+            if (!_partial_results)
+                throw;
+            std::cerr << "Search failed on partition " << i << ": " << ex.what() << std::endl;
+            missing_partitions.push_back(i);
+        }
+    }
+
+    if (results.empty())
+        throw std::runtime_error("No partition answered the query");
+    return results;
+}
+
+diskann::SearchResult Server::aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results,
+                                                const std::vector<unsigned> &partitions)
 {
     if (_multi_search)
     {
@@ -65,36 +198,41 @@ diskann::SearchResult Server::aggregate_results(const unsigned K, const std::vec
         auto best_partitions = new unsigned[K];
         auto best_tags = results[0].tags_enabled() ? new std::string[K] : nullptr;
 
-        auto numsearchers = _multi_searcher.size();
-        std::vector<size_t> pos(numsearchers, 0);
+        // k-way merge of the per-partition result lists, which are sorted by
+        // distance: the heap holds the next candidate of every partition.
+        typedef std::pair<float, std::pair<size_t, size_t>> cursor_t;
+        std::priority_queue<cursor_t, std::vector<cursor_t>, std::greater<cursor_t>> heap;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (!results[i].get_distances().empty())
+                heap.push(std::make_pair(results[i].get_distances()[0], std::make_pair(i, (size_t)0)));
+        }
 
-        for (size_t k = 0; k < K; ++k)
+        unsigned num_results = 0;
+        while (num_results < K && !heap.empty())
         {
-            float best_distance = std::numeric_limits<float>::max();
-            unsigned best_partition = 0;
+            const size_t best = heap.top().second.first;
+            const size_t pos = heap.top().second.second;
+            heap.pop();
 
-            for (size_t i = 0; i < numsearchers; ++i)
-            {
-                if (results[i].get_distances()[pos[i]] < best_distance)
-                {
-                    best_distance = results[i].get_distances()[pos[i]];
-                    best_partition = i;
-                }
-            }
-            best_distances[k] = best_distance;
-            best_indices[k] = results[best_partition].get_indices()[pos[best_partition]];
-            best_partitions[k] = best_partition;
-            if (results[best_partition].tags_enabled())
-                best_tags[k] = results[best_partition].get_tags()[pos[best_partition]];
-            std::cout << best_partition << " " << pos[best_partition] << std::endl;
-            pos[best_partition]++;
+            best_distances[num_results] = results[best].get_distances()[pos];
+            best_indices[num_results] = results[best].get_indices()[pos];
+            best_partitions[num_results] = partitions[best];
+            if (best_tags != nullptr && results[best].tags_enabled())
+                best_tags[num_results] = results[best].get_tags()[pos];
+            num_results++;
+
+            if (pos + 1 < results[best].get_distances().size())
+                heap.push(std::make_pair(results[best].get_distances()[pos + 1], std::make_pair(best, pos + 1)));
         }
 
+        // The partitions were searched concurrently, so the slowest one bounds
+        // the search time.
         unsigned int total_time = 0;
-        for (size_t i = 0; i < numsearchers; ++i)
-            total_time += results[i].get_time();
+        for (size_t i = 0; i < results.size(); ++i)
+            total_time = (std::max)(total_time, results[i].get_time());
         diskann::SearchResult result =
-            SearchResult(K, total_time, best_indices, best_distances, best_tags, best_partitions);
+            SearchResult(num_results, total_time, best_indices, best_distances, best_tags, best_partitions);
 
         delete[] best_indices;
         delete[] best_distances;
@@ -111,6 +249,13 @@ diskann::SearchResult Server::aggregate_results(const unsigned K, const std::vec
 
 template <class T> void Server::handle_post(web::http::http_request message)
 {
+    if (message.headers().content_type().find(BINARY_CONTENT_TYPE) == 0)
+    {
+        handle_binary_post<T>(message);
+        return;
+    }
+
+    Timer request_timer;
     message.extract_string(true)
         .then([=](utility::string_t body) {
             int64_t queryId = -1;
@@ -121,14 +266,13 @@ template <class T> void Server::handle_post(web::http::http_request message)
                 unsigned int dimensions = 0;
                 unsigned int Ls;
                 parseJson(body, K, queryId, queryVector, dimensions, Ls);
+                std::shared_ptr<T> query(queryVector, [](T *ptr) { diskann::aligned_free(ptr); });
 
                 auto startTime = std::chrono::high_resolution_clock::now();
-                std::vector<diskann::SearchResult> results;
-
-                for (auto &searcher : _multi_searcher)
-                    results.push_back(searcher->search(queryVector, dimensions, (unsigned int)K, Ls));
-                diskann::SearchResult result = aggregate_results(K, results);
-                diskann::aligned_free(queryVector);
+                std::vector<unsigned> partitions, missing_partitions;
+                std::vector<diskann::SearchResult> results =
+                    search_shards(query, dimensions, (unsigned int)K, Ls, partitions, missing_partitions);
+                diskann::SearchResult result = aggregate_results(K, results, partitions);
                 web::json::value response = prepareResponse(queryId, K);
                 response[INDICES_KEY] = idsToJsonArray(result);
                 response[DISTANCES_KEY] = distancesToJsonArray(result);
@@ -136,14 +280,28 @@ template <class T> void Server::handle_post(web::http::http_request message)
                     response[TAGS_KEY] = tagsToJsonArray(result);
                 if (result.partitions_enabled())
                     response[PARTITION_KEY] = partitionsToJsonArray(result);
+                if (!missing_partitions.empty())
+                {
+                    web::json::value missing = web::json::value::array();
+                    for (size_t i = 0; i < missing_partitions.size(); i++)
+                        missing[i] = web::json::value::number(missing_partitions[i]);
+                    response[MISSING_PARTITIONS_KEY] = missing;
+                }
 
                 response[TIME_TAKEN_KEY] = std::chrono::duration_cast<std::chrono::microseconds>(
                                                std::chrono::high_resolution_clock::now() - startTime)
                                                .count();
 
-                std::cout << "Responding to: " << queryId << std::endl;
+                if (_isDebug)
+                    std::cout << "Responding to: " << queryId << std::endl;
                 return std::make_pair(web::http::status_codes::OK, response);
             }
+            catch (const SearchRejectedException &ex)
+            {
+                web::json::value response = prepareResponse(queryId, K);
+                response[ERROR_MESSAGE_KEY] = web::json::value::string(ex.what());
+                return std::make_pair(web::http::status_codes::ServiceUnavailable, response);
+            }
             catch (const std::exception &ex)
             {
                 std::cerr << "Exception while processing query: " << queryId << ":" << ex.what() << std::endl;
@@ -160,6 +318,7 @@ template <class T> void Server::handle_post(web::http::http_request message)
             }
         })
         .then([=](std::pair<short unsigned int, web::json::value> response_status) {
+            ServerMetrics::get().record(response_status.first, 1, request_timer);
             try
             {
                 message.reply(response_status.first, response_status.second).wait();
@@ -171,6 +330,180 @@ template <class T> void Server::handle_post(web::http::http_request message)
         });
 }
 
+template <class T> void Server::handle_binary_post(web::http::http_request message)
+{
+    Timer request_timer;
+    auto answered_queries = std::make_shared<std::atomic<size_t>>(0);
+    message.extract_vector()
+        .then([=](std::vector<unsigned char> body) {
+            try
+            {
+                auto startTime = std::chrono::high_resolution_clock::now();
+
+                BinaryQueryHeader header;
+                if (body.size() < sizeof(header))
+                    throw std::invalid_argument("Binary request is shorter than its header.");
+                memcpy(&header, body.data(), sizeof(header));
+                if (header.magic != BINARY_PROTOCOL_MAGIC)
+                    throw std::invalid_argument("Binary request has an unknown protocol magic.");
+                if (header.k == 0 || header.k > header.Ls)
+                    throw std::invalid_argument("Num of expected NN (k) must be greater than zero and less than or "
+                                                "equal to Ls.");
+                if (header.dimensions == 0)
+                    throw std::invalid_argument("Query vectors have zero elements.");
+                const size_t num_queries = header.num_queries, dimensions = header.dimensions, K = header.k;
+                if (body.size() != sizeof(header) + num_queries * dimensions * sizeof(T))
+                    throw std::invalid_argument("Binary request size does not match its header.");
+
+                // Copy the queries straight into one aligned, zero-padded buffer.
+                const size_t aligned_dim = ROUND_UP(dimensions, 8);
+                T *batch = nullptr;
+                diskann::alloc_aligned((void **)&batch, std::max(num_queries, (size_t)1) * aligned_dim * sizeof(T),
+                                       8 * sizeof(T));
+                std::shared_ptr<T> queries(batch, [](T *ptr) { diskann::aligned_free(ptr); });
+                memset(batch, 0, num_queries * aligned_dim * sizeof(T));
+                const unsigned char *src = body.data() + sizeof(header);
+                for (size_t q = 0; q < num_queries; q++)
+                    memcpy(batch + q * aligned_dim, src + q * dimensions * sizeof(T), dimensions * sizeof(T));
+
+                std::vector<unsigned char> out(sizeof(BinaryResponseHeader) +
+                                               num_queries * K * (sizeof(uint32_t) + sizeof(float)));
+                uint32_t *ids = (uint32_t *)(out.data() + sizeof(BinaryResponseHeader));
+                float *dists = (float *)(ids + num_queries * K);
+                std::fill(ids, ids + num_queries * K, std::numeric_limits<uint32_t>::max());
+                std::fill(dists, dists + num_queries * K, std::numeric_limits<float>::max());
+
+                std::string error;
+                bool rejected = false;
+                const int num_threads = (int)std::min(num_queries, (size_t)_batch_threads);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+                for (int64_t q = 0; q < (int64_t)num_queries; q++)
+                {
+                    try
+                    {
+                        std::shared_ptr<T> query(queries, batch + q * aligned_dim);
+                        std::vector<unsigned> partitions, missing_partitions;
+                        std::vector<diskann::SearchResult> results = search_shards(
+                            query, header.dimensions, header.k, header.Ls, partitions, missing_partitions);
+                        diskann::SearchResult result = aggregate_results(header.k, results, partitions);
+
+                        const auto &result_ids = result.get_indices();
+                        const auto &result_dists = result.get_distances();
+                        const size_t num_results = std::min(K, result_ids.size());
+                        std::copy(result_ids.begin(), result_ids.begin() + num_results, ids + q * K);
+                        std::copy(result_dists.begin(), result_dists.begin() + num_results, dists + q * K);
+                    }
+                    catch (const SearchRejectedException &ex)
+                    {
+#pragma omp critical
+                        {
+                            rejected = true;
+                            error = ex.what();
+                        }
+                    }
+                    catch (const std::exception &ex)
+                    {
+#pragma omp critical
+                        error = ex.what();
+                    }
+                }
+                if (rejected)
+                    throw SearchRejectedException(error);
+                if (!error.empty())
+                    throw std::runtime_error(error);
+
+                answered_queries->store(num_queries);
+                BinaryResponseHeader response_header;
+                response_header.magic = BINARY_PROTOCOL_MAGIC;
+                response_header.num_queries = header.num_queries;
+                response_header.k = header.k;
+                response_header.time_taken_in_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                                       std::chrono::high_resolution_clock::now() - startTime)
+                                                       .count();
+                memcpy(out.data(), &response_header, sizeof(response_header));
+
+                if (_isDebug)
+                    std::cout << "Responding to batch of " << num_queries << " queries" << std::endl;
+                return std::make_pair(web::http::status_codes::OK, std::move(out));
+            }
+            catch (const std::invalid_argument &ex)
+            {
+                std::string msg(ex.what());
+                return std::make_pair(web::http::status_codes::BadRequest,
+                                      std::vector<unsigned char>(msg.begin(), msg.end()));
+            }
+            catch (const SearchRejectedException &ex)
+            {
+                std::string msg(ex.what());
+                return std::make_pair(web::http::status_codes::ServiceUnavailable,
+                                      std::vector<unsigned char>(msg.begin(), msg.end()));
+            }
+            catch (const std::exception &ex)
+            {
+                std::cerr << "Exception while processing binary query batch: " << ex.what() << std::endl;
+                std::string msg(ex.what());
+                return std::make_pair(web::http::status_codes::InternalError,
+                                      std::vector<unsigned char>(msg.begin(), msg.end()));
+            }
+        })
+        .then([=](std::pair<short unsigned int, std::vector<unsigned char>> response_status) {
+            ServerMetrics::get().record(response_status.first, answered_queries->load(), request_timer);
+            try
+            {
+                web::http::http_response response(response_status.first);
+                response.set_body(std::move(response_status.second));
+                message.reply(response).wait();
+            }
+            catch (const std::exception &ex)
+            {
+                std::cerr << "Exception while processing reply: " << ex.what() << std::endl;
+            };
+        });
+}
+
+void Server::handle_get(web::http::http_request message)
+{
+    if (message.relative_uri().path() == METRICS_PATH)
+    {
+        try
+        {
+            message.reply(web::http::status_codes::OK, MetricsRegistry::global().prometheus_text(),
+                          PROMETHEUS_CONTENT_TYPE)
+                .wait();
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "Exception while processing reply: " << ex.what() << std::endl;
+        };
+        return;
+    }
+
+    web::json::value partitions = web::json::value::array();
+    for (size_t i = 0; i < _multi_searcher.size(); i++)
+    {
+        const AdmissionStats stats = _multi_searcher[i]->admission_stats();
+        web::json::value partition = web::json::value::object();
+        partition[IN_FLIGHT_KEY] = web::json::value::number(stats.in_flight);
+        partition[QUEUE_DEPTH_KEY] = web::json::value::number(stats.queue_depth);
+        partition[ADMITTED_KEY] = web::json::value::number(stats.admitted);
+        partition[DEGRADED_KEY] = web::json::value::number(stats.degraded);
+        partition[REJECTED_KEY] = web::json::value::number(stats.rejected);
+        partition[TIMED_OUT_KEY] = web::json::value::number(stats.timed_out);
+        partitions[i] = partition;
+    }
+    web::json::value response = web::json::value::object();
+    response[PARTITION_KEY] = partitions;
+
+    try
+    {
+        message.reply(web::http::status_codes::OK, response).wait();
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Exception while processing reply: " << ex.what() << std::endl;
+    };
+}
+
 web::json::value Server::prepareResponse(const int64_t &queryId, const int k)
 {
     web::json::value response = web::json::value::object();
@@ -184,7 +517,8 @@ template <class T>
 void Server::parseJson(const utility::string_t &body, unsigned int &k, int64_t &queryId, T *&queryVector,
                        unsigned int &dimensions, unsigned &Ls)
 {
-    std::cout << body << std::endl;
+    if (_isDebug)
+        std::cout << body << std::endl;
     web::json::value val = web::json::value::parse(body);
     web::json::array queryArr = val.at(VECTOR_KEY).as_array();
     queryId = val.has_field(QUERY_ID_KEY) ? val.at(QUERY_ID_KEY).as_number().to_int64() : -1;
@@ -204,7 +538,7 @@ void Server::parseJson(const utility::string_t &body, unsigned int &k, int64_t &
     dimensions = static_cast<unsigned int>(queryArr.size());
     unsigned new_dim = ROUND_UP(dimensions, 8);
     diskann::alloc_aligned((void **)&queryVector, new_dim * sizeof(T), 8 * sizeof(T));
-    memset(queryVector, 0, new_dim * sizeof(float));
+    memset(queryVector, 0, new_dim * sizeof(T));
     for (size_t i = 0; i < queryArr.size(); i++)
     {
         queryVector[i] = (float)queryArr[i].as_double();
@@ -232,7 +566,6 @@ web::json::value Server::idsToJsonArray(const diskann::SearchResult &result)
         auto idVal = web::json::value::number(ids[i]);
         idArray[i] = idVal;
     }
-    std::cout << "Vector size: " << ids.size() << std::endl;
     return idArray;
 }
 
@@ -0,0 +1,190 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+
+#include "index.h"
+
+namespace
+{
+const size_t dim = 16;
+const size_t num_points = 1200;
+const uint32_t num_labels = 40;
+const uint32_t L = 50;
+const uint32_t R = 32;
+const uint32_t dropped_label = 7;
+
+struct DynamicFilteredIndexFixture
+{
+    DynamicFilteredIndexFixture() : data(num_points * dim), labels(num_points), live(num_points, false)
+    {
+        // each label is a cluster around its own center; every fifth point
+        // also carries a label shared across clusters
+        std::mt19937 gen(1234);
+        std::uniform_real_distribution<float> center_dist(-1.0f, 1.0f);
+        std::normal_distribution<float> noise(0.0f, 0.1f);
+        std::vector<float> centers(num_labels * dim);
+        for (auto &value : centers)
+            value = center_dist(gen);
+        for (size_t i = 0; i < num_points; i++)
+        {
+            labels[i] = {(uint32_t)(1 + i % num_labels)};
+            if (i % 5 == 0)
+                labels[i].push_back(1000);
+            for (size_t j = 0; j < dim; j++)
+                data[i * dim + j] = centers[(i % num_labels) * dim + j] + noise(gen);
+        }
+    }
+
+    std::unique_ptr<diskann::Index<float, uint32_t, uint32_t>> make_index(const size_t max_points)
+    {
+        auto write_params = std::make_shared<diskann::IndexWriteParameters>(diskann::IndexWriteParametersBuilder(L, R)
+                                                                                .with_alpha(1.2f)
+                                                                                .with_filter_list_size(L)
+                                                                                .with_num_threads(1)
+                                                                                .build());
+        auto search_params = std::make_shared<diskann::IndexSearchParams>(L, 1);
+        return std::make_unique<diskann::Index<float, uint32_t, uint32_t>>(diskann::Metric::L2, dim, max_points,
+                                                                           write_params, search_params, 1, true, true,
+                                                                           false, false, 0, false, true);
+    }
+
+    void insert(diskann::Index<float, uint32_t, uint32_t> &index, const size_t begin, const size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            BOOST_REQUIRE_EQUAL(index.insert_point(point(i), (uint32_t)i + 1, labels[i]), 0);
+            live[i] = true;
+        }
+    }
+
+    const float *point(const size_t i) const
+    {
+        return data.data() + i * dim;
+    }
+
+    bool has_label(const size_t i, const uint32_t label) const
+    {
+        return std::find(labels[i].begin(), labels[i].end(), label) != labels[i].end();
+    }
+
+    // Queries each live point with each of its labels. The point itself must
+    // come back first in most queries, and every result must be a live point
+    // carrying the label, identified by its distance.
+    void check_self_queries(diskann::Index<float, uint32_t, uint32_t> &index, const size_t step)
+    {
+        const size_t K = 5;
+        size_t queries = 0, found_self = 0;
+        for (size_t q = 0; q < num_points; q += step)
+        {
+            if (!live[q])
+                continue;
+            for (const auto label : labels[q])
+            {
+                std::vector<uint32_t> ids(K, UINT32_MAX);
+                std::vector<float> dists(K, -1.0f);
+                index.search_with_filters(point(q), label, K, L, ids.data(), dists.data());
+                queries++;
+                found_self += ids[0] != UINT32_MAX && dists[0] == 0.0f;
+                for (size_t k = 0; k < K && ids[k] != UINT32_MAX; k++)
+                    BOOST_TEST(matches_live_point(point(q), label, dists[k]));
+            }
+        }
+        BOOST_TEST(queries > (size_t)0);
+        BOOST_TEST(found_self >= queries * 95 / 100);
+    }
+
+    bool matches_live_point(const float *query, const uint32_t label, const float distance) const
+    {
+        for (size_t i = 0; i < num_points; i++)
+        {
+            if (!live[i] || !has_label(i, label))
+                continue;
+            float d = 0;
+            for (size_t j = 0; j < dim; j++)
+                d += (query[j] - point(i)[j]) * (query[j] - point(i)[j]);
+            if (std::abs(d - distance) <= 1e-4f * (std::max)(1.0f, d))
+                return true;
+        }
+        return false;
+    }
+
+    std::vector<float> data;
+    std::vector<std::vector<uint32_t>> labels;
+    std::vector<bool> live;
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(DynamicFilteredIndex_tests, DynamicFilteredIndexFixture)
+
+// Labels arrive one at a time, so the index starts with a single frozen point
+// and claims or grows one per new label; labels whose points are all deleted
+// give their start back on consolidation, and a loaded index keeps going.
+BOOST_AUTO_TEST_CASE(test_label_start_lifecycle)
+{
+    auto index = make_index(num_points);
+    index->set_start_points_at_random(1.0f);
+
+    insert(*index, 0, 800);
+    check_self_queries(*index, 7);
+
+    // drop a label entirely along with a share of the other points
+    for (size_t i = 0; i < 800; i++)
+    {
+        if (has_label(i, dropped_label) || i % 3 == 0)
+        {
+            BOOST_REQUIRE_EQUAL(index->lazy_delete((uint32_t)i + 1), 0);
+            live[i] = false;
+        }
+    }
+    auto write_params = diskann::IndexWriteParametersBuilder(L, R).with_alpha(1.2f).with_filter_list_size(L).build();
+    auto report = index->consolidate_deletes(write_params);
+    BOOST_TEST(report._status == diskann::consolidation_report::status_code::SUCCESS);
+    check_self_queries(*index, 2);
+    {
+        std::vector<uint32_t> ids(5, UINT32_MAX);
+        std::vector<float> dists(5);
+        index->search_with_filters(point(dropped_label - 1), dropped_label, 5, L, ids.data(), dists.data());
+        BOOST_TEST(ids[0] == UINT32_MAX);
+    }
+
+    // new labels reuse the released start; the dropped label comes back
+    for (size_t i = 800; i < 1000; i++)
+        labels[i].push_back(2000 + (uint32_t)(i % 3));
+    insert(*index, 800, 1000);
+    check_self_queries(*index, 3);
+
+    const auto dir = std::filesystem::temp_directory_path() / "diskann_dynamic_filtered_index_tests";
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "index").string();
+    index->save(path.c_str(), true);
+
+    auto loaded = make_index(num_points);
+    loaded->load(path.c_str(), 1, L);
+    check_self_queries(*loaded, 3);
+
+    // the remaining points bring a label the loaded index has not seen, and
+    // deleting one of the late labels retires its start again
+    for (size_t i = 1000; i < num_points; i++)
+        labels[i].push_back(3000);
+    insert(*loaded, 1000, num_points);
+    for (size_t i = 800; i < 1000; i++)
+    {
+        if (has_label(i, 2001))
+        {
+            BOOST_REQUIRE_EQUAL(loaded->lazy_delete((uint32_t)i + 1), 0);
+            live[i] = false;
+        }
+    }
+    report = loaded->consolidate_deletes(write_params);
+    BOOST_TEST(report._status == diskann::consolidation_report::status_code::SUCCESS);
+    check_self_queries(*loaded, 2);
+
+    std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
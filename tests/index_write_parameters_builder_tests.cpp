@@ -52,6 +52,28 @@ BOOST_AUTO_TEST_CASE(test_build)
         BOOST_TEST(saturate_graph == parameters.saturate_graph);
 
         BOOST_TEST(num_threads == parameters.num_threads);
+        BOOST_TEST(parameters.first_pass_list_size == (uint32_t)0);
+    }
+
+    {
+        uint32_t first_pass_list_size = rand();
+        float first_pass_alpha = (float)rand();
+        float first_pass_sample_rate = 0.25f;
+        builder.with_first_pass_list_size(first_pass_list_size)
+            .with_first_pass_alpha(first_pass_alpha)
+            .with_first_pass_sample_rate(first_pass_sample_rate)
+            .with_knn_seed_degree(32);
+
+        auto parameters = builder.build();
+
+        BOOST_TEST(search_list_size == parameters.search_list_size);
+        BOOST_TEST(first_pass_list_size == parameters.first_pass_list_size);
+        BOOST_TEST(first_pass_alpha == parameters.first_pass_alpha);
+        BOOST_TEST(first_pass_sample_rate == parameters.first_pass_sample_rate);
+        BOOST_TEST(parameters.knn_seed_degree == (uint32_t)32);
+
+        diskann::IndexWriteParametersBuilder copy(parameters);
+        BOOST_TEST(first_pass_list_size == copy.build().first_pass_list_size);
     }
 }
 
@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+
+#include "index.h"
+
+namespace
+{
+const size_t dim = 16;
+const size_t num_dense = 11000;
+const size_t num_points = 12000;
+const uint32_t L = 50;
+const uint32_t R = 32;
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(KnnSeed_tests)
+
+// Most points sit in one tight cluster, more than a k-means cluster of the
+// seeding may hold, with a sparse spread around it. The seeded graph must
+// still lead each point to itself.
+BOOST_AUTO_TEST_CASE(test_skewed_data)
+{
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+    std::normal_distribution<float> dense(0.0f, 0.01f);
+    std::vector<float> data(num_points * dim);
+    for (size_t i = 0; i < num_points; i++)
+        for (size_t j = 0; j < dim; j++)
+            data[i * dim + j] = i < num_dense ? dense(gen) : spread(gen);
+
+    auto write_params = std::make_shared<diskann::IndexWriteParameters>(
+        diskann::IndexWriteParametersBuilder(L, R).with_alpha(1.2f).with_knn_seed_degree(16).build());
+    auto search_params = std::make_shared<diskann::IndexSearchParams>(L, 1);
+    diskann::Index<float, uint32_t, uint32_t> index(diskann::Metric::L2, dim, num_points, write_params, search_params,
+                                                    0, false, false, false, false, 0, false, false);
+    std::vector<uint32_t> tags;
+    index.build(data.data(), num_points, tags);
+
+    const size_t K = 5;
+    size_t queries = 0, found_self = 0;
+    for (size_t q = 0; q < num_points; q += 7)
+    {
+        std::vector<uint32_t> ids(K);
+        std::vector<float> dists(K);
+        index.search(data.data() + q * dim, K, L, ids.data(), dists.data());
+        queries++;
+        found_self += dists[0] == 0.0f;
+    }
+    BOOST_TEST(found_self >= queries * 95 / 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,111 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "metrics.h"
+
+namespace
+{
+size_t count_lines(const std::string &text, const std::string &prefix)
+{
+    size_t count = 0;
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line))
+        count += line.compare(0, prefix.size(), prefix) == 0;
+    return count;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(Metrics_tests)
+
+BOOST_AUTO_TEST_CASE(test_bucket_index)
+{
+    using diskann::Histogram;
+    for (uint64_t value = 0; value < 16; value++)
+        BOOST_TEST(Histogram::bucket_index(value) == value);
+    BOOST_TEST(Histogram::bucket_index(16) == 16u);
+    BOOST_TEST(Histogram::bucket_index(17) == 16u);
+    BOOST_TEST(Histogram::bucket_index(18) == 17u);
+    BOOST_TEST(Histogram::bucket_index(31) == 23u);
+    BOOST_TEST(Histogram::bucket_index(32) == 24u);
+    BOOST_TEST(Histogram::bucket_index(std::numeric_limits<uint64_t>::max()) == Histogram::NUM_BUCKETS - 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_bucket_limit)
+{
+    using diskann::Histogram;
+    // every bucket holds [previous limit, limit), and buckets past the
+    // linear range are at most 1/8 of their lower bound wide
+    uint64_t lower = 0;
+    for (uint32_t b = 0; b + 1 < Histogram::NUM_BUCKETS; b++)
+    {
+        const uint64_t limit = Histogram::bucket_limit(b);
+        BOOST_TEST_REQUIRE(limit > lower);
+        BOOST_TEST(Histogram::bucket_index(lower) == b);
+        BOOST_TEST(Histogram::bucket_index(limit - 1) == b);
+        BOOST_TEST(Histogram::bucket_index(limit) == b + 1);
+        if (b >= 16)
+            BOOST_TEST((limit - lower) * 8 <= lower);
+        lower = limit;
+    }
+    BOOST_TEST(Histogram::bucket_limit(Histogram::NUM_BUCKETS - 1) == std::numeric_limits<uint64_t>::max());
+}
+
+BOOST_AUTO_TEST_CASE(test_quantile)
+{
+    diskann::Histogram histogram;
+    BOOST_TEST(histogram.quantile(0.5) == 0u);
+
+    for (uint64_t value = 1; value <= 100; value++)
+        histogram.record(value);
+    BOOST_TEST(histogram.count() == 100u);
+    BOOST_TEST(histogram.sum() == 5050u);
+    // small values are exact, larger ones report the top of their bucket
+    BOOST_TEST(histogram.quantile(0.0) == 1u);
+    BOOST_TEST(histogram.quantile(0.1) == 10u);
+    BOOST_TEST(histogram.quantile(0.5) == 51u);
+    BOOST_TEST(histogram.quantile(0.99) == 103u);
+    BOOST_TEST(histogram.quantile(1.0) == 103u);
+    for (double q = 0.0; q <= 1.0; q += 0.05)
+    {
+        const uint64_t exact = (uint64_t)(q * 99) + 1;
+        const uint64_t reported = histogram.quantile(q);
+        BOOST_TEST(reported >= exact);
+        BOOST_TEST(reported * 8 <= exact * 9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_prometheus_buckets)
+{
+    diskann::MetricsRegistry registry;
+    registry.histogram("empty_seconds", "no values");
+    auto &histogram = registry.histogram("latency_seconds", "some values");
+    histogram.record(0);
+    histogram.record(3);
+    histogram.record(4);
+    histogram.record(1500000);
+
+    const std::string text = registry.prometheus_text();
+    // the same bucket series on every scrape, filled or not
+    BOOST_TEST(count_lines(text, "empty_seconds_bucket{") == diskann::METRICS_EXPORT_MAX_LOG2 + 2);
+    BOOST_TEST(count_lines(text, "latency_seconds_bucket{") == diskann::METRICS_EXPORT_MAX_LOG2 + 2);
+
+    // le is inclusive: 3 us falls under le=3us, 4 us does not
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"0.000000\"} 1\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"0.000003\"} 2\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"0.000007\"} 3\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"1.048575\"} 3\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"2.097151\"} 4\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_bucket{le=\"+Inf\"} 4\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_sum 1.500007\n") != std::string::npos);
+    BOOST_TEST(text.find("latency_seconds_count 4\n") != std::string::npos);
+    BOOST_TEST(text.find("empty_seconds_bucket{le=\"+Inf\"} 0\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()